@@ -6,6 +6,7 @@
 #define WINDOW_WIDTH 720
 #define WINDOW_HEIGHT 720
 #define NANOS_PER_SEC 1000000000LL  // Number of nanoseconds in a second
+#define NANOS_PER_MS 1000000LL      // Number of nanoseconds in a millisecond
 #define SCALE_FACTOR 4              // Scale ratio, 4=180x180px
 #define WIDTH (WINDOW_WIDTH / SCALE_FACTOR)
 #define HEIGHT (WINDOW_HEIGHT / SCALE_FACTOR)
@@ -67,12 +68,20 @@
 #define BLIPR_KEY_SHIFT_3 SDL_SCANCODE_RALT // SDL_SCANCODE_RCTRL
 #define BLIPR_KEY_FUNC SDL_SCANCODE_RSHIFT
 
+// Bits for the shift & function keys that are held, the only keys the screens draw differently:
+#define BLIPR_MODIFIER_SHIFT_1 0x01
+#define BLIPR_MODIFIER_SHIFT_2 0x02
+#define BLIPR_MODIFIER_SHIFT_3 0x04
+#define BLIPR_MODIFIER_FUNC 0x08
+
 // Midi devices
 #define BLIPR_MIDI_DEVICE_A 0
 #define BLIPR_MIDI_DEVICE_B 1
 #define BLIPR_MIDI_DEVICE_C 2
 #define BLIPR_MIDI_DEVICE_D 3
 #define BLIPR_MIDI_BUFFER_SIZE 256
+#define BLIPR_MIDI_MAX_LATENCY 50     // Max output latency in ms, 0 means events are sent immediately
+#define BLIPR_MIDI_LATENCY_STEP 5
 
 // blipr programs
 #define BLIPR_PROGRAM_NONE 0
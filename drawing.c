@@ -4,11 +4,17 @@
 #include "drawing_utils.h"
 #include "drawing.h"
 #include "colors.h"
+#include "framebuffer.h"
 
 /**
  * Draw a rectangle
  */
 void drawRect(int x, int y, int width, int height, SDL_Color color) {
+    if (isFramebufferUsed) {
+        fillFramebufferRect(x, y, width, height, color);
+        return;
+    }
+
     // Set the draw color
     SDL_SetRenderDrawColor(renderer, color.r, color.g, color.b, color.a);
 
@@ -21,6 +27,11 @@ void drawRect(int x, int y, int width, int height, SDL_Color color) {
  * Draw a single line
  */
 void drawLine(int x1, int y1, int x2, int y2, SDL_Color color) {
+    if (isFramebufferUsed) {
+        drawFramebufferLine(x1, y1, x2, y2, color);
+        return;
+    }
+
     setColor(color);
     SDL_RenderDrawLine(renderer, x1, y1, x2, y2);
 }
@@ -32,23 +43,17 @@ void drawBeveledRectOutline(int x, int y, int width, int height, SDL_Color color
     SDL_Color darker = adjustColorBrightness(color, -0.5f);
     SDL_Color lighter = adjustColorBrightness(color, 0.5f);
 
-    // Set the draw color
-    setColor(inversed ? darker : lighter);
-
     // Draw top line
-    SDL_RenderDrawLine(renderer, x + 1, y, x + width - 2, y);
+    drawLine(x + 1, y, x + width - 2, y, inversed ? darker : lighter);
 
     // Draw left line
-    SDL_RenderDrawLine(renderer, x, y + 1, x, y + height - 2);
-
-    // Set the draw color
-    setColor(inversed ? lighter : darker);
+    drawLine(x, y + 1, x, y + height - 2, inversed ? darker : lighter);
 
     // Draw bottom line
-    SDL_RenderDrawLine(renderer, x + 1, y + height - 1, x + width - 2, y + height - 1);
+    drawLine(x + 1, y + height - 1, x + width - 2, y + height - 1, inversed ? lighter : darker);
 
     // // Draw right line
-    SDL_RenderDrawLine(renderer, x + width - 1, y + 1, x + width - 1, y + height - 2);
+    drawLine(x + width - 1, y + 1, x + width - 1, y + height - 2, inversed ? lighter : darker);
 }
 
 /**
@@ -60,6 +65,14 @@ void drawRectOutline(int x, int y, int width, int height, int thickness, SDL_Col
         return;
     }
 
+    if (isFramebufferUsed) {
+        fillFramebufferRect(x, y, width, thickness, color);
+        fillFramebufferRect(x, y + height - thickness, width, thickness, color);
+        fillFramebufferRect(x, y, thickness, height, color);
+        fillFramebufferRect(x + width - thickness, y, thickness, height, color);
+        return;
+    }
+
     // Set the draw color
     SDL_SetRenderDrawColor(renderer, color.r, color.g, color.b, color.a);
     
@@ -84,6 +97,16 @@ void drawRectOutline(int x, int y, int width, int height, int thickness, SDL_Col
  * Draw a single line rect outline
  */
 void drawSingleLineRectOutline(int x, int y, int width, int height, SDL_Color color) {
+    if (isFramebufferUsed) {
+        if (width > 0 && height > 0) {
+            fillFramebufferRect(x, y, width, 1, color);
+            fillFramebufferRect(x, y + height - 1, width, 1, color);
+            fillFramebufferRect(x, y + 1, 1, height - 2, color);
+            fillFramebufferRect(x + width - 1, y + 1, 1, height - 2, color);
+        }
+        return;
+    }
+
     // Set the draw color
     SDL_SetRenderDrawColor(renderer, color.r, color.g, color.b, color.a);
 
@@ -105,7 +128,24 @@ void drawBeveledRect(int x, int y, int width, int height, SDL_Color color) {
  * Draw a single pixel
  */
 void drawPixel(int x, int y, SDL_Color color) {
+    if (isFramebufferUsed) {
+        drawFramebufferPixel(x, y, color);
+        return;
+    }
+
     SDL_SetRenderDrawColor(renderer, color.r, color.g, color.b, color.a);
     SDL_RenderDrawPoint(renderer, x, y);
 }
 
+/**
+ * Clear the whole screen
+ */
+void clearScreen(SDL_Color color) {
+    if (isFramebufferUsed) {
+        clearFramebuffer(color);
+        return;
+    }
+
+    SDL_SetRenderDrawColor(renderer, color.r, color.g, color.b, 255);
+    SDL_RenderClear(renderer);
+}
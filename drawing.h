@@ -11,5 +11,6 @@ void drawRectOutline(int x, int y, int width, int height, int thickness, SDL_Col
 void drawSingleLineRectOutline(int x, int y, int width, int height, SDL_Color color);
 void drawBeveledRect(int x, int y, int width, int height, SDL_Color color);
 void drawPixel(int x, int y, SDL_Color color);
+void clearScreen(SDL_Color color);
 
 #endif
\ No newline at end of file
@@ -97,9 +97,9 @@ void drawPatternLengthIndicator(int current, int total) {
 }
 
 /**
- * Draw a basic 4x6 grid
+ * Draw a basic 4x6 grid, with the held modifiers (BLIPR_MODIFIER_*) pressed down
  */
-void drawBasicGrid(bool keyStates[SDL_NUM_SCANCODES]) {
+void drawBasicGrid(unsigned char heldModifiers) {
     int width = HEIGHT / 6;
 
     // 16-Pad
@@ -127,10 +127,10 @@ void drawBasicGrid(bool keyStates[SDL_NUM_SCANCODES]) {
             int y = HEIGHT - 2 - j - ((j + 1) * height);
 
             if (
-                (j == 0 && i == 0 && keyStates[BLIPR_KEY_SHIFT_1]) ||
-                (j == 0 && i == 1 && keyStates[BLIPR_KEY_SHIFT_2]) ||
-                (j == 0 && i == 2 && keyStates[BLIPR_KEY_SHIFT_3]) ||
-                (j == 0 && i == 3 && keyStates[BLIPR_KEY_FUNC])/* ||
+                (j == 0 && i == 0 && (heldModifiers & BLIPR_MODIFIER_SHIFT_1)) ||
+                (j == 0 && i == 1 && (heldModifiers & BLIPR_MODIFIER_SHIFT_2)) ||
+                (j == 0 && i == 2 && (heldModifiers & BLIPR_MODIFIER_SHIFT_3)) ||
+                (j == 0 && i == 3 && (heldModifiers & BLIPR_MODIFIER_FUNC))/* ||
                 (j == 1 && i == 0 && keyStates[BLIPR_KEY_A]) ||
                 (j == 1 && i == 1 && keyStates[BLIPR_KEY_B]) ||
                 (j == 1 && i == 2 && keyStates[BLIPR_KEY_C]) ||
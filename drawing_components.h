@@ -34,9 +34,9 @@ void drawBPMIndiciator(int bpm);
 void drawPatternLengthIndicator(int current, int total);
 
 /**
- * Draw a basic 4x6 grid
+ * Draw a basic 4x6 grid, with the held modifiers (BLIPR_MODIFIER_*) pressed down
  */
-void drawBasicGrid(bool keyStates[SDL_NUM_SCANCODES]);
+void drawBasicGrid(unsigned char heldModifiers);
 
 /**
  * Draw a hightlighted grid tile in a given color (zero-based index)
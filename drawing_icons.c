@@ -1,13 +1,13 @@
 #include <SDL.h>
 #include "drawing_icons.h"
-#include "drawing.h"
 #include "colors.h"
 #include "constants.h"
+#include "globals.h"
+#include "framebuffer.h"
 
-#define ICON_WIDTH 19
-#define ICON_HEIGHT 19
+SDL_Texture* iconTexture = NULL;       // All icons, side by side
 
-const int icons[][ICON_WIDTH][ICON_HEIGHT] = {
+const uint8_t icons[][ICON_HEIGHT][ICON_WIDTH] = {   // Palette indexes (see iconColors), 0 is transparent
     // BLIPR_ICON_EMPTY
     {
         {0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0},
@@ -318,22 +318,64 @@ const int icons[][ICON_WIDTH][ICON_HEIGHT] = {
     }    
 };
 
-void drawIcon(int startX, int startY, Blipr_Icon icon) {
-    if (icon >= ARRAY_LENGTH(icons)) {
-        printf("Invalid icon index: %d\n", icon);
+uint32_t iconPixels[ARRAY_LENGTH(icons)][ICON_HEIGHT][ICON_WIDTH];     // The icons in the framebuffer format
+
+void initializeIconTextures() {
+    // All icons side by side in a single texture:
+    int iconCount = ARRAY_LENGTH(icons);
+    SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormat(0, iconCount * ICON_WIDTH, ICON_HEIGHT, 32, SDL_PIXELFORMAT_RGBA32);
+    if (surface == NULL) {
+        SDL_Log("Failed to create surface for the icons: %s", SDL_GetError());
         return;
     }
 
-    // Draw the character
-    for (int y = 0; y < ICON_WIDTH; y++) {
-        for (int x = 0; x < ICON_HEIGHT; x++) {
-            int colorIndex = icons[icon][y][x];
-            if (colorIndex > 0) {
+    SDL_LockSurface(surface);
+    Uint32* pixels = (Uint32*)surface->pixels;
+
+    for (int i = 0; i < iconCount; i++) {
+        for (int y = 0; y < ICON_HEIGHT; y++) {
+            for (int x = 0; x < ICON_WIDTH; x++) {
+                int colorIndex = icons[i][y][x];
                 SDL_Color color = iconColors[colorIndex];
-                drawPixel(startX + x, startY + y, color);
+                iconPixels[i][y][x] = colorIndex > 0 ? getFramebufferPixel(color) : 0;
+                pixels[(y * iconCount * ICON_WIDTH) + (i * ICON_WIDTH) + x] = colorIndex > 0 ?
+                    SDL_MapRGBA(surface->format, color.r, color.g, color.b, color.a) :
+                    SDL_MapRGBA(surface->format, 0, 0, 0, 0);
             }
         }
     }
+
+    SDL_UnlockSurface(surface);
+
+    iconTexture = SDL_CreateTextureFromSurface(renderer, surface);
+    SDL_SetTextureBlendMode(iconTexture, SDL_BLENDMODE_BLEND);
+    SDL_FreeSurface(surface);
+
+    if (iconTexture == NULL) {
+        SDL_Log("Failed to create texture for the icons: %s", SDL_GetError());
+    }
+}
+
+void cleanupIconTextures() {
+    if (iconTexture) {
+        SDL_DestroyTexture(iconTexture);
+        iconTexture = NULL;
+    }
+}
+
+void drawIcon(int startX, int startY, Blipr_Icon icon) {
+    if (icon >= ARRAY_LENGTH(icons)) {
+        printf("Invalid icon index: %d\n", icon);
+        return;
+    }
+
+    if (isFramebufferUsed) {
+        blitFramebufferPixels(startX, startY, &iconPixels[icon][0][0], ICON_WIDTH, ICON_HEIGHT, ICON_WIDTH);
+    } else if (iconTexture) {
+        SDL_Rect srcRect = {icon * ICON_WIDTH, 0, ICON_WIDTH, ICON_HEIGHT};
+        SDL_Rect destRect = {startX, startY, ICON_WIDTH, ICON_HEIGHT};
+        SDL_RenderCopy(renderer, iconTexture, &srcRect, &destRect);
+    }
 }
 
 void drawIconOnIndex(
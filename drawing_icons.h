@@ -3,6 +3,9 @@
 
 #include <SDL.h>
 
+#define ICON_WIDTH 19
+#define ICON_HEIGHT 19
+
 typedef enum {
     BLIPR_ICON_EMPTY = 0,
     BLIPR_ICON_UKNOWN = 1,
@@ -20,6 +23,16 @@ typedef enum {
     BLIPR_ICON_CRASH = 13,
 } Blipr_Icon;
 
+/**
+ * Compile the icons to a texture, so an icon is drawn with a single copy
+ */
+void initializeIconTextures();
+
+/**
+ * Cleanup the icon texture
+ */
+void cleanupIconTextures();
+
 void drawIcon(
     int startX, 
     int startY, 
@@ -1,13 +1,22 @@
 #include <SDL.h>
+#include <string.h>
 #include "drawing_text.h"
 #include "drawing.h"
 #include "constants.h"
 #include "colors.h"
 #include "globals.h"
+#include "framebuffer.h"
 
 #define NUM_CHARACTERS 55  // A-Z, 0-9, and special characters
+#define MAX_BATCHED_GLYPHS 64   // Glyphs per draw call, longer texts are drawn in multiple calls
 
-SDL_Texture* charTextures[NUM_CHARACTERS] = {NULL};
+SDL_Texture* glyphTexture = NULL;       // All characters, side by side
+signed char glyphIndexes[256];          // Index of every character in the glyph texture, -1 if it is not supported
+
+// The glyphs of a text are batched as quads with 2 triangles each:
+SDL_Vertex glyphVertices[MAX_BATCHED_GLYPHS * 4];
+int glyphVertexIndexes[MAX_BATCHED_GLYPHS * 6];
+int batchedGlyphs = 0;
 
 // Define the 5x5 matrix for each character
 // 1 represents a pixel to be drawn, 0 represents an empty space
@@ -344,89 +353,131 @@ const int characters[][CHAR_HEIGHT][CHAR_WIDTH] = {
      {1,0,0,0,0}}
 };
 
+/**
+ * Map the supported characters to their index in the characters-table
+ */
+static void initializeGlyphIndexes() {
+    memset(glyphIndexes, -1, sizeof(glyphIndexes));
+    for (int i = 0; i < 26; i++) {
+        glyphIndexes['A' + i] = i;
+    }
+    for (int i = 0; i < 10; i++) {
+        glyphIndexes['0' + i] = i + 26;     // 26 letters before numbers
+    }
+    const char *specialCharacters = ".,!?:-[]()^*&<>+#%/";
+    for (int i = 0; specialCharacters[i] != '\0'; i++) {
+        glyphIndexes[(unsigned char)specialCharacters[i]] = i + 36;
+    }
+
+    // The triangles of the quads are always the same:
+    for (int i = 0; i < MAX_BATCHED_GLYPHS; i++) {
+        int vertex = i * 4;
+        int *indexes = &glyphVertexIndexes[i * 6];
+        indexes[0] = vertex;
+        indexes[1] = vertex + 1;
+        indexes[2] = vertex + 2;
+        indexes[3] = vertex + 2;
+        indexes[4] = vertex + 1;
+        indexes[5] = vertex + 3;
+    }
+}
+
 void initializeTextures() {
-    for (int i = 0; i < NUM_CHARACTERS; i++) {
-        SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormat(0, CHAR_WIDTH, CHAR_HEIGHT, 32, SDL_PIXELFORMAT_RGBA32);
-        if (surface == NULL) {
-            SDL_Log("Failed to create surface for character %d: %s", i, SDL_GetError());
-            continue;
-        }
+    initializeGlyphIndexes();
 
-        SDL_LockSurface(surface);
-        Uint32* pixels = (Uint32*)surface->pixels;
+    // All characters side by side in a single texture:
+    SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormat(0, NUM_CHARACTERS * CHAR_WIDTH, CHAR_HEIGHT, 32, SDL_PIXELFORMAT_RGBA32);
+    if (surface == NULL) {
+        SDL_Log("Failed to create surface for the characters: %s", SDL_GetError());
+        return;
+    }
 
+    SDL_LockSurface(surface);
+    Uint32* pixels = (Uint32*)surface->pixels;
+
+    for (int i = 0; i < NUM_CHARACTERS; i++) {
         for (int y = 0; y < CHAR_HEIGHT; y++) {
             for (int x = 0; x < CHAR_WIDTH; x++) {
+                int offset = (y * NUM_CHARACTERS * CHAR_WIDTH) + (i * CHAR_WIDTH) + x;
                 if (characters[i][y][x] == 1) {
-                    pixels[y * CHAR_WIDTH + x] = SDL_MapRGBA(surface->format, 255, 255, 255, 255);
+                    pixels[offset] = SDL_MapRGBA(surface->format, 255, 255, 255, 255);
                 } else {
-                    pixels[y * CHAR_WIDTH + x] = SDL_MapRGBA(surface->format, 0, 0, 0, 0);
+                    pixels[offset] = SDL_MapRGBA(surface->format, 0, 0, 0, 0);
                 }
             }
         }
+    }
 
-        SDL_UnlockSurface(surface);
+    SDL_UnlockSurface(surface);
 
-        charTextures[i] = SDL_CreateTextureFromSurface(renderer, surface);
-        SDL_SetTextureBlendMode(charTextures[i], SDL_BLENDMODE_BLEND);
-        SDL_FreeSurface(surface);
+    glyphTexture = SDL_CreateTextureFromSurface(renderer, surface);
+    SDL_SetTextureBlendMode(glyphTexture, SDL_BLENDMODE_BLEND);
+    SDL_FreeSurface(surface);
 
-        if (charTextures[i] == NULL) {
-            SDL_Log("Failed to create texture for character %d: %s", i, SDL_GetError());
-        }
+    if (glyphTexture == NULL) {
+        SDL_Log("Failed to create texture for the characters: %s", SDL_GetError());
     }
 }
 
 void cleanupTextures() {
-    for (int i = 0; i < NUM_CHARACTERS; i++) {
-        if (charTextures[i]) {
-            SDL_DestroyTexture(charTextures[i]);
-            charTextures[i] = NULL;
-        }
+    if (glyphTexture) {
+        SDL_DestroyTexture(glyphTexture);
+        glyphTexture = NULL;
     }
 }
 
 /**
- * Draw a single character
+ * Draw the batched glyphs with a single call
  */
-void drawCharacter(int startX, int startY, const char character, SDL_Color color) {
-    int charIndex;
+static void flushGlyphs() {
+    if (batchedGlyphs == 0) {
+        return;
+    }
 
-    if (character >= 'A' && character <= 'Z') {
-        charIndex = character - 'A';
-    } else if (character >= '0' && character <= '9') {
-        charIndex = character - '0' + 26;  // 26 letters before numbers
-    } else {
-        switch (character) {
-            case '.': charIndex = 36; break;
-            case ',': charIndex = 37; break;
-            case '!': charIndex = 38; break;
-            case '?': charIndex = 39; break;
-            case ':': charIndex = 40; break;
-            case '-': charIndex = 41; break;
-            case '[': charIndex = 42; break;
-            case ']': charIndex = 43; break;
-            case '(': charIndex = 44; break;
-            case ')': charIndex = 45; break;
-            case '^': charIndex = 46; break;
-            case '*': charIndex = 47; break;
-            case '&': charIndex = 48; break;
-            case '<': charIndex = 49; break;
-            case '>': charIndex = 50; break;
-            case '+': charIndex = 51; break;
-            case '#': charIndex = 52; break;
-            case '%': charIndex = 53; break;
-            case '/': charIndex = 54; break;
-            default: return;  // Unsupported character
-        }
+    SDL_RenderGeometry(renderer, glyphTexture, glyphVertices, batchedGlyphs * 4, glyphVertexIndexes, batchedGlyphs * 6);
+
+    batchedGlyphs = 0;
+}
+
+/**
+ * Add a character to the batch, unsupported characters are skipped
+ */
+static void batchCharacter(int startX, int startY, const char character, SDL_Color color) {
+    int glyphIndex = glyphIndexes[(unsigned char)character];
+    if (glyphIndex < 0) {
+        return;
+    }
+
+    if (isFramebufferUsed) {
+        // Nothing to batch, the glyph can be drawn right away:
+        blitFramebufferMask(startX, startY, &characters[glyphIndex][0][0], CHAR_WIDTH, CHAR_HEIGHT, color);
+        return;
     }
 
-    // Draw the character
-    if (charTextures[charIndex]) {
-        SDL_Rect destRect = {startX, startY, CHAR_WIDTH, CHAR_HEIGHT};
-        SDL_SetTextureColorMod(charTextures[charIndex], color.r, color.g, color.b);
-        SDL_RenderCopy(renderer, charTextures[charIndex], NULL, &destRect);
+    if (glyphTexture == NULL) {
+        return;
     }
+
+    if (batchedGlyphs == MAX_BATCHED_GLYPHS) {
+        flushGlyphs();
+    }
+
+    float left = (float)glyphIndex / NUM_CHARACTERS;
+    float right = (float)(glyphIndex + 1) / NUM_CHARACTERS;
+    SDL_Vertex *vertex = &glyphVertices[batchedGlyphs * 4];
+    vertex[0] = (SDL_Vertex){{startX, startY}, color, {left, 0.0f}};
+    vertex[1] = (SDL_Vertex){{startX + CHAR_WIDTH, startY}, color, {right, 0.0f}};
+    vertex[2] = (SDL_Vertex){{startX, startY + CHAR_HEIGHT}, color, {left, 1.0f}};
+    vertex[3] = (SDL_Vertex){{startX + CHAR_WIDTH, startY + CHAR_HEIGHT}, color, {right, 1.0f}};
+    batchedGlyphs++;
+}
+
+/**
+ * Draw a single character
+ */
+void drawCharacter(int startX, int startY, const char character, SDL_Color color) {
+    batchCharacter(startX, startY, character, color);
+    flushGlyphs();
 }
 
 void drawText(int startX, int startY, const char* text, int maxWidth, SDL_Color color) {
@@ -461,13 +512,15 @@ void drawText(int startX, int startY, const char* text, int maxWidth, SDL_Color
                 }
             }
         } else {
-            // Draw the character
-            drawCharacter(currentX, currentY, *text, color);
+            // Add the character to the batch
+            batchCharacter(currentX, currentY, *text, color);
             currentX += (CHAR_WIDTH + CHAR_SPACING);
         }
 
         text++;
     }
+
+    flushGlyphs();
 }
 
 void drawCenteredLine(int startX, int startY, const char* text, int totalWidth, SDL_Color color) {
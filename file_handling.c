@@ -1,58 +1,820 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#include <time.h>
 #include "file_handling.h"
 #include "project.h"
+#include "constants.h"
 #include "print.h"
+#include "journal.h"
+#include "pulse_clock.h"
+
+#define MAX_SAVE_REGIONS (1 + (16 * 16))   // File header, and the patterns
+
+/**
+ * Where a pattern is stored in the project file
+ */
+struct PatternIndexEntry {
+    uint32_t offset;
+    uint32_t capacity;  // Room for the pattern at the offset, so it can grow a bit before it has to move
+    uint32_t length;    // 0 = empty pattern, nothing is stored
+    uint32_t crc;
+};
+
+// The project file that is mapped in memory, patterns are decoded from it when they are first used:
+static unsigned char *mappedProjectFile = NULL;
+static size_t mappedProjectFileSize = 0;
+static bool isPatternLoaded[16][16];
+
+// Where the patterns are in the project file, and where patterns that moved are appended:
+static struct PatternIndexEntry patternIndex[16][16];
+static uint32_t projectFileEnd = PATTERN_DATA_OFFSET;
+
+// What empty tracks, patterns and notes look like, only what differs from these is saved:
+static unsigned char emptyPatternHeaders[16][SMALL_HEADER_BYTE_SIZE];
+static unsigned char emptyTrackHeaders[16][SMALL_HEADER_BYTE_SIZE];
+static unsigned char emptyNote[NOTE_BYTE_SIZE];
+static pthread_once_t emptyDataOnce = PTHREAD_ONCE_INIT;
+
+// Autosave:
+static pthread_t autosaveThreadId;
+static pthread_mutex_t autosaveMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t autosaveCond = PTHREAD_COND_INITIALIZER;
+static bool isAutosaveRunning = false;
+static struct Project *autosaveProject = NULL;
+static const char *autosaveFileName = NULL;
+static pthread_mutex_t *autosaveProjectMutex = NULL;
+static int autosaveIntervalMs = 0;
+
+static void writeUint16(unsigned char *bytes, uint16_t value) {
+    memcpy(bytes, &value, 2);
+}
+
+static uint16_t readUint16(const unsigned char *bytes) {
+    uint16_t value;
+    memcpy(&value, bytes, 2);
+    return value;
+}
+
+static void writeUint32(unsigned char *bytes, uint32_t value) {
+    memcpy(bytes, &value, 4);
+}
+
+static uint32_t readUint32(const unsigned char *bytes) {
+    uint32_t value;
+    memcpy(&value, bytes, 4);
+    return value;
+}
 
 /**
- * Save project to file
+ * Encode an empty pattern once, to compare against
+ */
+static void initializeEmptyData() {
+    struct Pattern *pattern = malloc(sizeof(struct Pattern));
+    if (pattern == NULL) {
+        printError("Cannot allocate memory for pattern");
+        exit(1);
+    }
+
+    for (int i = 0; i < 16; i++) {
+        initializePattern(pattern, i);
+        patternHeaderToByteArray(pattern, emptyPatternHeaders[i]);
+        trackHeaderToByteArray(&pattern->tracks[i], emptyTrackHeaders[i]);
+    }
+    noteToByteArray(&pattern->tracks[0].steps[0].notes[0], emptyNote);
+    free(pattern);
+}
+
+/**
+ * Get the position of a pattern in a version 1 project file
+ */
+static size_t getVersion1PatternOffset(int sequence, int pattern) {
+    return LARGE_HEADER_BYTE_SIZE +
+        (sequence * SEQUENCE_BYTE_SIZE) +
+        SMALL_HEADER_BYTE_SIZE +
+        (pattern * PATTERN_BYTE_SIZE);
+}
+
+/**
+ * Get the room that is reserved for a pattern, so adding a few notes does not move it
+ */
+static uint32_t getPatternCapacity(uint32_t length) {
+    return length == 0 ? 0 : (length + (length / 4) + 63) & ~63u;
+}
+
+/**
+ * Check if a part of the project file is not used by any pattern
+ */
+static bool isFileSpaceFree(uint32_t offset, uint32_t capacity) {
+    for (int s = 0; s < 16; s++) {
+        for (int p = 0; p < 16; p++) {
+            const struct PatternIndexEntry *entry = &patternIndex[s][p];
+            if (entry->capacity > 0 && offset < entry->offset + entry->capacity && entry->offset < offset + capacity) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * Find room for a pattern in the space that patterns left when they moved, or else at the end of the file
+ */
+static uint32_t findPatternSpace(uint32_t capacity) {
+    // Free space always starts at the start of the data, or right after another pattern:
+    uint32_t offset = projectFileEnd;
+    if (isFileSpaceFree(PATTERN_DATA_OFFSET, capacity)) {
+        offset = PATTERN_DATA_OFFSET;
+    }
+    for (int s = 0; s < 16; s++) {
+        for (int p = 0; p < 16; p++) {
+            const struct PatternIndexEntry *entry = &patternIndex[s][p];
+            uint32_t end = entry->offset + entry->capacity;
+            if (entry->capacity > 0 && end < offset && isFileSpaceFree(end, capacity)) {
+                offset = end;
+            }
+        }
+    }
+    return offset;
+}
+
+/**
+ * Check if a pattern is in memory (and can be edited)
+ */
+static bool isPatternInMemory(int sequence, int pattern) {
+    return mappedProjectFile == NULL || isPatternLoaded[sequence][pattern];
+}
+
+/**
+ * Encode the notes and header of a track that differ from an empty track.
+ * Returns the number of bytes, or 0 if the track is empty
+ */
+static size_t encodeSparseTrack(const struct Track *track, int index, unsigned char bytes[SPARSE_TRACK_MAX_BYTE_SIZE]) {
+    trackHeaderToByteArray(track, bytes);
+    unsigned char *position = bytes + SMALL_HEADER_BYTE_SIZE + 2;
+    uint16_t noteCount = 0;
+    for (int s = 0; s < 64; s++) {
+        for (int n = 0; n < NOTES_IN_STEP; n++) {
+            noteToByteArray(&track->steps[s].notes[n], position + 2);
+            if (memcmp(position + 2, emptyNote, NOTE_BYTE_SIZE) != 0) {
+                writeUint16(position, (s * NOTES_IN_STEP) + n);
+                position += SPARSE_NOTE_BYTE_SIZE;
+                noteCount++;
+            }
+        }
+    }
+    writeUint16(bytes + SMALL_HEADER_BYTE_SIZE, noteCount);
+
+    if (noteCount == 0 && memcmp(bytes, emptyTrackHeaders[index], SMALL_HEADER_BYTE_SIZE) == 0) {
+        return 0;
+    }
+    return position - bytes;
+}
+
+/**
+ * Encode the tracks and header of a pattern that differ from an empty pattern.
+ * Returns the number of bytes, or 0 if the pattern is empty
+ */
+static size_t encodeSparsePattern(const struct Pattern *pattern, int index, unsigned char bytes[SPARSE_PATTERN_MAX_BYTE_SIZE]) {
+    patternHeaderToByteArray(pattern, bytes);
+    size_t length = SMALL_HEADER_BYTE_SIZE + 2;
+    uint16_t trackMask = 0;
+    for (int t = 0; t < 16; t++) {
+        size_t trackLength = encodeSparseTrack(&pattern->tracks[t], t, bytes + length);
+        if (trackLength > 0) {
+            trackMask |= 1 << t;
+            length += trackLength;
+        }
+    }
+    writeUint16(bytes + SMALL_HEADER_BYTE_SIZE, trackMask);
+
+    if (trackMask == 0 && memcmp(bytes, emptyPatternHeaders[index], SMALL_HEADER_BYTE_SIZE) == 0) {
+        return 0;
+    }
+    return length;
+}
+
+/**
+ * Decode a pattern, everything that is not stored is empty.
+ * Returns false if the data is not valid
+ */
+static bool decodeSparsePattern(struct Pattern *pattern, int index, const unsigned char *bytes, size_t length) {
+    initializePattern(pattern, index);
+    if (length == 0) {
+        return true;
+    }
+    if (length < SMALL_HEADER_BYTE_SIZE + 2) {
+        return false;
+    }
+
+    byteArrayToPatternHeader(pattern, bytes);
+    uint16_t trackMask = readUint16(bytes + SMALL_HEADER_BYTE_SIZE);
+    size_t position = SMALL_HEADER_BYTE_SIZE + 2;
+    for (int t = 0; t < 16; t++) {
+        if ((trackMask & (1 << t)) == 0) {
+            continue;
+        }
+        if (position + SMALL_HEADER_BYTE_SIZE + 2 > length) {
+            return false;
+        }
+
+        struct Track *track = &pattern->tracks[t];
+        byteArrayToTrackHeader(track, bytes + position);
+        uint16_t noteCount = readUint16(bytes + position + SMALL_HEADER_BYTE_SIZE);
+        position += SMALL_HEADER_BYTE_SIZE + 2;
+        if (position + ((size_t)noteCount * SPARSE_NOTE_BYTE_SIZE) > length) {
+            return false;
+        }
+
+        for (int i = 0; i < noteCount; i++) {
+            uint16_t noteIndex = readUint16(bytes + position);
+            if (noteIndex >= 64 * NOTES_IN_STEP) {
+                return false;
+            }
+            track->steps[noteIndex / NOTES_IN_STEP].notes[noteIndex % NOTES_IN_STEP] = byteArrayToNote(bytes + position + 2);
+            position += SPARSE_NOTE_BYTE_SIZE;
+        }
+        updateTrackNoteMasks(track);
+    }
+
+    return position == length;
+}
+
+/**
+ * Encode the project header and the sequence names in the header of the project file
+ */
+static void encodeProjectHeader(const struct Project *project, unsigned char bytes[PATTERN_DATA_OFFSET]) {
+    projectHeaderToByteArray(project, bytes + PROJECT_FILE_HEADER_BYTE_SIZE);
+    for (int s = 0; s < 16; s++) {
+        memcpy(bytes + PROJECT_FILE_HEADER_BYTE_SIZE + LARGE_HEADER_BYTE_SIZE + (s * 32), project->sequences[s].name, 32);
+    }
+}
+
+/**
+ * Encode the rest of the header of the project file: the version, the pattern index and the checksum.
+ * The project header must already be encoded with encodeProjectHeader()
+ */
+static void encodePatternIndex(unsigned char bytes[PATTERN_DATA_OFFSET]) {
+    memcpy(bytes, PROJECT_FILE_MAGIC, 4);
+    writeUint16(bytes + 4, PROJECT_FILE_VERSION);
+    writeUint16(bytes + 6, 0);
+    for (int s = 0; s < 16; s++) {
+        for (int p = 0; p < 16; p++) {
+            unsigned char *entry = bytes + PATTERN_INDEX_OFFSET + (((s * 16) + p) * PATTERN_INDEX_ENTRY_BYTE_SIZE);
+            writeUint32(entry, patternIndex[s][p].offset);
+            writeUint32(entry + 4, patternIndex[s][p].capacity);
+            writeUint32(entry + 8, patternIndex[s][p].length);
+            writeUint32(entry + 12, patternIndex[s][p].crc);
+        }
+    }
+    writeUint32(
+        bytes + 8, 
+        calculateCrc32(0, bytes + PROJECT_FILE_HEADER_BYTE_SIZE, PATTERN_DATA_OFFSET - PROJECT_FILE_HEADER_BYTE_SIZE)
+    );
+}
+
+/**
+ * Encode the header of the project file: the project header, sequence names and the pattern index
+ */
+static void encodeFileHeader(const struct Project *project, unsigned char bytes[PATTERN_DATA_OFFSET]) {
+    encodeProjectHeader(project, bytes);
+    encodePatternIndex(bytes);
+}
+
+/**
+ * Save project to file.
+ * The file is written next to the old one first, so the old file stays intact when saving fails
  */
 void writeProjectFile(struct Project *project, const char *fileName) {
-    FILE *file = fopen(fileName, "w");
+    pthread_once(&emptyDataOnce, initializeEmptyData);
+
+    // Everything is written again, so the mapping can not be used after this:
+    loadAllPatterns(project);
+    closeProjectFile();
+
+    char tempFileName[256];
+    snprintf(tempFileName, sizeof(tempFileName), "%s.tmp", fileName);
+    FILE *file = fopen(tempFileName, "wb");
 
     if (file == NULL) {
         printError("Error opening file for writing!");
         return;
     }
 
-    unsigned char *arr = malloc(PROJECT_BYTE_SIZE);
-    projectToByteArray(project, arr);
+    unsigned char *arr = malloc(SPARSE_PATTERN_MAX_BYTE_SIZE);
+    if (arr == NULL) {
+        printError("Cannot allocate memory for pattern");
+        fclose(file);
+        return;
+    }
 
     printLog("Saving project \"%s\"...", project->name);
-    fwrite(arr, PROJECT_BYTE_SIZE, 1, file);
+
+    // Patterns first, the header contains where they are:
+    uint32_t offset = PATTERN_DATA_OFFSET;
+    fseek(file, offset, SEEK_SET);
+    for (int s = 0; s < 16; s++) {
+        for (int p = 0; p < 16; p++) {
+            struct PatternIndexEntry *entry = &patternIndex[s][p];
+            uint32_t length = encodeSparsePattern(&project->sequences[s].patterns[p], p, arr);
+            entry->offset = length > 0 ? offset : 0;
+            entry->capacity = getPatternCapacity(length);
+            entry->length = length;
+            entry->crc = calculateCrc32(0, arr, length);
+            fwrite(arr, 1, length, file);
+            fseek(file, entry->capacity - length, SEEK_CUR);
+            offset += entry->capacity;
+        }
+    }
+    projectFileEnd = offset;
+
+    encodeFileHeader(project, arr);
+    fseek(file, 0, SEEK_SET);
+    fwrite(arr, PATTERN_DATA_OFFSET, 1, file);
     free(arr);
+
+    bool isWritten = fflush(file) == 0 && !ferror(file) && fsync(fileno(file)) == 0;
     fclose(file);
-    printLog("Saved project file.");
+    if (!isWritten || rename(tempFileName, fileName) != 0) {
+        printError("Error writing project file %s", fileName);
+        remove(tempFileName);
+        return;
+    }
+
+    printLog("Saved project file (%d bytes).", (int)offset);
 }
 
 /**
- * Read Project from file
+ * Read a version 1 project file (the whole project without a file header) from the mapped file,
+ * and save it in the current version, unless it is read-only. The original file is kept next to it
  */
-struct Project* readProjectFile(const char *fileName) {
-    FILE *file;
+static struct Project* convertVersion1ProjectFile(const char *fileName, bool isReadOnly) {
+    printLog("Converting version 1 project file...");
+
+    struct Project* project = malloc(sizeof(struct Project));
+    if (project == NULL) {
+        printError("Cannot allocate memory for project");
+        exit(1);
+    }
+
+    byteArrayToProjectHeader(project, mappedProjectFile);
+    for (int s = 0; s < 16; s++) {
+        memcpy(project->sequences[s].name, mappedProjectFile + LARGE_HEADER_BYTE_SIZE + (s * SEQUENCE_BYTE_SIZE), 32);
+        for (int p = 0; p < 16; p++) {
+            byteArrayToPattern(&project->sequences[s].patterns[p], mappedProjectFile + getVersion1PatternOffset(s, p));
+        }
+    }
+    closeProjectFile();
+
+    if (isReadOnly) {
+        return project;
+    }
+
+    char backupFileName[256];
+    snprintf(backupFileName, sizeof(backupFileName), "%s.v1", fileName);
+    if (rename(fileName, backupFileName) != 0) {
+        printWarning("Could not keep a copy of the version 1 project file");
+    }
+    writeProjectFile(project, fileName);
+
+    return project;
+}
+
+/**
+ * Read Project from file.
+ * Only the header and the first pattern are decoded, other patterns are decoded on first access with loadPattern().
+ * A read-only file is never written: an interrupted save is not completed, and a version 1 file is only converted in memory
+ */
+static struct Project* readProjectFileInMode(const char *fileName, bool isReadOnly, ProjectFileStatus *status) {
+    ProjectFileStatus ignoredStatus;
+    if (status == NULL) {
+        status = &ignoredStatus;
+    }
+    *status = PROJECT_FILE_OK;
+
+    pthread_once(&emptyDataOnce, initializeEmptyData);
+    closeProjectFile();
+
+    // Complete the last save if it was interrupted:
+    if (!isReadOnly) {
+        recoverJournal(fileName);
+    }
 
     // Open file
-    file = fopen(fileName, "rb");
-    if (file == NULL) {
-        printError("Error opening file");
+    int file = open(fileName, O_RDONLY);
+    if (file == -1) {
+        *status = errno == ENOENT ? PROJECT_FILE_MISSING : PROJECT_FILE_UNREADABLE;
+        if (*status == PROJECT_FILE_UNREADABLE) {
+            printError("Error opening file");
+        }
         return NULL;
     }
 
-    unsigned char *arr = malloc(PROJECT_BYTE_SIZE);
-    size_t bytesRead = fread(arr, 1, PROJECT_BYTE_SIZE, file);
-    fclose(file);
-
-    if (bytesRead != PROJECT_BYTE_SIZE) {
+    struct stat fileStat;
+    if (fstat(file, &fileStat) == -1) {
+        printError("Error reading file");
+        *status = PROJECT_FILE_UNREADABLE;
+        close(file);
+        return NULL;
+    }
+    if (fileStat.st_size < PROJECT_FILE_HEADER_BYTE_SIZE) {
         printError("Error reading file: unexpected file size");
+        *status = PROJECT_FILE_DAMAGED;
+        close(file);
         return NULL;
     }
 
-    struct Project* project = byteArrayToProject(arr);
-    free(arr);
+    size_t size = fileStat.st_size;
+    void *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+    if (map == MAP_FAILED) {
+        printError("Error mapping file");
+        *status = PROJECT_FILE_UNREADABLE;
+        return NULL;
+    }
+    mappedProjectFile = map;
+    mappedProjectFileSize = size;
+
+    // Patterns are read one at a time, so don't read ahead the whole file:
+    madvise(mappedProjectFile, size, MADV_RANDOM);
+
+    if (memcmp(mappedProjectFile, PROJECT_FILE_MAGIC, 4) != 0) {
+        // Version 1 files have no header, but always have the same size:
+        if (size == PROJECT_BYTE_SIZE) {
+            return convertVersion1ProjectFile(fileName, isReadOnly);
+        }
+        printError("Error reading file: not a project file");
+        *status = PROJECT_FILE_DAMAGED;
+        closeProjectFile();
+        return NULL;
+    }
+
+    uint16_t version = readUint16(mappedProjectFile + 4);
+    if (version != PROJECT_FILE_VERSION) {
+        printError("Error reading file: unsupported version %d", version);
+        *status = PROJECT_FILE_UNSUPPORTED;
+        closeProjectFile();
+        return NULL;
+    }
+
+    if (
+        size < PATTERN_DATA_OFFSET ||
+        readUint32(mappedProjectFile + 8) != calculateCrc32(
+            0, 
+            mappedProjectFile + PROJECT_FILE_HEADER_BYTE_SIZE, 
+            PATTERN_DATA_OFFSET - PROJECT_FILE_HEADER_BYTE_SIZE
+        )
+    ) {
+        printError("Error reading file: the header is damaged");
+        *status = PROJECT_FILE_DAMAGED;
+        closeProjectFile();
+        return NULL;
+    }
+
+    struct Project* project = malloc(sizeof(struct Project));
     if (project == NULL) {
-        printError("Failed to create project from byte array");
+        printError("Cannot allocate memory for project");
         exit(1);
     }
 
+    byteArrayToProjectHeader(project, mappedProjectFile + PROJECT_FILE_HEADER_BYTE_SIZE);
+    projectFileEnd = MAX(size, PATTERN_DATA_OFFSET);
+    for (int s = 0; s < 16; s++) {
+        memcpy(project->sequences[s].name, mappedProjectFile + PROJECT_FILE_HEADER_BYTE_SIZE + LARGE_HEADER_BYTE_SIZE + (s * 32), 32);
+        for (int p = 0; p < 16; p++) {
+            const unsigned char *entry = mappedProjectFile + PATTERN_INDEX_OFFSET + (((s * 16) + p) * PATTERN_INDEX_ENTRY_BYTE_SIZE);
+            patternIndex[s][p].offset = readUint32(entry);
+            patternIndex[s][p].capacity = readUint32(entry + 4);
+            patternIndex[s][p].length = readUint32(entry + 8);
+            patternIndex[s][p].crc = readUint32(entry + 12);
+            projectFileEnd = MAX(projectFileEnd, patternIndex[s][p].offset + patternIndex[s][p].capacity);
+            isPatternLoaded[s][p] = false;
+        }
+    }
+
+    // The first pattern plays when starting:
+    loadPattern(project, 0, 0);
+
+    return project;
+}
+
+struct Project* readProjectFile(const char *fileName, ProjectFileStatus *status) {
+    return readProjectFileInMode(fileName, false, status);
+}
+
+struct Project* readProjectFileReadOnly(const char *fileName, ProjectFileStatus *status) {
+    return readProjectFileInMode(fileName, true, status);
+}
+
+struct Project* openProjectFile(const char *fileName) {
+    ProjectFileStatus status;
+    struct Project *project = readProjectFile(fileName, &status);
+    if (project != NULL) {
+        printLog("Loaded project: %s", project->name);
+        return project;
+    }
+
+    // Only a missing file is created, anything else might still hold the patterns of the user:
+    if (status != PROJECT_FILE_MISSING) {
+        printError("Project file %s %s, it is left as it is", fileName, getProjectFileStatusText(status));
+        return NULL;
+    }
+
+    print("No project found, creating new project");
+    project = malloc(sizeof(struct Project));
+    if (project == NULL) {
+        printError("Cannot allocate memory for project");
+        exit(1);
+    }
+    initializeProject(project);
+    printLog("Project initialized");
+    writeProjectFile(project, fileName);
+    printLog("Project saved");
     return project;
-}
\ No newline at end of file
+}
+
+const char* getProjectFileStatusText(ProjectFileStatus status) {
+    switch (status) {
+        case PROJECT_FILE_OK:
+            return "is read";
+        case PROJECT_FILE_MISSING:
+            return "does not exist";
+        case PROJECT_FILE_UNREADABLE:
+            return "cannot be read";
+        case PROJECT_FILE_DAMAGED:
+            return "is damaged";
+        case PROJECT_FILE_UNSUPPORTED:
+            return "is saved in an unsupported version";
+    }
+    return "cannot be read";
+}
+
+/**
+ * Decode a pattern from the mapped project file, an empty pattern is decoded if it is damaged
+ */
+static void decodePatternFromFile(int sequence, int pattern, struct Pattern *decodedPattern) {
+    const struct PatternIndexEntry *entry = &patternIndex[sequence][pattern];
+    bool isValid = entry->length == 0 || (
+        (size_t)entry->offset + entry->length <= mappedProjectFileSize &&
+        calculateCrc32(0, mappedProjectFile + entry->offset, entry->length) == entry->crc
+    );
+
+    if (!isValid || !decodeSparsePattern(decodedPattern, pattern, mappedProjectFile + entry->offset, entry->length)) {
+        // Leave the data in the file alone, it is not overwritten unless the pattern is edited:
+        printError("Pattern %d of sequence %d is damaged, loading an empty pattern", pattern + 1, sequence + 1);
+        initializePattern(decodedPattern, pattern);
+    }
+}
+
+void loadPattern(struct Project *project, int sequence, int pattern) {
+    if (isPatternInMemory(sequence, pattern)) {
+        return;
+    }
+
+    decodePatternFromFile(sequence, pattern, &project->sequences[sequence].patterns[pattern]);
+    isPatternLoaded[sequence][pattern] = true;
+}
+
+bool decodePattern(int sequence, int pattern, struct Pattern *decodedPattern) {
+    if (isPatternInMemory(sequence, pattern)) {
+        return false;
+    }
+
+    decodePatternFromFile(sequence, pattern, decodedPattern);
+    return true;
+}
+
+void storeDecodedPattern(struct Project *project, int sequence, int pattern, const struct Pattern *decodedPattern) {
+    if (isPatternInMemory(sequence, pattern)) {
+        return;
+    }
+
+    project->sequences[sequence].patterns[pattern] = *decodedPattern;
+    isPatternLoaded[sequence][pattern] = true;
+}
+
+void loadAllPatterns(struct Project *project) {
+    for (int s = 0; s < 16; s++) {
+        for (int p = 0; p < 16; p++) {
+            loadPattern(project, s, p);
+        }
+    }
+}
+
+void closeProjectFile() {
+    if (mappedProjectFile != NULL) {
+        munmap(mappedProjectFile, mappedProjectFileSize);
+        mappedProjectFile = NULL;
+        mappedProjectFileSize = 0;
+    }
+}
+
+/**
+ * Add a dirty region, the data is already in the buffer
+ */
+static unsigned char* addSaveRegion(struct JournalRegion *regions, int *count, unsigned char *buffer, size_t offset, size_t length) {
+    regions[*count].offset = offset;
+    regions[*count].length = length;
+    regions[*count].data = buffer;
+    (*count)++;
+    return buffer + length;
+}
+
+/**
+ * Check if a pattern or one of its tracks has changes that are not saved yet
+ */
+static bool isPatternDirty(const struct Pattern *pattern) {
+    bool isDirty = pattern->isDirty;
+    for (int t = 0; t < 16; t++) {
+        isDirty = isDirty || pattern->tracks[t].isDirty;
+    }
+    return isDirty;
+}
+
+/**
+ * Count the patterns that have changes that are not saved yet
+ */
+static int countDirtyPatterns(const struct Project *project) {
+    int dirtyPatterns = 0;
+    for (int s = 0; s < 16; s++) {
+        for (int p = 0; p < 16; p++) {
+            if (isPatternInMemory(s, p) && isPatternDirty(&project->sequences[s].patterns[p])) {
+                dirtyPatterns++;
+            }
+        }
+    }
+    return dirtyPatterns;
+}
+
+struct SaveStats saveDirtyRegions(struct Project *project, const char *fileName, pthread_mutex_t *mutex) {
+    pthread_once(&emptyDataOnce, initializeEmptyData);
+    struct SaveStats stats = {0};
+    static struct JournalRegion regions[MAX_SAVE_REGIONS];
+    static int savedPatternIndexes[16 * 16];
+    int count = 0;
+
+    // Memory for the copies is allocated up front, so the lock is only held to copy what changed:
+    if (mutex != NULL) {
+        pthread_mutex_lock(mutex);
+    }
+    int dirtyPatterns = countDirtyPatterns(project);
+    bool isProjectDirty = project->isDirty;
+    if (mutex != NULL) {
+        pthread_mutex_unlock(mutex);
+    }
+    if (!isProjectDirty && dirtyPatterns == 0) {
+        return stats;
+    }
+
+    struct Pattern *patterns = malloc(MAX(1, dirtyPatterns) * sizeof(struct Pattern));
+    unsigned char *buffer = malloc(PATTERN_DATA_OFFSET + ((size_t)dirtyPatterns * SPARSE_PATTERN_MAX_BYTE_SIZE));
+    if (patterns == NULL || buffer == NULL) {
+        printError("Cannot allocate memory to save the project");
+        free(patterns);
+        free(buffer);
+        return stats;
+    }
+
+    // Take a snapshot of everything that changed. Patterns that changed in the meantime are saved the next time:
+    uint64_t startNs = getMonotonicTimeNs();
+    if (mutex != NULL) {
+        pthread_mutex_lock(mutex);
+    }
+    int savedPatterns = 0;
+    for (int s = 0; s < 16 && savedPatterns < dirtyPatterns; s++) {
+        for (int p = 0; p < 16 && savedPatterns < dirtyPatterns; p++) {
+            struct Pattern *pattern = &project->sequences[s].patterns[p];
+            if (!isPatternInMemory(s, p) || !isPatternDirty(pattern)) {
+                continue;
+            }
+
+            patterns[savedPatterns] = *pattern;
+            savedPatternIndexes[savedPatterns] = (s * 16) + p;
+            savedPatterns++;
+            pattern->isDirty = false;
+            for (int t = 0; t < 16; t++) {
+                pattern->tracks[t].isDirty = false;
+            }
+        }
+    }
+    encodeProjectHeader(project, buffer);
+    project->isDirty = false;
+    if (mutex != NULL) {
+        pthread_mutex_unlock(mutex);
+    }
+    stats.lockNs = getMonotonicTimeNs() - startNs;
+
+    // Encode and write the snapshot, without holding the lock:
+    startNs = getMonotonicTimeNs();
+    unsigned char *position = buffer + PATTERN_DATA_OFFSET;
+    for (int i = 0; i < savedPatterns; i++) {
+        int p = savedPatternIndexes[i] % 16;
+        struct PatternIndexEntry *entry = &patternIndex[savedPatternIndexes[i] / 16][p];
+        uint32_t length = encodeSparsePattern(&patterns[i], p, position);
+        if (length > entry->capacity) {
+            // Does not fit anymore, move it:
+            entry->capacity = 0;
+            entry->offset = findPatternSpace(getPatternCapacity(length));
+            entry->capacity = getPatternCapacity(length);
+            projectFileEnd = MAX(projectFileEnd, entry->offset + entry->capacity);
+        }
+        entry->length = length;
+        entry->crc = calculateCrc32(0, position, length);
+        if (length > 0) {
+            position = addSaveRegion(regions, &count, position, entry->offset, length);
+        }
+    }
+
+    // The header is written with every change, since it contains the pattern index:
+    encodePatternIndex(buffer);
+    addSaveRegion(regions, &count, buffer, 0, PATTERN_DATA_OFFSET);
+
+    if (writeRegionsJournaled(fileName, regions, count)) {
+        stats.regions = count;
+        stats.bytes = position - buffer;
+    } else {
+        // Keep the changes, so they are saved the next time:
+        if (mutex != NULL) {
+            pthread_mutex_lock(mutex);
+        }
+        for (int i = 0; i < savedPatterns; i++) {
+            project->sequences[savedPatternIndexes[i] / 16].patterns[savedPatternIndexes[i] % 16].isDirty = true;
+        }
+        project->isDirty = true;
+        if (mutex != NULL) {
+            pthread_mutex_unlock(mutex);
+        }
+    }
+    stats.writeNs = getMonotonicTimeNs() - startNs;
+    free(buffer);
+    free(patterns);
+
+    return stats;
+}
+
+/**
+ * Thread that saves the changes of the project every interval
+ */
+static void* autosaveThread(void *arg) {
+    (void)arg;
+
+    pthread_mutex_lock(&autosaveMutex);
+    while (isAutosaveRunning) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        uint64_t deadlineNs = timespecToNs(&deadline) + ((uint64_t)autosaveIntervalMs * 1000000);
+        deadline.tv_sec = deadlineNs / NANOS_PER_SEC;
+        deadline.tv_nsec = deadlineNs % NANOS_PER_SEC;
+        pthread_cond_timedwait(&autosaveCond, &autosaveMutex, &deadline);
+        if (!isAutosaveRunning) {
+            break;
+        }
+
+        pthread_mutex_unlock(&autosaveMutex);
+        struct SaveStats stats = saveDirtyRegions(autosaveProject, autosaveFileName, autosaveProjectMutex);
+        if (stats.regions > 0) {
+            printLog(
+                "Autosaved %d regions (%d bytes), locked for %lluns, written in %.1fms", 
+                stats.regions, 
+                (int)stats.bytes, 
+                (unsigned long long)stats.lockNs, 
+                stats.writeNs / 1000000.0
+            );
+        }
+        pthread_mutex_lock(&autosaveMutex);
+    }
+    pthread_mutex_unlock(&autosaveMutex);
+
+    return NULL;
+}
+
+void startAutosave(struct Project *project, const char *fileName, pthread_mutex_t *mutex, int intervalMs) {
+    autosaveProject = project;
+    autosaveFileName = fileName;
+    autosaveProjectMutex = mutex;
+    autosaveIntervalMs = intervalMs;
+    isAutosaveRunning = true;
+    pthread_create(&autosaveThreadId, NULL, autosaveThread, NULL);
+}
+
+void stopAutosave() {
+    if (!isAutosaveRunning) {
+        return;
+    }
+
+    pthread_mutex_lock(&autosaveMutex);
+    isAutosaveRunning = false;
+    pthread_cond_signal(&autosaveCond);
+    pthread_mutex_unlock(&autosaveMutex);
+    pthread_join(autosaveThreadId, NULL);
+
+    // Save what changed since the last autosave:
+    saveDirtyRegions(autosaveProject, autosaveFileName, autosaveProjectMutex);
+}
@@ -1,9 +1,125 @@
 #ifndef FILE_HANDLING_H
 #define FILE_HANDLING_H
 
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
 #include "project.h"
 
+/**
+ * Project file, version 2. Only what differs from an empty project is stored:
+ * byte 0-3     : Magic ("BLPR")
+ * byte 4-5     : Version
+ * byte 6-7     : Spare
+ * byte 8-11    : CRC-32 of the rest of the header (project header, sequence names and pattern index)
+ * byte 12-267  : Project header
+ * byte 268-779 : Sequence names (16 x 32 bytes)
+ * byte 780-... : Pattern index (16 x 16 entries: offset, capacity, length, CRC-32), a length of 0 is an empty pattern
+ * after that   : Pattern data
+ *
+ * Pattern data:
+ * byte 0-63    : Pattern header
+ * byte 64-65   : Mask of the tracks that are stored
+ * per track    : Track header (64 bytes), number of notes (2 bytes), and per note its index (step * 8 + slot, 2 bytes) and data
+ *
+ * Version 1 files (the whole project, without a header) are converted when they are read
+ */
+#define PROJECT_FILE_MAGIC "BLPR"
+#define PROJECT_FILE_VERSION 2
+#define PROJECT_FILE_HEADER_BYTE_SIZE 12
+#define PATTERN_INDEX_ENTRY_BYTE_SIZE 16
+#define PATTERN_INDEX_OFFSET (PROJECT_FILE_HEADER_BYTE_SIZE + LARGE_HEADER_BYTE_SIZE + (16 * 32))
+#define PATTERN_DATA_OFFSET (PATTERN_INDEX_OFFSET + (16 * 16 * PATTERN_INDEX_ENTRY_BYTE_SIZE))
+#define SPARSE_NOTE_BYTE_SIZE (2 + NOTE_BYTE_SIZE)
+#define SPARSE_TRACK_MAX_BYTE_SIZE (SMALL_HEADER_BYTE_SIZE + 2 + (64 * NOTES_IN_STEP * SPARSE_NOTE_BYTE_SIZE))
+#define SPARSE_PATTERN_MAX_BYTE_SIZE (SMALL_HEADER_BYTE_SIZE + 2 + (16 * SPARSE_TRACK_MAX_BYTE_SIZE))
+
+/**
+ * Why a project file could not be read
+ */
+typedef enum {
+    PROJECT_FILE_OK = 0,
+    PROJECT_FILE_MISSING = 1,       // There is no file yet
+    PROJECT_FILE_UNREADABLE = 2,    // The file exists, but cannot be opened or mapped
+    PROJECT_FILE_DAMAGED = 3,       // Not a project file, or the header does not match its CRC
+    PROJECT_FILE_UNSUPPORTED = 4,   // Saved in a version this build cannot read
+} ProjectFileStatus;
+
+/**
+ * Statistics of an incremental save
+ */
+struct SaveStats {
+    int regions;        // Number of regions (the file header and patterns) that were written
+    size_t bytes;
+    uint64_t lockNs;    // Time the project was locked to take a snapshot
+    uint64_t writeNs;   // Time it took to write the snapshot
+};
+
 void writeProjectFile(struct Project *project, const char *fileName);
-struct Project* readProjectFile(const char *fileName);
 
-#endif
\ No newline at end of file
+/**
+ * Read a project file. Returns NULL if it cannot be read, the reason is stored in status (if not NULL)
+ */
+struct Project* readProjectFile(const char *fileName, ProjectFileStatus *status);
+
+/**
+ * Read a project file without ever writing to it (no journal recovery, no conversion of version 1 files on disk)
+ */
+struct Project* readProjectFileReadOnly(const char *fileName, ProjectFileStatus *status);
+
+/**
+ * Read the project file, or create a new project file if there is none.
+ * A file that exists but cannot be read is never overwritten: NULL is returned instead
+ */
+struct Project* openProjectFile(const char *fileName);
+
+/**
+ * Get a description of why a project file could not be read
+ */
+const char* getProjectFileStatusText(ProjectFileStatus status);
+
+/**
+ * Make sure a pattern is decoded from the project file before it is used
+ */
+void loadPattern(struct Project *project, int sequence, int pattern);
+
+/**
+ * Decode a pattern from the project file in a buffer, without changing the project. Returns false if the
+ * pattern is already loaded. The pattern and its place in the file are only changed by loading it, so this
+ * can run without a lock while only one thread loads patterns
+ */
+bool decodePattern(int sequence, int pattern, struct Pattern *decodedPattern);
+
+/**
+ * Store a pattern that was decoded with decodePattern() in the project, unless it is loaded already
+ */
+void storeDecodedPattern(struct Project *project, int sequence, int pattern, const struct Pattern *decodedPattern);
+
+/**
+ * Decode all patterns that are not loaded yet
+ */
+void loadAllPatterns(struct Project *project);
+
+/**
+ * Release the mapped project file (patterns that are not loaded yet can no longer be loaded)
+ */
+void closeProjectFile();
+
+/**
+ * Write only the parts of the project that changed (the patterns with dirty headers or tracks) to an existing project file.
+ * A pattern is written in place when it still fits, otherwise it is moved to the end of the file.
+ * The mutex (if not NULL) is held while the changes are collected, but not while writing
+ */
+struct SaveStats saveDirtyRegions(struct Project *project, const char *fileName, pthread_mutex_t *mutex);
+
+/**
+ * Start saving the changes of the project in the background, every interval
+ */
+void startAutosave(struct Project *project, const char *fileName, pthread_mutex_t *mutex, int intervalMs);
+
+/**
+ * Stop the autosave, and save the last changes
+ */
+void stopAutosave();
+
+#endif
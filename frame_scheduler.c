@@ -0,0 +1,81 @@
+#include "frame_scheduler.h"
+#include "constants.h"
+#include "print.h"
+
+#define NANOS_PER_MILLI 1000000ULL
+
+void initializeFrameScheduler(struct FrameScheduler *scheduler, int fps, uint64_t nowNs) {
+    scheduler->periodNs = fps > 0 ? NANOS_PER_SEC / fps : 0;
+    scheduler->nextFrameNs = nowNs;
+}
+
+int getFrameTimeoutMs(const struct FrameScheduler *scheduler, uint64_t nowNs) {
+    if (scheduler->periodNs == 0) {
+        return FRAME_IDLE_TIMEOUT_MS;
+    }
+    if (scheduler->nextFrameNs <= nowNs) {
+        return 0;
+    }
+    // Round up, waking up early would only cause another wait:
+    return (int)((scheduler->nextFrameNs - nowNs + NANOS_PER_MILLI - 1) / NANOS_PER_MILLI);
+}
+
+bool isFrameDue(struct FrameScheduler *scheduler, uint64_t nowNs) {
+    if (nowNs < scheduler->nextFrameNs) {
+        return false;
+    }
+
+    scheduler->nextFrameNs += scheduler->periodNs;
+    if (scheduler->nextFrameNs <= nowNs) {
+        // Fell behind (or unlimited), continue from now:
+        scheduler->nextFrameNs = nowNs + scheduler->periodNs;
+    }
+
+    return true;
+}
+
+int getFrameTimeBucket(uint64_t frameTimeNs) {
+    int bucket = 0;
+    uint64_t limitNs = NANOS_PER_MILLI;
+    while (bucket < FRAME_TIME_BUCKETS - 1 && frameTimeNs >= limitNs) {
+        bucket++;
+        limitNs *= 2;
+    }
+    return bucket;
+}
+
+void resetFrameStats(struct FrameStats *stats) {
+    stats->drawnFrames = 0;
+    stats->skippedFrames = 0;
+    stats->maxFrameTimeNs = 0;
+    for (int i = 0; i < FRAME_TIME_BUCKETS; i++) {
+        stats->histogram[i] = 0;
+    }
+}
+
+void recordFrameTime(struct FrameStats *stats, uint64_t frameTimeNs) {
+    stats->drawnFrames++;
+    stats->maxFrameTimeNs = MAX(stats->maxFrameTimeNs, frameTimeNs);
+    stats->histogram[getFrameTimeBucket(frameTimeNs)]++;
+}
+
+void recordSkippedFrame(struct FrameStats *stats) {
+    stats->skippedFrames++;
+}
+
+void printFrameStats(const struct FrameStats *stats) {
+    print(
+        "Drew %llu frames (skipped %llu, max %lluns), frame times <1ms: %llu, <2ms: %llu, <4ms: %llu, <8ms: %llu, <16ms: %llu, <32ms: %llu, <64ms: %llu, more: %llu",
+        (unsigned long long)stats->drawnFrames,
+        (unsigned long long)stats->skippedFrames,
+        (unsigned long long)stats->maxFrameTimeNs,
+        (unsigned long long)stats->histogram[0],
+        (unsigned long long)stats->histogram[1],
+        (unsigned long long)stats->histogram[2],
+        (unsigned long long)stats->histogram[3],
+        (unsigned long long)stats->histogram[4],
+        (unsigned long long)stats->histogram[5],
+        (unsigned long long)stats->histogram[6],
+        (unsigned long long)stats->histogram[7]
+    );
+}
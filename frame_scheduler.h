@@ -0,0 +1,72 @@
+#ifndef FRAME_SCHEDULER_H
+#define FRAME_SCHEDULER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define FRAME_TIME_BUCKETS 8        // <1ms, <2ms, <4ms, <8ms, <16ms, <32ms, <64ms and the rest
+#define FRAME_IDLE_TIMEOUT_MS 50    // Longest wait without a frame limit, publishing a snapshot wakes the renderer earlier
+
+/**
+ * Paces the renderer to a target frame rate. Render requests that come in between 2 frames are
+ * coalesced into the next frame, so the renderer never draws more often than the display can show,
+ * no matter how often the sequencer or the keys publish a new snapshot.
+ */
+struct FrameScheduler {
+    uint64_t periodNs;          // Time between 2 frames, 0 draws as soon as something is published
+    uint64_t nextFrameNs;       // Deadline of the next frame (monotonic time)
+};
+
+/**
+ * Statistics on how long the frames took to draw
+ */
+struct FrameStats {
+    uint64_t drawnFrames;
+    uint64_t skippedFrames;     // Frames where nothing visible changed
+    uint64_t maxFrameTimeNs;
+    uint64_t histogram[FRAME_TIME_BUCKETS];
+};
+
+/**
+ * Initialize a frame scheduler for the given frames per second (0 is unlimited), the first frame is due right away
+ */
+void initializeFrameScheduler(struct FrameScheduler *scheduler, int fps, uint64_t nowNs);
+
+/**
+ * Get how many milliseconds there are left until the next frame is due.
+ * Without a frame limit a frame is always due, so wait until something is published (at most FRAME_IDLE_TIMEOUT_MS)
+ */
+int getFrameTimeoutMs(const struct FrameScheduler *scheduler, uint64_t nowNs);
+
+/**
+ * Check if the next frame is due, and schedule the one after it if so.
+ * When the renderer fell behind, the missed frames are dropped instead of drawn in a burst
+ */
+bool isFrameDue(struct FrameScheduler *scheduler, uint64_t nowNs);
+
+/**
+ * Get the histogram bucket of a frame time
+ */
+int getFrameTimeBucket(uint64_t frameTimeNs);
+
+/**
+ * Reset frame statistics
+ */
+void resetFrameStats(struct FrameStats *stats);
+
+/**
+ * Record the time it took to draw a frame
+ */
+void recordFrameTime(struct FrameStats *stats, uint64_t frameTimeNs);
+
+/**
+ * Record a frame that was not drawn, because nothing visible changed
+ */
+void recordSkippedFrame(struct FrameStats *stats);
+
+/**
+ * Print the frame statistics
+ */
+void printFrameStats(const struct FrameStats *stats);
+
+#endif
@@ -0,0 +1,135 @@
+#include <SDL.h>
+#include <stdlib.h>
+#include <string.h>
+#include "framebuffer.h"
+
+bool isFramebufferUsed = false;
+uint32_t framebuffer[WIDTH * HEIGHT];
+
+uint32_t getFramebufferPixel(SDL_Color color) {
+    return ((uint32_t)color.r << 24) | ((uint32_t)color.g << 16) | ((uint32_t)color.b << 8) | color.a;
+}
+
+/**
+ * Blend a color over a pixel, like SDL_BLENDMODE_BLEND does
+ */
+static uint32_t blendFramebufferPixel(uint32_t pixel, SDL_Color color) {
+    uint32_t r = (color.r * color.a + ((pixel >> 24) & 0xFF) * (255 - color.a)) / 255;
+    uint32_t g = (color.g * color.a + ((pixel >> 16) & 0xFF) * (255 - color.a)) / 255;
+    uint32_t b = (color.b * color.a + ((pixel >> 8) & 0xFF) * (255 - color.a)) / 255;
+    uint32_t a = color.a + ((pixel & 0xFF) * (255 - color.a)) / 255;
+    return (r << 24) | (g << 16) | (b << 8) | a;
+}
+
+void clearFramebuffer(SDL_Color color) {
+    uint32_t pixel = getFramebufferPixel(color);
+    for (int i = 0; i < WIDTH * HEIGHT; i++) {
+        framebuffer[i] = pixel;
+    }
+}
+
+void fillFramebufferRect(int x, int y, int width, int height, SDL_Color color) {
+    // Clip:
+    int left = x < 0 ? 0 : x;
+    int top = y < 0 ? 0 : y;
+    int right = x + width > WIDTH ? WIDTH : x + width;
+    int bottom = y + height > HEIGHT ? HEIGHT : y + height;
+    if (left >= right || top >= bottom) {
+        return;
+    }
+
+    if (color.a == 0xFF) {
+        // Fill the first line, and copy it to the others:
+        uint32_t pixel = getFramebufferPixel(color);
+        uint32_t *firstLine = &framebuffer[top * WIDTH + left];
+        for (int column = 0; column < right - left; column++) {
+            firstLine[column] = pixel;
+        }
+        for (int row = top + 1; row < bottom; row++) {
+            memcpy(&framebuffer[row * WIDTH + left], firstLine, (right - left) * sizeof(uint32_t));
+        }
+    } else if (color.a > 0) {
+        for (int row = top; row < bottom; row++) {
+            uint32_t *line = &framebuffer[row * WIDTH];
+            for (int column = left; column < right; column++) {
+                line[column] = blendFramebufferPixel(line[column], color);
+            }
+        }
+    }
+}
+
+void drawFramebufferPixel(int x, int y, SDL_Color color) {
+    fillFramebufferRect(x, y, 1, 1, color);
+}
+
+void drawFramebufferLine(int x1, int y1, int x2, int y2, SDL_Color color) {
+    // Horizontal and vertical lines are just thin rectangles:
+    if (y1 == y2) {
+        int left = x1 < x2 ? x1 : x2;
+        fillFramebufferRect(left, y1, abs(x2 - x1) + 1, 1, color);
+        return;
+    }
+    if (x1 == x2) {
+        int top = y1 < y2 ? y1 : y2;
+        fillFramebufferRect(x1, top, 1, abs(y2 - y1) + 1, color);
+        return;
+    }
+
+    // Bresenham for everything else:
+    int dx = abs(x2 - x1);
+    int dy = -abs(y2 - y1);
+    int stepX = x1 < x2 ? 1 : -1;
+    int stepY = y1 < y2 ? 1 : -1;
+    int error = dx + dy;
+    while (true) {
+        drawFramebufferPixel(x1, y1, color);
+        if (x1 == x2 && y1 == y2) {
+            break;
+        }
+        int doubleError = 2 * error;
+        if (doubleError >= dy) {
+            error += dy;
+            x1 += stepX;
+        }
+        if (doubleError <= dx) {
+            error += dx;
+            y1 += stepY;
+        }
+    }
+}
+
+void blitFramebufferMask(int x, int y, const int *mask, int width, int height, SDL_Color color) {
+    uint32_t pixel = getFramebufferPixel(color);
+    for (int row = 0; row < height; row++) {
+        int targetY = y + row;
+        if (targetY < 0 || targetY >= HEIGHT) {
+            continue;
+        }
+        for (int column = 0; column < width; column++) {
+            int targetX = x + column;
+            if (mask[row * width + column] == 1 && targetX >= 0 && targetX < WIDTH) {
+                framebuffer[targetY * WIDTH + targetX] = pixel;
+            }
+        }
+    }
+}
+
+void blitFramebufferPixels(int x, int y, const uint32_t *pixels, int width, int height, int pitch) {
+    for (int row = 0; row < height; row++) {
+        int targetY = y + row;
+        if (targetY < 0 || targetY >= HEIGHT) {
+            continue;
+        }
+        for (int column = 0; column < width; column++) {
+            int targetX = x + column;
+            uint32_t pixel = pixels[row * pitch + column];
+            if ((pixel & 0xFF) != 0 && targetX >= 0 && targetX < WIDTH) {
+                framebuffer[targetY * WIDTH + targetX] = pixel;
+            }
+        }
+    }
+}
+
+void uploadFramebuffer(SDL_Texture *texture) {
+    SDL_UpdateTexture(texture, NULL, framebuffer, WIDTH * sizeof(uint32_t));
+}
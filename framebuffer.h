@@ -0,0 +1,59 @@
+#ifndef FRAMEBUFFER_H
+#define FRAMEBUFFER_H
+
+#include <SDL.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "constants.h"
+
+// Pixel format of the framebuffer, so it can be uploaded as is:
+#define FRAMEBUFFER_FORMAT SDL_PIXELFORMAT_RGBA8888
+
+/**
+ * Software renderer for the UI: instead of sending every primitive to the SDL renderer, the drawing
+ * functions write directly in a plain buffer that is uploaded once per frame.
+ */
+extern bool isFramebufferUsed;
+extern uint32_t framebuffer[WIDTH * HEIGHT];
+
+/**
+ * Convert a color to a pixel in the framebuffer format
+ */
+uint32_t getFramebufferPixel(SDL_Color color);
+
+/**
+ * Fill the whole framebuffer with a single color
+ */
+void clearFramebuffer(SDL_Color color);
+
+/**
+ * Fill a rectangle, clipped to the framebuffer
+ */
+void fillFramebufferRect(int x, int y, int width, int height, SDL_Color color);
+
+/**
+ * Draw a line, including both end points
+ */
+void drawFramebufferLine(int x1, int y1, int x2, int y2, SDL_Color color);
+
+/**
+ * Draw a single pixel
+ */
+void drawFramebufferPixel(int x, int y, SDL_Color color);
+
+/**
+ * Draw the set pixels of a mask (1 is drawn, 0 is skipped) in a single color, used for the glyphs
+ */
+void blitFramebufferMask(int x, int y, const int *mask, int width, int height, SDL_Color color);
+
+/**
+ * Copy pixels in the framebuffer format, pixels without alpha are skipped. Used for the icons
+ */
+void blitFramebufferPixels(int x, int y, const uint32_t *pixels, int width, int height, int pitch);
+
+/**
+ * Upload the framebuffer to a streaming texture of WIDTH x HEIGHT in FRAMEBUFFER_FORMAT
+ */
+void uploadFramebuffer(SDL_Texture *texture);
+
+#endif
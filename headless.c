@@ -0,0 +1,124 @@
+#include <SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "headless.h"
+#include "print.h"
+
+static const struct {
+    const char *name;
+    SDL_Scancode scancode;
+} headlessKeys[] = {
+    {"1", BLIPR_KEY_1}, {"2", BLIPR_KEY_2}, {"3", BLIPR_KEY_3}, {"4", BLIPR_KEY_4},
+    {"5", BLIPR_KEY_5}, {"6", BLIPR_KEY_6}, {"7", BLIPR_KEY_7}, {"8", BLIPR_KEY_8},
+    {"9", BLIPR_KEY_9}, {"10", BLIPR_KEY_10}, {"11", BLIPR_KEY_11}, {"12", BLIPR_KEY_12},
+    {"13", BLIPR_KEY_13}, {"14", BLIPR_KEY_14}, {"15", BLIPR_KEY_15}, {"16", BLIPR_KEY_16},
+    {"A", BLIPR_KEY_A}, {"B", BLIPR_KEY_B}, {"C", BLIPR_KEY_C}, {"D", BLIPR_KEY_D},
+    {"SHIFT1", BLIPR_KEY_SHIFT_1}, {"SHIFT2", BLIPR_KEY_SHIFT_2}, {"SHIFT3", BLIPR_KEY_SHIFT_3},
+    {"FUNC", BLIPR_KEY_FUNC},
+};
+
+static const char *headlessScreenNames[HEADLESS_SCREEN_COUNT] = {
+    [BLIPR_SCREEN_NONE] = "none",
+    [BLIPR_SCREEN_TRACK_OPTIONS] = "track options",
+    [BLIPR_SCREEN_PATTERN_OPTIONS] = "pattern options",
+    [BLIPR_SCREEN_UTILITIES] = "utilities",
+    [BLIPR_SCREEN_CONFIGURATION] = "configuration",
+    [BLIPR_SCREEN_TRANSPORT] = "transport",
+    [BLIPR_SCREEN_TRACK_SELECTION] = "track selection",
+    [BLIPR_SCREEN_PATTERN_SELECTION] = "pattern selection",
+    [BLIPR_SCREEN_SEQUENCE_SELECTION] = "sequence selection",
+    [BLIPR_SCREEN_PROGRAM_SELECTION] = "program selection",
+    [BLIPR_SCREEN_SEQUENCER] = "sequencer",
+    [BLIPR_SCREEN_NO_PROGRAM] = "no program",
+    [BLIPR_SCREEN_FOUR_ON_THE_FLOOR] = "four on the floor",
+    [BLIPR_SCREEN_DRUMKIT_SEQUENCER] = "drumkit sequencer",
+};
+
+/**
+ * Get the scancode of a key name, returns SDL_SCANCODE_UNKNOWN if the name is unknown
+ */
+static SDL_Scancode getHeadlessKey(const char *name) {
+    for (size_t i = 0; i < ARRAY_LENGTH(headlessKeys); i++) {
+        if (strcmp(headlessKeys[i].name, name) == 0) {
+            return headlessKeys[i].scancode;
+        }
+    }
+    return SDL_SCANCODE_UNKNOWN;
+}
+
+bool parseHeadlessCommand(const char *line, struct HeadlessCommand *command) {
+    char name[16];
+    char argument[HEADLESS_PATH_LENGTH];
+    int budgetUs = 0;
+    memset(command, 0, sizeof(struct HeadlessCommand));
+
+    int fields = sscanf(line, " %15s %255s %d", name, argument, &budgetUs);
+    if (fields <= 0 || name[0] == '#') {
+        return true;
+    }
+    if (fields < 2) {
+        return false;
+    }
+
+    if (strcmp(name, "down") == 0) {
+        command->type = HEADLESS_COMMAND_KEY_DOWN;
+    } else if (strcmp(name, "up") == 0) {
+        command->type = HEADLESS_COMMAND_KEY_UP;
+    } else if (strcmp(name, "press") == 0) {
+        command->type = HEADLESS_COMMAND_KEY_PRESS;
+    } else if (strcmp(name, "render") == 0) {
+        command->type = HEADLESS_COMMAND_RENDER;
+        command->count = atoi(argument);
+        command->budgetUs = budgetUs;
+        return command->count > 0 && budgetUs >= 0;
+    } else if (strcmp(name, "snapshot") == 0) {
+        command->type = HEADLESS_COMMAND_SNAPSHOT;
+        strcpy(command->path, argument);
+        return fields == 2;
+    } else {
+        return false;
+    }
+
+    command->scancode = getHeadlessKey(argument);
+    return fields == 2 && command->scancode != SDL_SCANCODE_UNKNOWN;
+}
+
+bool writeFramePPM(const char *path, const uint32_t *pixels, int width, int height) {
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) {
+        printError("Unable to write snapshot: %s", path);
+        return false;
+    }
+
+    fprintf(file, "P6\n%d %d\n255\n", width, height);
+    for (int i = 0; i < width * height; i++) {
+        uint8_t rgb[3] = {pixels[i] >> 24, pixels[i] >> 16, pixels[i] >> 8};
+        fwrite(rgb, 1, 3, file);
+    }
+
+    return fclose(file) == 0;
+}
+
+void recordHeadlessRenderTime(struct HeadlessRenderStats *stats, BliprScreen screen, uint64_t elapsedNs) {
+    if (screen >= HEADLESS_SCREEN_COUNT) {
+        return;
+    }
+    stats->frames[screen]++;
+    stats->totalNs[screen] += elapsedNs;
+    stats->maxNs[screen] = MAX(stats->maxNs[screen], elapsedNs);
+}
+
+void printHeadlessRenderStats(const struct HeadlessRenderStats *stats) {
+    for (int i = 0; i < HEADLESS_SCREEN_COUNT; i++) {
+        if (stats->frames[i] > 0) {
+            print(
+                "Rendered %s %llu times in %lluns on average (max %lluns)",
+                headlessScreenNames[i],
+                (unsigned long long)stats->frames[i],
+                (unsigned long long)(stats->totalNs[i] / stats->frames[i]),
+                (unsigned long long)stats->maxNs[i]
+            );
+        }
+    }
+}
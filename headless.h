@@ -0,0 +1,70 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include <SDL.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "constants.h"
+
+#define HEADLESS_PATH_LENGTH 256
+#define HEADLESS_SCREEN_COUNT (BLIPR_SCREEN_DRUMKIT_SEQUENCER + 1)
+
+/**
+ * The commands of a headless script, one per line:
+ *
+ *   down <key>             Key down (keys: 1-16, A-D, SHIFT1-3 and FUNC)
+ *   up <key>               Key up
+ *   press <key>            Key down and up
+ *   render <count> [us]    Draw the complete frame a number of times, for measuring. With a budget in
+ *                          microseconds, the run fails if a frame took longer than that on average
+ *   snapshot <file>        Write the current frame as PPM
+ *
+ * Empty lines and lines starting with # are ignored
+ */
+typedef enum {
+    HEADLESS_COMMAND_NONE = 0,
+    HEADLESS_COMMAND_KEY_DOWN = 1,
+    HEADLESS_COMMAND_KEY_UP = 2,
+    HEADLESS_COMMAND_KEY_PRESS = 3,
+    HEADLESS_COMMAND_RENDER = 4,
+    HEADLESS_COMMAND_SNAPSHOT = 5,
+} HeadlessCommandType;
+
+struct HeadlessCommand {
+    HeadlessCommandType type;
+    SDL_Scancode scancode;
+    int count;
+    int budgetUs;           // Maximum average render time, 0 is no budget
+    char path[HEADLESS_PATH_LENGTH];
+};
+
+/**
+ * Render times per screen
+ */
+struct HeadlessRenderStats {
+    uint64_t frames[HEADLESS_SCREEN_COUNT];
+    uint64_t totalNs[HEADLESS_SCREEN_COUNT];
+    uint64_t maxNs[HEADLESS_SCREEN_COUNT];
+};
+
+/**
+ * Parse a line of a headless script, returns false if it is not a valid command
+ */
+bool parseHeadlessCommand(const char *line, struct HeadlessCommand *command);
+
+/**
+ * Write a frame (in the RGBA8888 format) as a binary PPM file
+ */
+bool writeFramePPM(const char *path, const uint32_t *pixels, int width, int height);
+
+/**
+ * Record how long it took to draw a screen
+ */
+void recordHeadlessRenderTime(struct HeadlessRenderStats *stats, BliprScreen screen, uint64_t elapsedNs);
+
+/**
+ * Print the render times of all drawn screens
+ */
+void printHeadlessRenderStats(const struct HeadlessRenderStats *stats);
+
+#endif
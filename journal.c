@@ -0,0 +1,184 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#include "journal.h"
+#include "print.h"
+
+#define JOURNAL_MAGIC 0x4A504C42      // "BLPJ"
+#define JOURNAL_HEADER_SIZE 12          // Magic, region count, size of the journal
+#define JOURNAL_REGION_HEADER_SIZE 8    // Offset, length
+
+static uint32_t crcTable[256];
+static pthread_once_t crcTableOnce = PTHREAD_ONCE_INIT;
+
+/**
+ * Fill the lookup table for CRC-32 (IEEE polynomial)
+ */
+static void initializeCrcTable() {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320 : crc >> 1;
+        }
+        crcTable[i] = crc;
+    }
+}
+
+uint32_t calculateCrc32(uint32_t crc, const unsigned char *data, size_t length) {
+    // Checksums are calculated by the autosave, key & main threads:
+    pthread_once(&crcTableOnce, initializeCrcTable);
+
+    crc = ~crc;
+    for (size_t i = 0; i < length; i++) {
+        crc = crcTable[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+/**
+ * Get the file name of the journal for a file
+ */
+static void getJournalFileName(const char *fileName, char *journalFileName, size_t size) {
+    snprintf(journalFileName, size, "%s.journal", fileName);
+}
+
+static void writeUint32(unsigned char *bytes, uint32_t value) {
+    memcpy(bytes, &value, 4);
+}
+
+static uint32_t readUint32(const unsigned char *bytes) {
+    uint32_t value;
+    memcpy(&value, bytes, 4);
+    return value;
+}
+
+/**
+ * Write all bytes at an offset, returns false on error
+ */
+static bool writeAt(int file, const unsigned char *data, size_t length, off_t offset) {
+    while (length > 0) {
+        ssize_t written = pwrite(file, data, length, offset);
+        if (written <= 0) {
+            return false;
+        }
+        data += written;
+        length -= written;
+        offset += written;
+    }
+    return true;
+}
+
+/**
+ * Write the regions of a (complete) journal to the file
+ */
+static bool applyJournal(const char *fileName, const unsigned char *journal) {
+    int file = open(fileName, O_WRONLY);
+    if (file == -1) {
+        printError("Error opening file for writing: %s", fileName);
+        return false;
+    }
+
+    uint32_t count = readUint32(journal + 4);
+    const unsigned char *position = journal + JOURNAL_HEADER_SIZE;
+    bool isWritten = true;
+    for (uint32_t i = 0; i < count && isWritten; i++) {
+        uint32_t offset = readUint32(position);
+        uint32_t length = readUint32(position + 4);
+        isWritten = writeAt(file, position + JOURNAL_REGION_HEADER_SIZE, length, offset);
+        position += JOURNAL_REGION_HEADER_SIZE + length;
+    }
+
+    isWritten = isWritten && fsync(file) == 0;
+    close(file);
+    return isWritten;
+}
+
+bool writeRegionsJournaled(const char *fileName, const struct JournalRegion *regions, int count) {
+    // Journal: header, regions (offset, length, data), CRC-32 of everything before it:
+    size_t size = JOURNAL_HEADER_SIZE + sizeof(uint32_t);
+    for (int i = 0; i < count; i++) {
+        size += JOURNAL_REGION_HEADER_SIZE + regions[i].length;
+    }
+
+    unsigned char *journal = malloc(size);
+    if (journal == NULL) {
+        printError("Cannot allocate memory for journal");
+        return false;
+    }
+
+    writeUint32(journal, JOURNAL_MAGIC);
+    writeUint32(journal + 4, count);
+    writeUint32(journal + 8, size);
+    unsigned char *position = journal + JOURNAL_HEADER_SIZE;
+    for (int i = 0; i < count; i++) {
+        writeUint32(position, regions[i].offset);
+        writeUint32(position + 4, regions[i].length);
+        memcpy(position + JOURNAL_REGION_HEADER_SIZE, regions[i].data, regions[i].length);
+        position += JOURNAL_REGION_HEADER_SIZE + regions[i].length;
+    }
+    writeUint32(position, calculateCrc32(0, journal, size - sizeof(uint32_t)));
+
+    // The journal must be on disk before the file is touched:
+    char journalFileName[256];
+    getJournalFileName(fileName, journalFileName, sizeof(journalFileName));
+    int file = open(journalFileName, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (file == -1) {
+        printError("Error opening journal for writing: %s", journalFileName);
+        free(journal);
+        return false;
+    }
+    bool isWritten = writeAt(file, journal, size, 0) && fsync(file) == 0;
+    close(file);
+
+    isWritten = isWritten && applyJournal(fileName, journal);
+    free(journal);
+
+    // Only remove the journal when the file is complete, otherwise it is recovered on the next start:
+    if (isWritten) {
+        unlink(journalFileName);
+    } else {
+        printError("Error writing to %s, changes are kept in the journal", fileName);
+    }
+    return isWritten;
+}
+
+void recoverJournal(const char *fileName) {
+    char journalFileName[256];
+    getJournalFileName(fileName, journalFileName, sizeof(journalFileName));
+
+    FILE *file = fopen(journalFileName, "rb");
+    if (file == NULL) {
+        // No journal, so the last write was completed:
+        return;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    unsigned char *journal = size > JOURNAL_HEADER_SIZE ? malloc(size) : NULL;
+    bool isComplete = journal != NULL && fread(journal, 1, size, file) == (size_t)size;
+    fclose(file);
+
+    // A journal is only complete with the right size and checksum:
+    isComplete = isComplete &&
+        readUint32(journal) == JOURNAL_MAGIC &&
+        readUint32(journal + 8) == (uint32_t)size &&
+        readUint32(journal + size - sizeof(uint32_t)) == calculateCrc32(0, journal, size - sizeof(uint32_t));
+
+    if (isComplete) {
+        printWarning("Recovering interrupted save of %s", fileName);
+        if (applyJournal(fileName, journal)) {
+            unlink(journalFileName);
+        }
+    } else {
+        printWarning("Discarding incomplete journal of %s", fileName);
+        unlink(journalFileName);
+    }
+
+    free(journal);
+}
@@ -0,0 +1,36 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * A part of a file that needs to be (over)written
+ */
+struct JournalRegion {
+    uint32_t offset;
+    uint32_t length;
+    const unsigned char *data;
+};
+
+/**
+ * Calculate the CRC-32 of a block of data.
+ * Pass 0 as crc for the first block, or the result of the previous block to continue
+ */
+uint32_t calculateCrc32(uint32_t crc, const unsigned char *data, size_t length);
+
+/**
+ * Write regions to a file, at their offsets.
+ * The regions are first written to a journal next to the file, so a write that is interrupted
+ * can be completed with recoverJournal(). Returns false if the regions could not be written
+ */
+bool writeRegionsJournaled(const char *fileName, const struct JournalRegion *regions, int count);
+
+/**
+ * Complete a journaled write that was interrupted.
+ * An incomplete journal is discarded, the file was not touched yet in that case
+ */
+void recoverJournal(const char *fileName);
+
+#endif
@@ -0,0 +1,77 @@
+#include "key_queue.h"
+
+void initializeKeyQueue(struct KeyQueue *queue) {
+    atomic_init(&queue->head, 0);
+    atomic_init(&queue->tail, 0);
+    atomic_init(&queue->isClosed, false);
+    pthread_mutex_init(&queue->mutex, NULL);
+    pthread_cond_init(&queue->cond, NULL);
+}
+
+void cleanupKeyQueue(struct KeyQueue *queue) {
+    pthread_mutex_destroy(&queue->mutex);
+    pthread_cond_destroy(&queue->cond);
+}
+
+bool pushKeyEvent(struct KeyQueue *queue, const struct KeyEvent *event) {
+    unsigned int tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    unsigned int head = atomic_load_explicit(&queue->head, memory_order_acquire);
+    if (tail - head == KEY_QUEUE_SIZE) {
+        return false;
+    }
+
+    queue->events[tail & (KEY_QUEUE_SIZE - 1)] = *event;
+    atomic_store_explicit(&queue->tail, tail + 1, memory_order_release);
+
+    // Wake up the consumer (the lock prevents a lost wake-up between its empty-check and wait):
+    pthread_mutex_lock(&queue->mutex);
+    pthread_cond_signal(&queue->cond);
+    pthread_mutex_unlock(&queue->mutex);
+
+    return true;
+}
+
+/**
+ * Check if there is an event to pop (consumer side)
+ */
+static bool isKeyQueueEmpty(struct KeyQueue *queue) {
+    unsigned int head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    return head == atomic_load_explicit(&queue->tail, memory_order_acquire);
+}
+
+bool popKeyEvent(struct KeyQueue *queue, struct KeyEvent *event) {
+    if (isKeyQueueEmpty(queue)) {
+        pthread_mutex_lock(&queue->mutex);
+        while (isKeyQueueEmpty(queue) && !atomic_load(&queue->isClosed)) {
+            pthread_cond_wait(&queue->cond, &queue->mutex);
+        }
+        pthread_mutex_unlock(&queue->mutex);
+
+        if (isKeyQueueEmpty(queue)) {
+            return false;
+        }
+    }
+
+    unsigned int head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    *event = queue->events[head & (KEY_QUEUE_SIZE - 1)];
+    atomic_store_explicit(&queue->head, head + 1, memory_order_release);
+
+    return true;
+}
+
+void closeKeyQueue(struct KeyQueue *queue) {
+    pthread_mutex_lock(&queue->mutex);
+    atomic_store(&queue->isClosed, true);
+    pthread_cond_broadcast(&queue->cond);
+    pthread_mutex_unlock(&queue->mutex);
+}
+
+void recordKeyLatency(struct KeyLatencyStats *stats, const struct KeyEvent *event) {
+    uint32_t latencyMs = SDL_GetTicks() - event->timestamp;
+    stats->events++;
+    stats->totalLatencyMs += latencyMs;
+    stats->lastLatencyMs = latencyMs;
+    if (latencyMs > stats->maxLatencyMs) {
+        stats->maxLatencyMs = latencyMs;
+    }
+}
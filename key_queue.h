@@ -0,0 +1,76 @@
+#ifndef KEY_QUEUE_H
+#define KEY_QUEUE_H
+
+#include <SDL.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#define KEY_QUEUE_SIZE 64   // Must be a power of 2
+
+/**
+ * A single key down or key up event
+ */
+struct KeyEvent {
+    SDL_Scancode scancode;
+    bool isKeyDown;
+    uint32_t timestamp;     // SDL event timestamp (in ms)
+};
+
+/**
+ * Bounded single-producer/single-consumer ring buffer of key events.
+ * The SDL thread pushes, the key thread pops. The ring itself is lock-free,
+ * the mutex and condition are only used to let the consumer sleep while the ring is empty.
+ */
+struct KeyQueue {
+    struct KeyEvent events[KEY_QUEUE_SIZE];
+    atomic_uint head;               // Next event to pop, only written by the consumer
+    atomic_uint tail;               // Next free slot, only written by the producer
+    atomic_bool isClosed;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+};
+
+/**
+ * Latency statistics, from the SDL event timestamp to the completion of the handler
+ */
+struct KeyLatencyStats {
+    uint64_t events;
+    uint64_t totalLatencyMs;
+    uint32_t maxLatencyMs;
+    uint32_t lastLatencyMs;
+};
+
+/**
+ * Initialize an empty key queue
+ */
+void initializeKeyQueue(struct KeyQueue *queue);
+
+/**
+ * Destroy the synchronization primitives of the queue
+ */
+void cleanupKeyQueue(struct KeyQueue *queue);
+
+/**
+ * Push an event to the queue (producer side). Returns false if the queue is full
+ */
+bool pushKeyEvent(struct KeyQueue *queue, const struct KeyEvent *event);
+
+/**
+ * Pop an event from the queue (consumer side), blocks while the queue is empty.
+ * Returns false if the queue is closed
+ */
+bool popKeyEvent(struct KeyQueue *queue, struct KeyEvent *event);
+
+/**
+ * Close the queue, wakes up a blocked consumer
+ */
+void closeKeyQueue(struct KeyQueue *queue);
+
+/**
+ * Record the latency of a handled key event
+ */
+void recordKeyLatency(struct KeyLatencyStats *stats, const struct KeyEvent *event);
+
+#endif
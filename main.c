@@ -5,6 +5,7 @@
 #include <time.h>
 #include <sys/resource.h>
 #include <pthread.h>
+#include <stdatomic.h>
 #include <unistd.h>
 #include "globals.h"
 #include "colors.h"
@@ -12,10 +13,12 @@
 #include "drawing.h"
 #include "drawing_text.h"
 #include "drawing_icons.h"
+#include "framebuffer.h"
 #include "constants.h"
 #include "project.h"
 #include "file_handling.h"
 #include "programs/sequencer.h"
+#include "programs/sequencer_timeline.h"
 #include "programs/track_selection.h"
 #include "programs/pattern_selection.h"
 #include "programs/sequence_selection.h"
@@ -26,6 +29,13 @@
 #include "programs/pattern_options.h"
 #include "midi.h"
 #include "print.h"
+#include "pulse_clock.h"
+#include "midi_clock.h"
+#include "key_queue.h"
+#include "render_snapshot.h"
+#include "renderer.h"
+#include "headless.h"
+#include "frame_scheduler.h"
 
 // Renderer:
 SDL_Renderer *renderer = NULL;
@@ -33,28 +43,22 @@ SDL_Renderer *renderer = NULL;
 // For debugging & monitoring:
 bool isMidiDataLogged = false;
 bool isTimeMeasured = false;
+uint64_t spinTailNs = 0;                    // Busy-wait the last part before a pulse deadline to compensate wake-up latency
+int autosaveIntervalMs = 5000;              // Interval to save changes of the project in the background, 0 is disabled
+int targetFps = 60;                         // Frames per second the renderer draws at most, 0 is unlimited
+char *clockInputDeviceName = NULL;          // Follow the MIDI clock of this input device, instead of the internal clock
 
 struct timespec seqStartTime, seqEndTime;   // To monitor sequencer performance
 struct timespec renStartTime, renEndTime;   // To monitor renderer performance
+uint64_t startTimeNs = 0;                   // To monitor the time until the first pulse is played
 
 // Project file
 char *projectFile = "data.blipr";
 
 #define INPUT_BUFFER_SIZE 100
 #define OUTPUT_BUFFER_SIZE 100
-
-/**
- * Calculate nano seconds per pulse for a given BPM
- */
-uint64_t calculateNanoSecondsPerPulse(int bpm) {
-    printLog("Calculating ns per pulse for %d BPM", bpm);
-    double beatsPerSecond = bpm / 60.0;
-    double secondsPerQuarterNote = 1.0 / beatsPerSecond;
-    uint64_t nanoSecondsPerQuarterNote = secondsPerQuarterNote * NANOS_PER_SEC;
-    uint64_t ns = nanoSecondsPerQuarterNote / PPQN_MULTIPLIED;
-    printLog("ns per pulse: %d", ns);
-    return ns;
-}
+#define MIDI_CLOCK_POLL_NS 200000           // Interval to read the MIDI clock input, and to check for new ticks
+#define MIDI_CLOCK_READ_SIZE 32             // Messages read from the MIDI clock input at once
 
 /**
  * Get the time difference between 2 times
@@ -71,10 +75,6 @@ uint64_t getTimespecDiffInNanoSeconds(struct timespec *start, struct timespec *e
     return temp.tv_sec * 1000000000LL + temp.tv_nsec;
 }
 
-uint64_t timespecToNs(struct timespec *ts) {
-    return (uint64_t)ts->tv_sec * 1000000000LL + (uint64_t)ts->tv_nsec;
-}
-
 /**
  * Check for flags
  */
@@ -87,13 +87,31 @@ bool checkFlag(int argc, char *argv[], char *flag) {
     return false;
 }
 
+/**
+ * Get the value of a flag in the form of --flag=value, returns NULL if the flag is not set
+ */
+char* getFlagValue(int argc, char *argv[], char *flag) {
+    size_t length = strlen(flag);
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], flag, length) == 0 && argv[i][length] == '=') {
+            return &argv[i][length + 1];
+        }
+    }
+    return NULL;
+}
+
 // Shared data structure between threads
 typedef struct {
     struct Project *project;
     struct Track* track;
     int unprocessedPulses;              // Pulses are count with unprocessed pulses in the clock thread.
+    uint64_t sequencerLagCount;         // How often the sequencer fell behind (more than 1 unprocessed pulse)
     uint64_t ppqnCounter;               // The ppqn counter is kept in the sequencer track in conjunction with the unprocessedPulses counter. This way skipped pulses can be caught.
-    bool isRenderRequired;
+    bool isRestartRequired;             // The external clock started, the sequencer should play from the start on the next pulse
+    struct MidiClock midiClock;         // External clock, written by the MIDI clock thread and followed by the timer thread
+    atomic_ullong midiClockUpdates;     // Updates of the external clock, so the timer thread only locks when it changed
+    bool isSnapshotRequired;            // The key thread changed something, the sequencer should publish a new render snapshot
+    uint32_t editCount;                 // Increased on every key event, so the renderer knows it has to redraw everything
     bool keyStates[SDL_NUM_SCANCODES];
     
     bool isSetupMidiDevicesRequired;    // Boolean flag to determine if midi devices needs to be set-up (required after changing midi assignment)
@@ -110,25 +128,44 @@ typedef struct {
     BliprScreen screen;
     bool quit;
     int bpm;    // shortcut to BPM, only used for displaying
-    uint64_t nanoSecondsPerPulse;
-    SDL_Scancode scanCodeKeyDown;
-    SDL_Scancode scanCodeKeyUp;
+    uint64_t pulsePeriod;               // Nanoseconds per pulse in 32.32 fixed-point, drives the clock
+    uint64_t nanoSecondsPerPulse;       // Whole nanoseconds per pulse, only used for measurements
+    struct KeyQueue keyQueue;           // Key events from the SDL thread to the key thread
+    Uint32 renderEventType;             // SDL event that wakes the renderer when a snapshot is published, 0 if not used
+    atomic_bool isRenderEventPending;   // So only one wake-up event is queued at a time
+    struct KeyLatencyStats keyLatencyStats;
 
     int selectedTrack;
     int selectedPattern;
     int queuedPattern;
     uint64_t patternStepCounter;       // Is in steps
     int selectedSequence;
+    struct TransitionContext transition;    // Pattern transition & fill state, for the trig conditions
+    struct RenderSnapshotBuffer renderSnapshots;    // From the sequencer thread to the renderer
 
     // For monitoring:
     double seqPerformance;
-    double renPerformance;
+    uint64_t seqMutexHoldNs;            // Time the sequencer held the mutex since the last report
+    uint64_t seqMutexMaxHoldNs;         // Longest time the sequencer held the mutex at once
+    struct PulseSchedulerStats clockStats;
+    uint64_t pulseTimeNs;               // Deadline of the last pulse of the clock (monotonic time)
+    int64_t midiLeadTimeUs;             // Smallest lead time of timestamped MIDI events in the last pulse
 
     // Synchronization primitives
     pthread_mutex_t mutex;
     pthread_cond_t cond;
 } SharedState;
 
+/**
+ * Set the tempo of the clock
+ */
+void setBPM(SharedState *state, int bpm) {
+    state->bpm = bpm;
+    state->pulsePeriod = calculatePulsePeriod(bpm);
+    state->nanoSecondsPerPulse = state->pulsePeriod >> 32;
+    printLog("%d BPM: %d ns per pulse", bpm, (int)state->nanoSecondsPerPulse);
+}
+
 /**
  * Set the screen according to the current active track program
  */
@@ -149,14 +186,38 @@ void setScreenAccordingToActiveTrack(SharedState *state) {
     }
 }
 
+/**
+ * Get the project to replay a headless script on: a new project, or a project file that is never written to.
+ * Returns NULL if the project file cannot be read
+ */
+static struct Project* openHeadlessProject(const char *fileName) {
+    if (fileName != NULL) {
+        print("Loading project file (read-only): %s", fileName);
+        return readProjectFileReadOnly(fileName, NULL);
+    }
+
+    struct Project *project = malloc(sizeof(struct Project));
+    if (project == NULL) {
+        printError("Memory allocation failed");
+        exit(1);
+    }
+    initializeProject(project);
+    return project;
+}
+
 /**
  * Initialize shared state
  */
-void initSharedState(SharedState* state) {
+void initSharedState(SharedState* state, struct Project *project) {
     state->unprocessedPulses = 0;
+    state->sequencerLagCount = 0;
     state->ppqnCounter = 0;
+    state->isRestartRequired = false;
+    initializeMidiClock(&state->midiClock);
+    atomic_init(&state->midiClockUpdates, 0);
 
-    state->isRenderRequired = false;
+    state->isSnapshotRequired = true;   // Draw the first frame
+    state->editCount = 0;
     for (int i=0; i<SDL_NUM_SCANCODES; i++) {
         state->keyStates[i] = false;
     }
@@ -170,35 +231,25 @@ void initSharedState(SharedState* state) {
     state->queuedPattern = 0;
     state->patternStepCounter = 0;
     state->selectedSequence = 0;
+    state->transition = (struct TransitionContext){0};
+    initializeRenderSnapshotBuffer(&state->renderSnapshots);
+    state->renderEventType = 0;
+    atomic_init(&state->isRenderEventPending, false);
     state->quit = false;
     state->bpm = 0;
-    state->scanCodeKeyDown = SDL_SCANCODE_UNKNOWN;
-    state->scanCodeKeyUp = SDL_SCANCODE_UNKNOWN;
+    initializeKeyQueue(&state->keyQueue);
+    state->keyLatencyStats = (struct KeyLatencyStats){0};
     state->seqPerformance = 0.0;
-    state->renPerformance = 0.0;
-
-    // Project file:
-    print("Loading project file: %s", projectFile);
-    state->project = readProjectFile(projectFile);
-    if (state->project == NULL) {
-        print("No project found, creating new project");
-        state->project = malloc(PROJECT_BYTE_SIZE);
-        if (state->project == NULL) {
-            printError("Memory allocation failed");
-        } else {
-            printLog("Memory allocated succesfully");
-        }
-        initializeProject(state->project);
-        printLog("Project initialized");
-        writeProjectFile(state->project, projectFile);
-        printLog("Project saved");
-    } else {
-        printLog("Loaded project: %s", state->project->name);
-    }
-    
+    state->seqMutexHoldNs = 0;
+    state->seqMutexMaxHoldNs = 0;
+    resetPulseSchedulerStats(&state->clockStats);
+    state->pulseTimeNs = 0;
+    state->midiLeadTimeUs = 0;
+
+    state->project = project;
+
     // Get the BPM from the current pattern:
-    state->bpm = state->project->sequences[0].patterns[0].bpm + 45;
-    state->nanoSecondsPerPulse = calculateNanoSecondsPerPulse(state->bpm);
+    setBPM(state, state->project->sequences[0].patterns[0].bpm + 45);
     state->track = &state->project->sequences[0].patterns[0].tracks[0];
     setScreenAccordingToActiveTrack(state);
 
@@ -216,6 +267,42 @@ void initSharedState(SharedState* state) {
 void cleanupSharedState(SharedState* state) {
     pthread_mutex_destroy(&state->mutex);
     pthread_cond_destroy(&state->cond);
+    cleanupKeyQueue(&state->keyQueue);
+}
+
+/**
+ * Follow the external clock with the pulse clock.
+ * Returns false if no pulse can be played yet (stopped, or the next tick did not arrive yet)
+ */
+static bool followMidiClock(
+    SharedState *state, 
+    struct PulseClock *pulseClock, 
+    uint64_t pulse, 
+    uint64_t *startPulse, 
+    struct MidiClock *followedClock
+) {
+    // The clock only changes when a message arrives, the shared state is not locked until then:
+    if (atomic_load_explicit(&state->midiClockUpdates, memory_order_acquire) != followedClock->updates) {
+        pthread_mutex_lock(&state->mutex);
+        struct MidiClock midiClock = state->midiClock;
+        if (midiClock.starts != followedClock->starts) {
+            // Play from the start, with the tick after the start message on the last played pulse:
+            *startPulse = pulse;
+            state->isRestartRequired = true;
+        }
+        if (isMidiClockLocked(&midiClock)) {
+            // Re-anchor on the filtered time of the last tick, the pulses in between are interpolated:
+            syncPulseClockToMidiClock(pulseClock, &midiClock, *startPulse);
+            state->bpm = getMidiClockBPM(&midiClock);
+            state->pulsePeriod = pulseClock->period;
+            state->nanoSecondsPerPulse = state->pulsePeriod >> 32;
+        }
+        pthread_mutex_unlock(&state->mutex);
+        *followedClock = midiClock;
+    }
+
+    // Freewheel until the next tick is expected, but not beyond:
+    return isMidiClockLocked(followedClock) && pulse < getMidiClockPulseLimit(followedClock, *startPulse);
 }
 
 /**
@@ -224,24 +311,165 @@ void cleanupSharedState(SharedState* state) {
 void* timerThread(void *arg) {
     SharedState* state = (SharedState*)arg;
 
-    // Timing for sequencer:
-    struct timespec nowTime;
-    uint64_t modulo, prevModulo = 0;
-    clock_gettime(CLOCK_MONOTONIC, &nowTime);
+    // Pulses are scheduled on absolute deadlines from a start epoch, so wake-up latency does not accumulate:
+    struct PulseClock pulseClock;
+    initializePulseClock(&pulseClock, getMonotonicTimeNs(), state->pulsePeriod);
+    uint64_t pulse = 0;
+
+    // Following an external clock:
+    struct MidiClock followedClock;
+    initializeMidiClock(&followedClock);
+    uint64_t startPulse = 0;
 
     while (!state->quit) {
-        // Calculate with monotonic clock:
-        clock_gettime(CLOCK_MONOTONIC, &nowTime);
-        modulo = timespecToNs(&nowTime) % state->nanoSecondsPerPulse;
+        if (clockInputDeviceName != NULL) {
+            if (!followMidiClock(state, &pulseClock, pulse, &startPulse, &followedClock)) {
+                sleepUntil(getMonotonicTimeNs() + MIDI_CLOCK_POLL_NS, 0);
+                continue;
+            }
+        } else if (pulseClock.period != state->pulsePeriod) {
+            // Re-anchor the clock on the last deadline when the tempo changes:
+            setPulseClockPeriod(&pulseClock, pulse, state->pulsePeriod);
+        }
+
+        pulse++;
+        // A tick of the external clock can arrive before all pulses before it are played, those are played right away:
+        uint64_t deadlineNs = pulse < pulseClock.anchorPulse ? pulseClock.anchorNs : getPulseDeadline(&pulseClock, pulse);
+        uint64_t latenessNs = sleepUntil(deadlineNs, spinTailNs);
+
+        pthread_mutex_lock(&state->mutex);
+        state->unprocessedPulses += 1;
+        state->pulseTimeNs = deadlineNs;
+        recordPulseSchedulerLateness(&state->clockStats, latenessNs);
+        pthread_cond_signal(&state->cond);
+        pthread_mutex_unlock(&state->mutex);
+
+        // Report once per quarter note:
+        if (isTimeMeasured && state->clockStats.wakeUps % PPQN_MULTIPLIED == 0) {
+            print(
+                "Clock woke up %lluns late on average (max %lluns, spin tail %lluns)", 
+                (unsigned long long)getAveragePulseSchedulerLateness(&state->clockStats),
+                (unsigned long long)state->clockStats.maxLatenessNs,
+                (unsigned long long)spinTailNs
+            );
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Thread that reads the external MIDI clock
+ */
+void* midiClockThread(void *arg) {
+    SharedState* state = (SharedState*)arg;
+
+    int deviceId = getInputDeviceIdByDeviceName(clockInputDeviceName);
+    if (deviceId == -1) {
+        printError("Midi clock input device not found: %s", clockInputDeviceName);
+        return NULL;
+    }
+    PmStream *inputStream = NULL;
+    openMidiInput(deviceId, &inputStream);
+    if (inputStream == NULL) {
+        printError("Unable to open input stream for this device");
+        return NULL;
+    }
 
-        // if the module is smaller, we now we've passed a new pulse:
-        if (modulo < prevModulo) {
+    // Poll the input, so every message is stamped (at most) a poll interval after it arrived.
+    // The input is read without the lock, the shared state is only locked when there are messages:
+    PmEvent events[MIDI_CLOCK_READ_SIZE];
+    while (!state->quit) {
+        int count = readMidiInput(inputStream, events, MIDI_CLOCK_READ_SIZE);
+        if (count > 0) {
+            // Stamp the messages with the time they are read, PortMidi timestamps only have millisecond resolution:
+            uint64_t timeNs = getMonotonicTimeNs();
             pthread_mutex_lock(&state->mutex);
-            state->unprocessedPulses += 1;
+            processMidiClockEvents(&state->midiClock, events, count, timeNs);
+            atomic_store_explicit(&state->midiClockUpdates, state->midiClock.updates, memory_order_release);
             pthread_mutex_unlock(&state->mutex);
         }
+        sleepUntil(getMonotonicTimeNs() + MIDI_CLOCK_POLL_NS, 0);
+    }
+
+    handleMidiError(Pm_Close(inputStream));
+    return NULL;
+}
 
-        prevModulo = modulo;
+/**
+ * Check if one of the Midi devices requires a program change
+ */
+static bool isProgramChangeRequired(SharedState* state) {
+    return state->programA != 255 || state->programB != 255 || state->programC != 255 || state->programD != 255;
+}
+
+/**
+ * Lock the shared state from the sequencer thread, returns the time it was locked if the time is measured
+ */
+static uint64_t lockSequencerMutex(SharedState* state) {
+    pthread_mutex_lock(&state->mutex);
+    return isTimeMeasured ? getMonotonicTimeNs() : 0;
+}
+
+/**
+ * Unlock the shared state from the sequencer thread, and record how long it was held
+ */
+static void unlockSequencerMutex(SharedState* state, uint64_t lockedNs) {
+    if (isTimeMeasured) {
+        uint64_t heldNs = getMonotonicTimeNs() - lockedNs;
+        state->seqMutexHoldNs += heldNs;
+        state->seqMutexMaxHoldNs = MAX(state->seqMutexMaxHoldNs, heldNs);
+    }
+    pthread_mutex_unlock(&state->mutex);
+}
+
+/**
+ * Copy what the renderer needs from the shared state to a snapshot, and publish it.
+ * The renderer only reads published snapshots, so it never has to lock the shared state
+ */
+static void publishSharedState(SharedState* state) {
+    struct RenderSnapshot *snapshot = getRenderSnapshotBackSlot(&state->renderSnapshots);
+
+    // The key thread changes the selection & the selected track while holding the mutex:
+    uint64_t lockedNs = lockSequencerMutex(state);
+    snapshot->patternStepCounter = state->patternStepCounter;
+    snapshot->patternLength = state->project->sequences[state->selectedSequence].patterns[state->selectedPattern].length;
+    snapshot->bpm = state->bpm;
+    snapshot->selectedSequence = state->selectedSequence;
+    snapshot->selectedPattern = state->selectedPattern;
+    snapshot->queuedPattern = state->queuedPattern;
+    snapshot->selectedTrack = state->selectedTrack;
+    snapshot->screen = state->screen;
+    snapshot->isFillActive = state->transition.isFillActive;
+    snapshot->transitionMask = getTransitionTrigMask(state->track);
+    snapshot->editCount = state->editCount;
+    snapshot->heldModifiers =
+        (state->keyStates[BLIPR_KEY_SHIFT_1] ? BLIPR_MODIFIER_SHIFT_1 : 0) |
+        (state->keyStates[BLIPR_KEY_SHIFT_2] ? BLIPR_MODIFIER_SHIFT_2 : 0) |
+        (state->keyStates[BLIPR_KEY_SHIFT_3] ? BLIPR_MODIFIER_SHIFT_3 : 0) |
+        (state->keyStates[BLIPR_KEY_FUNC] ? BLIPR_MODIFIER_FUNC : 0);
+    copyRenderSnapshotTrack(snapshot, state->track);
+    getPatternHeader(&state->project->sequences[state->selectedSequence].patterns[state->selectedPattern], &snapshot->pattern);
+    if (state->screen == BLIPR_SCREEN_SEQUENCER || state->screen == BLIPR_SCREEN_DRUMKIT_SEQUENCER) {
+        getSequencerEditorState(&snapshot->editor);
+    } else if (state->screen == BLIPR_SCREEN_CONFIGURATION) {
+        getConfigScreenState(state->project, &snapshot->config);
+    }
+    snapshot->clockLatenessNs = state->clockStats.lastLatenessNs;
+    state->isSnapshotRequired = false;
+    unlockSequencerMutex(state, lockedNs);
+
+    // These are only written by the sequencer thread itself:
+    snapshot->ppqnCounter = state->ppqnCounter;
+    snapshot->midiLeadTimeUs = state->midiLeadTimeUs;
+    snapshot->seqPerformance = state->seqPerformance;
+
+    publishRenderSnapshot(&state->renderSnapshots);
+
+    // Wake the renderer, if it waits for snapshots instead of drawing at a fixed rate:
+    if (state->renderEventType != 0 && !atomic_exchange(&state->isRenderEventPending, true)) {
+        SDL_Event event = {.type = state->renderEventType};
+        SDL_PushEvent(&event);
     }
 }
 
@@ -252,32 +480,56 @@ void* sequencerThread(void* arg) {
     SharedState* state = (SharedState*)arg;
 
     // Setup Midi:
-    PmStream *outputStream[4]; // 4 streams, for A, B, C and D
-    int midiDevice[4];          // 4 midi devices, for A, B, C and D
+    PmStream *outputStream[4] = {NULL}; // 4 streams, for A, B, C and D
+    int midiDevice[4];                  // 4 midi devices, for A, B, C and D
 
     resetTemplateNote();
+    initializeNoteTracker();
 
     // Sequencer loop:
     while (!state->quit) {
+        // Sleep until the clock (or the key thread) has something to do:
+        pthread_mutex_lock(&state->mutex);
+        while (
+            !state->quit && 
+            state->unprocessedPulses == 0 && 
+            !state->isSetupMidiDevicesRequired && 
+            !state->isSnapshotRequired &&
+            !isProgramChangeRequired(state)
+        ) {
+            pthread_cond_wait(&state->cond, &state->mutex);
+        }
+        bool isSnapshotRequired = state->isSnapshotRequired;
+        pthread_mutex_unlock(&state->mutex);
+
         if (state->isSetupMidiDevicesRequired) {
             // Setup Midi devices:
             for (int i=0; i<4; i++) {
                 char* midiDeviceName;
+                int latency;
                 switch (i) {
                     case 0:
                         midiDeviceName = state->project->midiDeviceAName;
+                        latency = state->project->midiDeviceLatencyA;
                         break;
                     case 1:
                         midiDeviceName = state->project->midiDeviceBName;
+                        latency = state->project->midiDeviceLatencyB;
                         break;
                     case 2:
                         midiDeviceName = state->project->midiDeviceCName;
+                        latency = state->project->midiDeviceLatencyC;
                         break;
                     case 3:
                         midiDeviceName = state->project->midiDeviceDName;
+                        latency = state->project->midiDeviceLatencyD;
                         break;
                 }
 
+                // Close the previous stream, it is opened again with the current settings:
+                closeMidiOutput(outputStream[i]);
+                outputStream[i] = NULL;
+
                 if (strcmp(midiDeviceName, "") == 0) {
                     printLog("No midi output device set for slot %d", i);
                     continue;
@@ -286,7 +538,7 @@ void* sequencerThread(void* arg) {
                 midiDevice[i] = getOutputDeviceIdByDeviceName(midiDeviceName);
                 if (midiDevice[i] != -1) {
                     printLog("Configured midi output device: %d", midiDevice[i]);
-                    openMidiOutput(midiDevice[i], &outputStream[i]);
+                    openMidiOutput(midiDevice[i], &outputStream[i], latency);
                     if (outputStream[i] == NULL) {
                         printError("Unable to open output stream for this device");
                     }
@@ -295,52 +547,70 @@ void* sequencerThread(void* arg) {
                 }
             }
 
-            pthread_mutex_lock(&state->mutex);
+            uint64_t lockedNs = lockSequencerMutex(state);
             state->isSetupMidiDevicesRequired = false;
-            pthread_mutex_unlock(&state->mutex);
+            unlockSequencerMutex(state, lockedNs);
         }
 
         if (state->programA != 255) {
             printLog("change program A to %d", state->programA);
             sendProgramChange(outputStream[0], state->project->midiDevicePcChannelA, state->programA);
-            pthread_mutex_lock(&state->mutex);
+            uint64_t lockedNs = lockSequencerMutex(state);
             state->prevProgramA = state->programA;
             state->programA = 255;
-            pthread_mutex_unlock(&state->mutex);
+            unlockSequencerMutex(state, lockedNs);
         } else if (state->programB != 255) {
             printLog("change program B to %d", state->programB);
             sendProgramChange(outputStream[1], state->project->midiDevicePcChannelB, state->programB);
-            pthread_mutex_lock(&state->mutex);
+            uint64_t lockedNs = lockSequencerMutex(state);
             state->prevProgramB = state->programB;
             state->programB = 255;
-            pthread_mutex_unlock(&state->mutex);
+            unlockSequencerMutex(state, lockedNs);
         } else if (state->programC != 255) {
             printLog("change program C to %d", state->programC);
             sendProgramChange(outputStream[2], state->project->midiDevicePcChannelC, state->programC);
-            pthread_mutex_lock(&state->mutex);
+            uint64_t lockedNs = lockSequencerMutex(state);
             state->prevProgramC = state->programC;
             state->programC = 255;
-            pthread_mutex_unlock(&state->mutex);
+            unlockSequencerMutex(state, lockedNs);
         } else if (state->programD != 255) {
             printLog("change program to %d", state->programD);
             sendProgramChange(outputStream[3], state->project->midiDevicePcChannelD, state->programD);
-            pthread_mutex_lock(&state->mutex);
+            uint64_t lockedNs = lockSequencerMutex(state);
             state->prevProgramD = state->programD;
             state->programD = 255;
-            pthread_mutex_unlock(&state->mutex);
+            unlockSequencerMutex(state, lockedNs);
         }
+        flushMidiOutput();
 
         if (state->unprocessedPulses > 0) {
             // Do the work!
             if (isTimeMeasured) {
                 clock_gettime(CLOCK_MONOTONIC, &seqStartTime);
+                if (state->ppqnCounter == 0) {
+                    print("Time to first pulse: %.1fms", (getMonotonicTimeNs() - startTimeNs) / 1000000.0);
+                }
             }
 
-            pthread_mutex_lock(&state->mutex);
+            uint64_t lockedNs = lockSequencerMutex(state);
+            if (state->isRestartRequired) {
+                // The external clock started, play everything from the start:
+                state->ppqnCounter = 0;
+                state->patternStepCounter = 0;
+                for (int i=0; i<16; i++) {
+                    restartTrack(&state->project->sequences[state->selectedSequence].patterns[state->selectedPattern].tracks[i], i);
+                }
+                state->isRestartRequired = false;
+            }
             state->ppqnCounter += state->unprocessedPulses;
             int unprocessedPulses = state->unprocessedPulses;
             state->unprocessedPulses = 0;
-            pthread_mutex_unlock(&state->mutex);
+            // Timestamped MIDI events are scheduled relative to when this pulse should be heard:
+            setMidiPulseTime(state->pulseTimeNs, state->nanoSecondsPerPulse);
+            if (unprocessedPulses > 1) {
+                state->sequencerLagCount++;
+            }
+            unlockSequencerMutex(state, lockedNs);
 
             // Send Midi Clock:
             for (int i=0; i<4; i++) { 
@@ -364,14 +634,18 @@ void* sequencerThread(void* arg) {
                     // This is the moment to switch from the queued pattern to the selected pattern
                     if (state->selectedPattern != state->queuedPattern) {
                         // Perform actions when switching pattern:
-                        pthread_mutex_lock(&state->mutex);
+                        uint64_t lockedNs = lockSequencerMutex(state);
+                        // Remember the pattern we came from, for the transition trigs:
+                        state->transition.previousPattern = state->selectedPattern;
+                        state->transition.playedPatterns |= 1 << state->selectedPattern;
+                        state->transition.patternLoopCount = 0;
                         state->selectedPattern = state->queuedPattern;
                         // Set proper track + reset repeat count for all track:
                         state->track = &state->project->sequences[state->selectedSequence]
                             .patterns[state->selectedPattern]
                             .tracks[state->selectedTrack];
                         for (int i=0; i<16; i++) {
-                            state->project->sequences[state->selectedSequence].patterns[state->selectedPattern].tracks[i].repeatCount = 0;
+                            restartTrack(&state->project->sequences[state->selectedSequence].patterns[state->selectedPattern].tracks[i], i);
                         }
                         // Trigger program change:
                         const struct Pattern *pattern = &state->project->sequences[state->selectedSequence].patterns[state->selectedPattern];
@@ -388,60 +662,87 @@ void* sequencerThread(void* arg) {
                             state->programD = pattern->programD;
                         }
                         // Set proper BPM:
-                        state->bpm = state->project->sequences[state->selectedSequence]
-                            .patterns[state->selectedPattern].bpm + 45;
-                        state->nanoSecondsPerPulse = calculateNanoSecondsPerPulse(state->bpm);
+                        setBPM(state, state->project->sequences[state->selectedSequence]
+                            .patterns[state->selectedPattern].bpm + 45);
                         // Set proper screen:
                         setScreenAccordingToActiveTrack(state);
                         if (state->screen == BLIPR_SCREEN_DRUMKIT_SEQUENCER) {
                             setTemplateNoteForDrumkitSequencer(state->track, 0);
                         }
-                        pthread_mutex_unlock(&state->mutex);
-                    }                    
+                        unlockSequencerMutex(state, lockedNs);
+                    } else {
+                        state->transition.patternLoopCount++;
+                    }
                 }
             }
 
+            // The transition trig conditions are the same for all notes on this pulse:
+            state->transition.currentPattern = state->selectedPattern;
+            state->transition.queuedPattern = state->queuedPattern;
+            setTransitionContext(&state->transition);
+
             // Iterate over all tracks, and send proper midi signals
             for (int i=0; i<16; i++) {
                 struct Track* iTrack = &state->project->sequences[state->selectedSequence].patterns[state->selectedPattern].tracks[i];
                 bool isTrackKeyRepeatTriggered = false;
+
+                // The settings come from the playback state, so tracks without notes on this pulse are not touched:
+                const struct TrackTimeline *timeline = getTrackTimeline(iTrack);
                 
                 // Run the program:
-                switch (iTrack->program) {
+                switch (timeline->program) {
                     case BLIPR_PROGRAM_SEQUENCER:
                     case BLIPR_PROGRAM_DRUMKIT_SEQUENCER:
-                        runSequencer(outputStream[iTrack->midiDevice], &state->ppqnCounter, iTrack);
+                        runSequencer(outputStream[timeline->midiDevice], &state->ppqnCounter, iTrack);
                         break;
                     case BLIPR_PROGRAM_FOUR_ON_THE_FLOOR:
-                        runFourOnTheFloor(outputStream[iTrack->midiDevice], &state->ppqnCounter, iTrack);
+                        runFourOnTheFloor(outputStream[timeline->midiDevice], &state->ppqnCounter, iTrack);
                         break;
                 }
             }
 
-            // Decrease note-off counters:
-            updateNotesAndSendOffs();
+            // Send the note offs that are due (catching up on pulses that were skipped):
+            updateNotesAndSendOffs(unprocessedPulses);
 
-            // Check for render trigger (typically every step):
-            if (state->ppqnCounter % PP16N == 0) {
-                pthread_mutex_lock(&state->mutex);
-                state->isRenderRequired = true;
-                pthread_mutex_unlock(&state->mutex);
+            // Send all MIDI messages of this pulse:
+            struct MidiFlushStats flushStats = flushMidiOutput();
+            if (flushStats.timestampedEvents > 0) {
+                state->midiLeadTimeUs = flushStats.minLeadTimeUs;
+            }
+
+            // Publish a new render snapshot (typically every step):
+            if (isSnapshotRequired || state->ppqnCounter % PP16N == 0) {
+                publishSharedState(state);
             }
 
             if (isTimeMeasured) {
                 clock_gettime(CLOCK_MONOTONIC, &seqEndTime);
                 int64_t elapsedNs = getTimespecDiffInNanoSeconds(&seqStartTime, &seqEndTime);
                 double percentage = ((double)elapsedNs / state->nanoSecondsPerPulse) * 100.0;
-                pthread_mutex_lock(&state->mutex);
                 state->seqPerformance = percentage;
-                pthread_mutex_unlock(&state->mutex);
-                print("Sequencer took %dns to run (%.2f%%)", elapsedNs, percentage);
+                print(
+                    "Sequencer took %dns to run (%.2f%%), fell behind %llu times, flushed %d MIDI events in %d writes (%lluns), lead time %lldus, held the mutex %lluns (max %lluns)", 
+                    elapsedNs, 
+                    percentage, 
+                    (unsigned long long)state->sequencerLagCount,
+                    flushStats.events,
+                    flushStats.writes,
+                    (unsigned long long)flushStats.elapsedNs,
+                    (long long)state->midiLeadTimeUs,
+                    (unsigned long long)state->seqMutexHoldNs,
+                    (unsigned long long)state->seqMutexMaxHoldNs
+                );
+                state->seqMutexHoldNs = 0;
             }
+        } else if (isSnapshotRequired) {
+            // Woken up by the key thread:
+            publishSharedState(state);
         }
     }
 
+    flushMidiOutput();
     for (int i=0; i<4; i++) {
-        Pm_Close(outputStream[i]);
+        closeMidiOutput(outputStream[i]);
     }
 
     Pm_Terminate();
@@ -450,192 +751,438 @@ void* sequencerThread(void* arg) {
 }
 
 /**
- * Thread for keyboard input
+ * Decode a pattern that is not loaded yet without holding the mutex, and only lock it to store the pattern.
+ * Patterns are only loaded by the key thread, so nothing else decodes the same pattern in the meantime
  */
-void* keyThread(void* arg) {
-    SharedState* state = (SharedState*)arg;
+static void preloadPattern(SharedState *state, int sequence, int pattern) {
+    static struct Pattern decodedPattern;
+    if (decodePattern(sequence, pattern, &decodedPattern)) {
+        pthread_mutex_lock(&state->mutex);
+        storeDecodedPattern(state->project, sequence, pattern, &decodedPattern);
+        pthread_mutex_unlock(&state->mutex);
+    }
+}
 
-    // Keydown logic:
-    while (!state->quit) {
-        // Perform key down actions:
-        if(state->scanCodeKeyDown != SDL_SCANCODE_UNKNOWN) {
-            // User requests quit
-            if (state->scanCodeKeyDown == SDL_SCANCODE_ESCAPE) {
-                pthread_mutex_lock(&state->mutex);
-                state->quit = true;
-                pthread_mutex_unlock(&state->mutex);
+/**
+ * Handle a key down event
+ */
+void handleKeyDown(SharedState* state, SDL_Scancode scanCode) {
+    // User requests quit
+    if (scanCode == SDL_SCANCODE_ESCAPE) {
+        pthread_mutex_lock(&state->mutex);
+        state->quit = true;
+        pthread_mutex_unlock(&state->mutex);
+    }
+
+    if (!state->keyStates[scanCode]) {
+        pthread_mutex_lock(&state->mutex);
+        state->keyStates[scanCode] = true;
+        pthread_mutex_unlock(&state->mutex);
+    }
+
+    // Check if this is one of the global Func-options:
+    if (state->keyStates[BLIPR_KEY_FUNC]) {
+        // Fn-A = Pattern selector
+        // Fn-B = Sequence selector
+        // Fn-C = Configuration
+        // Fn-D = Transport
+        BliprScreen screen = state->screen;
+        if (scanCode == BLIPR_KEY_FUNC || scanCode == BLIPR_KEY_A) {
+            screen = BLIPR_SCREEN_PATTERN_SELECTION;
+        } else if (scanCode == BLIPR_KEY_B) {
+            screen = BLIPR_SCREEN_SEQUENCE_SELECTION;
+        } else if (scanCode == BLIPR_KEY_C) {
+            screen = BLIPR_SCREEN_CONFIGURATION;
+        } else if (scanCode == BLIPR_KEY_D) {
+            screen = BLIPR_SCREEN_TRANSPORT;
+        }
+
+        // The queued pattern and the selected sequence are only written by this thread, so the patterns
+        // they select can be decoded before taking the mutex, the sequencer never waits for the decoding:
+        int queuedPattern = state->queuedPattern;
+        int selectedSequence = state->selectedSequence;
+        if (screen == BLIPR_SCREEN_PATTERN_SELECTION) {
+            updatePatternSelection(&queuedPattern, scanCode);
+            preloadPattern(state, selectedSequence, queuedPattern);
+        } else if (screen == BLIPR_SCREEN_SEQUENCE_SELECTION) {
+            updateSequenceSelection(&selectedSequence, scanCode);
+            pthread_mutex_lock(&state->mutex);
+            int selectedPattern = state->selectedPattern;
+            pthread_mutex_unlock(&state->mutex);
+            preloadPattern(state, selectedSequence, selectedPattern);
+            preloadPattern(state, selectedSequence, queuedPattern);
+        }
+
+        pthread_mutex_lock(&state->mutex);
+        state->screen = screen;
+        if (state->screen == BLIPR_SCREEN_PATTERN_SELECTION) {
+            // The pattern is decoded before it is queued, so it is ready when the sequencer switches to it:
+            atomic_thread_fence(memory_order_release);
+            state->queuedPattern = queuedPattern;
+        } else if (state->screen == BLIPR_SCREEN_SEQUENCE_SELECTION) {
+            // The sequencer reads the selected sequence without the mutex, so its patterns are decoded first.
+            // It only switches to the queued pattern, so the selected pattern is always decoded already:
+            loadPattern(state->project, selectedSequence, state->selectedPattern);
+            atomic_thread_fence(memory_order_release);
+            state->selectedSequence = selectedSequence;
+            // Set proper pattern, track + reset repeat count
+            state->track = &state->project->sequences[state->selectedSequence]
+                .patterns[state->selectedPattern]
+                .tracks[state->selectedTrack];
+            state->track->repeatCount = 0;
+            // A new sequence has no pattern to transition from:
+            state->transition.previousPattern = state->selectedPattern;
+            state->transition.playedPatterns = 0;
+            state->transition.patternLoopCount = 0;
+        } else if (state->screen == BLIPR_SCREEN_CONFIGURATION) {
+            bool reloadMidi = false;
+            bool quit = false;
+            updateConfiguration(state->project, scanCode, &reloadMidi, &quit);
+            if (reloadMidi) { state->isSetupMidiDevicesRequired = true; }
+            if (quit) { state->quit = true; }
+        } else if (state->screen == BLIPR_SCREEN_TRANSPORT) {
+            // TODO
+            if (scanCode == BLIPR_KEY_1) {
+                // Fill is latched, so it keeps playing after Func is released:
+                state->transition.isFillActive = !state->transition.isFillActive;
+            }
+        }
+        pthread_mutex_unlock(&state->mutex);
+    } else if (state->keyStates[BLIPR_KEY_SHIFT_3]) {
+        // Shift 3 is Track & Pattern options
+        // ^3-A = Track Selector
+        // ^3-B = Track Options (1)
+        // ^3-C = Program Selector
+        // ^3-D = Pattern Options
+        pthread_mutex_lock(&state->mutex);
+        if (scanCode == BLIPR_KEY_SHIFT_3 || scanCode == BLIPR_KEY_A) {
+            state->screen = BLIPR_SCREEN_TRACK_SELECTION;
+        } else if (scanCode == BLIPR_KEY_B) {
+            state->screen = BLIPR_SCREEN_TRACK_OPTIONS;
+        } else if (scanCode == BLIPR_KEY_C) {
+            state->screen = BLIPR_SCREEN_PROGRAM_SELECTION;
+        } else if (scanCode == BLIPR_KEY_D) {
+            state->screen = BLIPR_SCREEN_PATTERN_OPTIONS;
+        }
+
+        if (state->screen == BLIPR_SCREEN_TRACK_OPTIONS) {
+            updateTrackOptions(state->track, scanCode);
+        } else if (state->screen == BLIPR_SCREEN_PROGRAM_SELECTION) {
+            updateProgram(state->track, scanCode);
+        } else if (state->screen == BLIPR_SCREEN_TRACK_SELECTION) {
+            updateTrackSelection(&state->selectedTrack, scanCode);
+            state->track = &state->project->sequences[state->selectedSequence]
+                .patterns[state->selectedPattern]
+                .tracks[state->selectedTrack];
+            // Set selected note to 0:
+            resetSelectedNote();
+        } else if (state->screen == BLIPR_SCREEN_PATTERN_OPTIONS) {
+            struct Sequence *sequence = &state->project->sequences[state->selectedSequence];
+            struct Pattern *pattern = &sequence->patterns[state->selectedPattern];
+            
+            int startBPM = pattern->bpm;
+            int startProgA = pattern->programA;
+            int startProgB = pattern->programB;
+            int startProgC = pattern->programC;
+            int startProgD = pattern->programD;
+
+            updatePatternOptions(
+                pattern, 
+                scanCode
+            );
+
+            if (startBPM != pattern->bpm) {
+                setBPM(state, pattern->bpm + 45);
             }
 
-            if (!state->keyStates[state->scanCodeKeyDown]) {
-                pthread_mutex_lock(&state->mutex);
-                state->keyStates[state->scanCodeKeyDown] = true;
-                pthread_mutex_unlock(&state->mutex);
+            if (startProgA != pattern->programA) {
+                state->programA = pattern->programA;
             }
 
-            // Check if this is one of the global Func-options:
-            if (state->keyStates[BLIPR_KEY_FUNC]) {
-                // Fn-A = Pattern selector
-                // Fn-B = Sequence selector
-                // Fn-C = Configuration
-                // Fn-D = Transport
-                pthread_mutex_lock(&state->mutex);
-                if (state->scanCodeKeyDown == BLIPR_KEY_FUNC || state->scanCodeKeyDown == BLIPR_KEY_A) {
-                    state->screen = BLIPR_SCREEN_PATTERN_SELECTION;
-                } else if (state->scanCodeKeyDown == BLIPR_KEY_B) {
-                    state->screen = BLIPR_SCREEN_SEQUENCE_SELECTION;
-                } else if (state->scanCodeKeyDown == BLIPR_KEY_C) {
-                    state->screen = BLIPR_SCREEN_CONFIGURATION;
-                } else if (state->scanCodeKeyDown == BLIPR_KEY_D) {
-                    state->screen = BLIPR_SCREEN_TRANSPORT;
-                }
-                
-                if (state->screen == BLIPR_SCREEN_PATTERN_SELECTION) {
-                    updatePatternSelection(&state->queuedPattern, state->scanCodeKeyDown);
-                } else if (state->screen == BLIPR_SCREEN_SEQUENCE_SELECTION) {
-                    updateSequenceSelection(&state->selectedSequence, state->scanCodeKeyDown);
-                    // Set proper pattern, track + reset repeat count
-                    state->track = &state->project->sequences[state->selectedSequence]
-                        .patterns[state->selectedPattern]
-                        .tracks[state->selectedTrack];
-                    state->track->repeatCount = 0;
-                } else if (state->screen == BLIPR_SCREEN_CONFIGURATION) {
-                    bool reloadMidi = false;
-                    bool quit = false;
-                    updateConfiguration(state->project, state->scanCodeKeyDown, &reloadMidi, &quit);
-                    if (reloadMidi) { state->isSetupMidiDevicesRequired = true; }
-                    if (quit) { state->quit = true; }
-                } else if (state->screen == BLIPR_SCREEN_TRANSPORT) {
-                    // TODO
-                }
-                pthread_mutex_unlock(&state->mutex);
-            } else if (state->keyStates[BLIPR_KEY_SHIFT_3]) {
-                // Shift 3 is Track & Pattern options
-                // ^3-A = Track Selector
-                // ^3-B = Track Options (1)
-                // ^3-C = Program Selector
-                // ^3-D = Pattern Options
-                pthread_mutex_lock(&state->mutex);
-                if (state->scanCodeKeyDown == BLIPR_KEY_SHIFT_3 || state->scanCodeKeyDown == BLIPR_KEY_A) {
-                    state->screen = BLIPR_SCREEN_TRACK_SELECTION;
-                } else if (state->scanCodeKeyDown == BLIPR_KEY_B) {
-                    state->screen = BLIPR_SCREEN_TRACK_OPTIONS;
-                } else if (state->scanCodeKeyDown == BLIPR_KEY_C) {
-                    state->screen = BLIPR_SCREEN_PROGRAM_SELECTION;
-                } else if (state->scanCodeKeyDown == BLIPR_KEY_D) {
-                    state->screen = BLIPR_SCREEN_PATTERN_OPTIONS;
-                }
+            if (startProgB != pattern->programB) {
+                state->programB = pattern->programB;
+            }
 
-                if (state->screen == BLIPR_SCREEN_TRACK_OPTIONS) {
-                    updateTrackOptions(state->track, state->scanCodeKeyDown);
-                } else if (state->screen == BLIPR_SCREEN_PROGRAM_SELECTION) {
-                    updateProgram(state->track, state->scanCodeKeyDown);
-                } else if (state->screen == BLIPR_SCREEN_TRACK_SELECTION) {
-                    updateTrackSelection(&state->selectedTrack, state->scanCodeKeyDown);
-                    state->track = &state->project->sequences[state->selectedSequence]
-                        .patterns[state->selectedPattern]
-                        .tracks[state->selectedTrack];
-                    // Set selected note to 0:
-                    resetSelectedNote();
-                } else if (state->screen == BLIPR_SCREEN_PATTERN_OPTIONS) {
-                    struct Sequence *sequence = &state->project->sequences[state->selectedSequence];
-                    struct Pattern *pattern = &sequence->patterns[state->selectedPattern];
-                    
-                    int startBPM = pattern->bpm;
-                    int startProgA = pattern->programA;
-                    int startProgB = pattern->programB;
-                    int startProgC = pattern->programC;
-                    int startProgD = pattern->programD;
-
-                    updatePatternOptions(
-                        pattern, 
-                        state->scanCodeKeyDown
-                    );
+            if (startProgC != pattern->programC) {
+                state->programC = pattern->programC;
+            }
 
-                    if (startBPM != pattern->bpm) {
-                        state->bpm = pattern->bpm + 45;
-                        state->nanoSecondsPerPulse = calculateNanoSecondsPerPulse(state->bpm);
-                    }
+            if (startProgD != pattern->programD) {
+                state->programD = pattern->programD;
+            }
+        }
+        pthread_mutex_unlock(&state->mutex);
+    } else {
+        // No Fn or ^3 active, so handle the program of the current track:
+        pthread_mutex_lock(&state->mutex);
+        setScreenAccordingToActiveTrack(state);
+        switch (state->track->program) {
+            case BLIPR_PROGRAM_SEQUENCER:
+            case BLIPR_PROGRAM_DRUMKIT_SEQUENCER:
+                updateSequencer(
+                    state->track, 
+                    state->keyStates, 
+                    scanCode,
+                    state->track->program == BLIPR_PROGRAM_DRUMKIT_SEQUENCER
+                );                        
+                break;
+        }
+        // Handle key:
+        pthread_mutex_unlock(&state->mutex);
+    }
 
-                    if (startProgA != pattern->programA) {
-                        state->programA = pattern->programA;
-                    }
+    pthread_mutex_lock(&state->mutex);
+    state->isSnapshotRequired = true;
+    state->editCount++;
+    // Program changes, midi setup, quit and render snapshots are handled by the sequencer:
+    pthread_cond_signal(&state->cond);
+    pthread_mutex_unlock(&state->mutex);
+}
 
-                    if (startProgB != pattern->programB) {
-                        state->programB = pattern->programB;
-                    }
+/**
+ * Handle a key up event
+ */
+void handleKeyUp(SharedState* state, SDL_Scancode scanCode) {
+    // Func-keyup always closes the entire program selection & func-menu
+    if (scanCode == BLIPR_KEY_FUNC || scanCode == BLIPR_KEY_SHIFT_3) {
+        pthread_mutex_lock(&state->mutex);
+        // Set screen to current running program:
+        setScreenAccordingToActiveTrack(state);                
+        pthread_mutex_unlock(&state->mutex);
+        resetConfigurationScreen();
+    } else if (scanCode == BLIPR_KEY_SHIFT_1) {
+        resetSequencerSelectedStep();
+    }
+    
+    pthread_mutex_lock(&state->mutex);
+    state->keyStates[scanCode] = false;
+    state->isSnapshotRequired = true;
+    state->editCount++;
+    pthread_cond_signal(&state->cond);
+    pthread_mutex_unlock(&state->mutex);
+}
 
-                    if (startProgC != pattern->programC) {
-                        state->programC = pattern->programC;
-                    }
+/**
+ * Thread for keyboard input
+ */
+void* keyThread(void* arg) {
+    SharedState* state = (SharedState*)arg;
+    struct KeyEvent event;
 
-                    if (startProgD != pattern->programD) {
-                        state->programD = pattern->programD;
-                    }
-                }
-                pthread_mutex_unlock(&state->mutex);
-            } else {
-                // No Fn or ^3 active, so handle the program of the current track:
-                pthread_mutex_lock(&state->mutex);
-                setScreenAccordingToActiveTrack(state);
-                switch (state->track->program) {
-                    case BLIPR_PROGRAM_SEQUENCER:
-                    case BLIPR_PROGRAM_DRUMKIT_SEQUENCER:
-                        updateSequencer(
-                            state->track, 
-                            state->keyStates, 
-                            state->scanCodeKeyDown,
-                            state->track->program == BLIPR_PROGRAM_DRUMKIT_SEQUENCER
-                        );                        
-                        break;
-                }
-                // Handle key:
-                pthread_mutex_unlock(&state->mutex);
-            }
+    // Sleeps until the SDL thread queues a key event:
+    while (!state->quit && popKeyEvent(&state->keyQueue, &event)) {
+        if (event.isKeyDown) {
+            handleKeyDown(state, event.scancode);
+        } else {
+            handleKeyUp(state, event.scancode);
+        }
 
-            // Reset flag:
-            pthread_mutex_lock(&state->mutex);
-            state->scanCodeKeyDown = SDL_SCANCODE_UNKNOWN;
-            state->isRenderRequired = true;
-            pthread_mutex_unlock(&state->mutex);
+        recordKeyLatency(&state->keyLatencyStats, &event);
+        if (isTimeMeasured) {
+            print(
+                "Key handled %ums after the event (avg %llums, max %ums)",
+                state->keyLatencyStats.lastLatencyMs,
+                (unsigned long long)(state->keyLatencyStats.totalLatencyMs / state->keyLatencyStats.events),
+                state->keyLatencyStats.maxLatencyMs
+            );
         }
+    }
+
+    return NULL;
+}
 
-        // Perform key down actions:
-        if(state->scanCodeKeyUp != SDL_SCANCODE_UNKNOWN) {
-            // Func-keyup always closes the entire program selection & func-menu
-            if (state->scanCodeKeyUp == BLIPR_KEY_FUNC || state->scanCodeKeyUp == BLIPR_KEY_SHIFT_3) {
-                pthread_mutex_lock(&state->mutex);
-                // Set screen to current running program:
-                setScreenAccordingToActiveTrack(state);                
-                pthread_mutex_unlock(&state->mutex);
-                resetConfigurationScreen();
-            } else if (state->scanCodeKeyUp == BLIPR_KEY_SHIFT_1) {
-                resetSequencerSelectedStep();
+/**
+ * Draw the measurements in the bottom right of the sidebar
+ */
+static void drawMeasurements(struct RenderSnapshot *snapshot, double renPerformance) {
+    // Clear the previous measurements (the text runs over the edge of the sidebar):
+    drawRect(WIDTH - 45, HEIGHT - 24, 43, 22, COLOR_GRAY);
+    drawRect(WIDTH - 45, HEIGHT - 2, 44, 1, COLOR_BLACK);
+    drawRect(WIDTH - 2, HEIGHT - 24, 1, 22, COLOR_BLACK);
+
+    // Render in bottom right:
+    char leadText[10];
+    snprintf(leadText, 10, "T:%.1fms", snapshot->midiLeadTimeUs / 1000.0);
+    drawText(WIDTH - 45, HEIGHT - 24, leadText, 45, COLOR_YELLOW);
+    // Lateness of a millisecond or more does not fit in microseconds:
+    char latText[16];
+    if (snapshot->clockLatenessNs < 1000000) {
+        snprintf(latText, sizeof(latText), "L:%.1fus", snapshot->clockLatenessNs / 1000.0);
+    } else {
+        snprintf(latText, sizeof(latText), "L:%.1fms", snapshot->clockLatenessNs / 1000000.0);
+    }
+    drawText(WIDTH - 45, HEIGHT - 18, latText, 45, COLOR_YELLOW);
+    char seqText[10];
+    snprintf(seqText, 10, "S:%.2f%%", snapshot->seqPerformance);
+    drawText(WIDTH - 45, HEIGHT - 12, seqText, 45, COLOR_YELLOW);
+    char renText[10];
+    snprintf(renText, 10, "R:%.2f%%", renPerformance);
+    drawText(WIDTH - 45, HEIGHT - 6, renText, 45, COLOR_YELLOW);
+}
+
+/**
+ * Draw the regions (RENDER_REGION_*) of a snapshot in the render target
+ */
+static void drawSnapshot(struct RenderSnapshot *snapshot, int regions, double renPerformance) {
+    drawRenderSnapshot(snapshot, regions);
+
+    if (isTimeMeasured) {
+        drawMeasurements(snapshot, renPerformance);
+    }
+}
+
+/**
+ * Draw the current state in the render target (without presenting it), and record how long it took.
+ * Returns the time it took in nanoseconds
+ */
+static uint64_t drawHeadlessFrame(
+    SharedState *state, 
+    struct RenderSnapshot *drawnSnapshot, 
+    bool *isFrameDrawn, 
+    struct HeadlessRenderStats *stats
+) {
+    // There is no sequencer thread, so the snapshot is published right here:
+    publishSharedState(state);
+    struct RenderSnapshot *snapshot = acquireRenderSnapshot(&state->renderSnapshots);
+
+    uint64_t startNs = getMonotonicTimeNs();
+    int regions = *isFrameDrawn ? getDirtyRenderRegions(drawnSnapshot, snapshot) : RENDER_REGION_ALL;
+    drawSnapshot(snapshot, regions, 0.0);
+    *drawnSnapshot = *snapshot;
+    *isFrameDrawn = true;
+    if (!isFramebufferUsed) {
+        // Wait for the renderer to execute the batched draw calls:
+        SDL_RenderFlush(renderer);
+    }
+    uint64_t elapsedNs = getMonotonicTimeNs() - startNs;
+    recordHeadlessRenderTime(stats, snapshot->screen, elapsedNs);
+    return elapsedNs;
+}
+
+/**
+ * Replay a script of key events without a display, and write snapshots of the frames.
+ * Returns the exit code
+ */
+static int runHeadless(SharedState *state, const char *scriptFile) {
+    FILE *script = fopen(scriptFile, "r");
+    if (script == NULL) {
+        printError("Unable to open headless script: %s", scriptFile);
+        return 1;
+    }
+
+    static uint32_t pixels[WIDTH * HEIGHT];
+    struct RenderSnapshot drawnSnapshot;
+    bool isFrameDrawn = false;
+    struct HeadlessRenderStats stats = {0};
+    char line[HEADLESS_PATH_LENGTH + 16];
+    int lineNumber = 0;
+    int result = 0;
+
+    drawHeadlessFrame(state, &drawnSnapshot, &isFrameDrawn, &stats);
+
+    while (result == 0 && !state->quit && fgets(line, sizeof(line), script) != NULL) {
+        lineNumber++;
+        struct HeadlessCommand command;
+        if (!parseHeadlessCommand(line, &command)) {
+            printError("Invalid command on line %d of %s: %s", lineNumber, scriptFile, line);
+            result = 1;
+            break;
+        }
+
+        switch (command.type) {
+            case HEADLESS_COMMAND_KEY_DOWN:
+                handleKeyDown(state, command.scancode);
+                drawHeadlessFrame(state, &drawnSnapshot, &isFrameDrawn, &stats);
+                break;
+            case HEADLESS_COMMAND_KEY_UP:
+                handleKeyUp(state, command.scancode);
+                drawHeadlessFrame(state, &drawnSnapshot, &isFrameDrawn, &stats);
+                break;
+            case HEADLESS_COMMAND_KEY_PRESS:
+                handleKeyDown(state, command.scancode);
+                drawHeadlessFrame(state, &drawnSnapshot, &isFrameDrawn, &stats);
+                handleKeyUp(state, command.scancode);
+                drawHeadlessFrame(state, &drawnSnapshot, &isFrameDrawn, &stats);
+                break;
+            case HEADLESS_COMMAND_RENDER: {
+                uint64_t totalNs = 0;
+                for (int i = 0; i < command.count; i++) {
+                    isFrameDrawn = false;
+                    totalNs += drawHeadlessFrame(state, &drawnSnapshot, &isFrameDrawn, &stats);
+                }
+                uint64_t averageNs = totalNs / command.count;
+                if (command.budgetUs > 0 && averageNs > (uint64_t)command.budgetUs * 1000) {
+                    printError(
+                        "Rendering took %lluns on average on line %d of %s, the budget is %dus", 
+                        (unsigned long long)averageNs, 
+                        lineNumber, 
+                        scriptFile, 
+                        command.budgetUs
+                    );
+                    result = 1;
+                }
+                break;
             }
-            
-            // Reset flag:
-            pthread_mutex_lock(&state->mutex);
-            state->keyStates[state->scanCodeKeyUp] = false;
-            state->scanCodeKeyUp = SDL_SCANCODE_UNKNOWN;
-            state->isRenderRequired = true;
-            pthread_mutex_unlock(&state->mutex);
+            case HEADLESS_COMMAND_SNAPSHOT:
+                if (isFramebufferUsed) {
+                    memcpy(pixels, framebuffer, sizeof(pixels));
+                } else {
+                    SDL_RenderReadPixels(renderer, NULL, SDL_PIXELFORMAT_RGBA8888, pixels, WIDTH * sizeof(uint32_t));
+                }
+                if (!writeFramePPM(command.path, pixels, WIDTH, HEIGHT)) {
+                    result = 1;
+                }
+                break;
+            default:
+                // Empty line or comment
+                break;
         }
     }
+
+    fclose(script);
+    printHeadlessRenderStats(&stats);
+
+    return result;
 }
 
 /**
  * Main loop
  */
 int main(int argc, char *argv[]) {
+    startTimeNs = getMonotonicTimeNs();
     bool isScreenRotated = checkFlag(argc, argv, "--rotate180");
     isMidiDataLogged = checkFlag(argc, argv, "--logMidiData");
     isTimeMeasured = checkFlag(argc, argv, "--measureTime");
+    isFramebufferUsed = checkFlag(argc, argv, "--framebuffer");
+    char *headlessScript = getFlagValue(argc, argv, "--headless");
+    char *headlessProjectFile = getFlagValue(argc, argv, "--project");
+    char *spinTail = getFlagValue(argc, argv, "--spinTail");
+    if (spinTail != NULL) {
+        spinTailNs = strtoull(spinTail, NULL, 10) * 1000;
+    }
+    char *autosave = getFlagValue(argc, argv, "--autosave");
+    if (autosave != NULL) {
+        autosaveIntervalMs = atoi(autosave) * 1000;
+    }
+    char *fps = getFlagValue(argc, argv, "--fps");
+    if (fps != NULL) {
+        targetFps = atoi(fps);
+    }
+    clockInputDeviceName = getFlagValue(argc, argv, "--clockInput");
 
     if (checkFlag(argc, argv, "--help") == true) {
         // Print Help:
         printf("Optional arguments:\n\n");
         printf("  --rotate180       Rotate the screen 180 degrees\n");
         printf("  --logMidiData     Log the MIDI data to the terminal\n");
-        printf("  --measureTime     Measure time for actions");
+        printf("  --measureTime     Measure time for actions\n");
+        printf("  --framebuffer     Draw in software and upload once per frame, instead of using the renderer\n");
+        printf("  --headless=<file> Replay a script of key events without a display, and write snapshots\n");
+        printf("  --project=<file>  Replay the headless script on a project file, without writing to it (default: a new project)\n");
+        printf("  --spinTail=<us>   Busy-wait the last microseconds before each pulse (default 0)\n");
+        printf("  --autosave=<s>    Save changes every n seconds, 0 saves on exit only (default 5)\n");
+        printf("  --fps=<n>         Draw at most n frames per second, 0 is unlimited (default 60)\n");
+        printf("  --clockInput=<device> Follow the MIDI clock (and start, stop & continue) of an input device\n");
     }
 
     printLog("Screen rotated: %s", isScreenRotated ? "true" : "false");
@@ -644,24 +1191,48 @@ int main(int argc, char *argv[]) {
     printWarning("Running in debug mode");
     #endif
 
-    listMidiDevices();
+    // Headless mode never touches the project file or the MIDI devices:
+    struct Project *project;
+    if (headlessScript != NULL) {
+        project = openHeadlessProject(headlessProjectFile);
+        if (project == NULL) {
+            printError("Unable to read project file: %s", headlessProjectFile);
+            return 1;
+        }
+    } else {
+        listMidiDevices();
+        print("Loading project file: %s", projectFile);
+        project = openProjectFile(projectFile);
+        if (project == NULL) {
+            printError("Unable to open project file: %s", projectFile);
+            return 1;
+        }
+    }
 
     SDL_Window      *win = NULL;
     SDL_Texture     *renderTarget = NULL;
 
     SDL_SetHint(SDL_HINT_RENDER_VSYNC, "0");
-    SDL_SetHint(SDL_HINT_RENDER_DRIVER, "opengles2");
+    if (headlessScript != NULL) {
+        // Render offscreen, in software:
+        setenv("SDL_VIDEODRIVER", "dummy", 1);
+        SDL_SetHint(SDL_HINT_RENDER_DRIVER, "software");
+    } else {
+        SDL_SetHint(SDL_HINT_RENDER_DRIVER, "opengles2");
+    }
     SDL_Init(SDL_INIT_VIDEO | SDL_INIT_EVENTS);
     SDL_CreateWindowAndRenderer(720, 720, 0, &win, &renderer);
     SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
 
+    // With the framebuffer, the render target is only used to upload the frame to:
     renderTarget = SDL_CreateTexture(
         renderer,
-        SDL_PIXELFORMAT_RGBA8888,
-        SDL_TEXTUREACCESS_TARGET,
+        isFramebufferUsed ? FRAMEBUFFER_FORMAT : SDL_PIXELFORMAT_RGBA8888,
+        isFramebufferUsed ? SDL_TEXTUREACCESS_STREAMING : SDL_TEXTUREACCESS_TARGET,
         WINDOW_WIDTH / SCALE_FACTOR,
         WINDOW_HEIGHT / SCALE_FACTOR
     );
+    printLog("Framebuffer: %s", isFramebufferUsed ? "true" : "false");
 
     // Get renderer info
     SDL_RendererInfo info;
@@ -687,131 +1258,130 @@ int main(int argc, char *argv[]) {
     }
 
     initializeTextures();
+    initializeIconTextures();
 
     // Multi threading :-)
     SharedState state;
-    initSharedState(&state);
+    initSharedState(&state, project);
 
-    pthread_t timerThreadId, seqThreadId, keyThreadId;
+    if (headlessScript != NULL) {
+        // Everything runs on this thread, and the project is never saved:
+        if (!isFramebufferUsed) {
+            SDL_SetRenderTarget(renderer, renderTarget);
+        }
+        int result = runHeadless(&state, headlessScript);
+        cleanupTextures();
+        cleanupIconTextures();
+        SDL_DestroyTexture(renderTarget);
+        SDL_DestroyRenderer(renderer);
+        SDL_DestroyWindow(win);
+        SDL_Quit();
+        cleanupSharedState(&state);
+        return result;
+    }
+
+    pthread_t timerThreadId, seqThreadId, keyThreadId, midiClockThreadId;
+
+    // Without a frame limit, the renderer draws when a snapshot is published:
+    if (targetFps <= 0) {
+        Uint32 eventType = SDL_RegisterEvents(1);
+        if (eventType != (Uint32)-1) {
+            state.renderEventType = eventType;
+        }
+    }
+
+    // Changes are saved in the background, or on exit:
+    if (autosaveIntervalMs > 0) {
+        startAutosave(state.project, projectFile, &state.mutex, autosaveIntervalMs);
+    }
 
     // Create threads for sequencer and key input
     pthread_create(&seqThreadId, NULL, sequencerThread, &state);
     pthread_create(&keyThreadId, NULL, keyThread, &state);
+    if (clockInputDeviceName != NULL) {
+        printLog("Following the MIDI clock of: %s", clockInputDeviceName);
+        pthread_create(&midiClockThreadId, NULL, midiClockThread, &state);
+    }
     pthread_create(&timerThreadId, NULL, timerThread, &state);  // start the timer thread last
 
     // Event handler
     SDL_Event e;
+    double renPerformance = 0.0;
+    struct RenderSnapshot drawnSnapshot;    // What is drawn in the render target
+    bool isFrameDrawn = false;
+
+    // Frame pacing:
+    struct FrameScheduler frameScheduler;
+    struct FrameStats frameStats;
+    initializeFrameScheduler(&frameScheduler, targetFps, getMonotonicTimeNs());
+    resetFrameStats(&frameStats);
+    uint64_t frameStatsNs = getMonotonicTimeNs();
 
     // While application is running
     while(!state.quit) {
-        // Delegate keyboard events to the right thread:
-        while(SDL_PollEvent(&e) != 0 ) {
-            if (e.type == SDL_KEYDOWN) {
-                pthread_mutex_lock(&state.mutex);
-                state.scanCodeKeyDown = e.key.keysym.scancode;
-                pthread_mutex_unlock(&state.mutex);
-            } else if (e.type == SDL_KEYUP) {
-                pthread_mutex_lock(&state.mutex);
-                state.scanCodeKeyUp = e.key.keysym.scancode;
-                pthread_mutex_unlock(&state.mutex);
-            }
+        // Wait for events until the next frame is due, and delegate keyboard events to the right thread right away:
+        if (SDL_WaitEventTimeout(&e, getFrameTimeoutMs(&frameScheduler, getMonotonicTimeNs())) != 0) {
+            do {
+                if (e.type == SDL_KEYDOWN || e.type == SDL_KEYUP) {
+                    struct KeyEvent event = {
+                        .scancode = e.key.keysym.scancode,
+                        .isKeyDown = e.type == SDL_KEYDOWN,
+                        .timestamp = e.key.timestamp
+                    };
+                    if (!pushKeyEvent(&state.keyQueue, &event)) {
+                        printWarning("Key queue is full, dropped key event");
+                    }
+                } else if (state.renderEventType != 0 && e.type == state.renderEventType) {
+                    atomic_store(&state.isRenderEventPending, false);
+                } else if (e.type == SDL_RENDER_TARGETS_RESET || e.type == SDL_RENDER_DEVICE_RESET) {
+                    // The contents of the render target are lost:
+                    isFrameDrawn = false;
+                }
+            } while (SDL_PollEvent(&e) != 0);
         }
 
-        // Determine if rendering should take place:
-        if (state.isRenderRequired) {
-            if (isTimeMeasured) {
-                clock_gettime(CLOCK_MONOTONIC, &renStartTime);
-            }
+        // Report the frames once per second:
+        if (isTimeMeasured && getMonotonicTimeNs() - frameStatsNs >= NANOS_PER_SEC) {
+            printFrameStats(&frameStats);
+            resetFrameStats(&frameStats);
+            frameStatsNs = getMonotonicTimeNs();
+        }
 
-            // Set the render target to our texture
-            SDL_SetRenderTarget(renderer, renderTarget);
-            // Clear the render target
-            SDL_SetRenderDrawColor(renderer, COLOR_BLACK.r, COLOR_BLACK.g, COLOR_BLACK.b, 255);
-            SDL_RenderClear(renderer);
-
-            // BPM Blinker:
-            drawBPMBlinker(&state.ppqnCounter);
-
-            // Sidebar:
-            drawSideBar();
-            drawCurrentTrackIndicator(
-                state.selectedSequence + 1,
-                state.selectedPattern + 1,
-                state.selectedTrack + 1
-            );
-            drawBPMIndiciator(state.bpm);
-            drawPatternLengthIndicator(
-                state.patternStepCounter, 
-                state.project->sequences[state.selectedSequence].patterns[state.selectedPattern].length
-            );
+        // Everything the sequencer published since the last frame is coalesced into a single frame:
+        if (!isFrameDue(&frameScheduler, getMonotonicTimeNs())) {
+            continue;
+        }
 
-            // Basic Grid:
-            drawBasicGrid(state.keyStates);
-            
-            // Render proper screen / program / menu:
-            switch (state.screen) {
-                case BLIPR_SCREEN_TRACK_SELECTION:
-                    drawTrackSelection(&state.selectedTrack);    
-                    break;
-                case BLIPR_SCREEN_PATTERN_SELECTION:
-                    drawPatternSelection(&state.selectedPattern, &state.queuedPattern);
-                    break;
-                case BLIPR_SCREEN_SEQUENCE_SELECTION:
-                    drawSequenceSelection(&state.selectedSequence);
-                    break;
-                case BLIPR_SCREEN_CONFIGURATION:
-                    drawConfigSelection(state.project);    
-                    break;
-                case BLIPR_SCREEN_TRACK_OPTIONS:
-                    drawTrackOptions(state.track);
-                    break;
-                case BLIPR_SCREEN_PROGRAM_SELECTION:
-                    drawProgramSelection(state.track);
-                    break;
-                case BLIPR_SCREEN_PATTERN_OPTIONS:
-                    // No sequence options required?
-                    drawPatternOptions(&state.project->sequences[state.selectedSequence].patterns[state.selectedPattern]);
-                    break;
-                case BLIPR_SCREEN_UTILITIES:
-                    // Is this used?
-                    drawCenteredLine(2, 61, "(UTILITIES)", TITLE_WIDTH, COLOR_WHITE);
-                    break;
-                case BLIPR_SCREEN_TRANSPORT:
-                    drawCenteredLine(2, 61, "(TRANSPORT)", TITLE_WIDTH, COLOR_WHITE);
-                    break;
-                case BLIPR_SCREEN_NO_PROGRAM:
-                    drawCenteredLine(2, 61, "(NO PROGRAM)", TITLE_WIDTH, COLOR_WHITE);
-                    break;
-                case BLIPR_SCREEN_SEQUENCER: 
-                case BLIPR_SCREEN_DRUMKIT_SEQUENCER:
-                    drawSequencer(
-                        &state.ppqnCounter, 
-                        state.keyStates, 
-                        state.track,
-                        state.screen == BLIPR_SCREEN_DRUMKIT_SEQUENCER
-                    );
-                    break;
-                case BLIPR_SCREEN_FOUR_ON_THE_FLOOR:
-                    drawFourOnTheFloor(&state.ppqnCounter, state.track);
-                    break;
-                default:
-                    // Should not happen, but just in case
-                    drawCenteredLine(2, 61, "(NO SCREEN)", TITLE_WIDTH, COLOR_WHITE);
-                    break;
+        // Determine if rendering should take place (the sequencer published something new):
+        struct RenderSnapshot *snapshot = acquireRenderSnapshot(&state.renderSnapshots);
+        if (snapshot != NULL) {
+            // Skip the frame if nothing visible changed:
+            int regions = isFrameDrawn ? getDirtyRenderRegions(&drawnSnapshot, snapshot) : RENDER_REGION_ALL;
+            if (regions == 0) {
+                recordSkippedFrame(&frameStats);
+                continue;
             }
 
             if (isTimeMeasured) {
-                // Render in bottom right:
-                char seqText[10];
-                snprintf(seqText, 10, "S:%.2f%%", state.seqPerformance);
-                drawText(WIDTH - 45, HEIGHT - 12, seqText, 45, COLOR_YELLOW);
-                char renText[10];
-                snprintf(renText, 10, "R:%.2f%%", state.renPerformance);
-                drawText(WIDTH - 45, HEIGHT - 6, renText, 45, COLOR_YELLOW);
+                clock_gettime(CLOCK_MONOTONIC, &renStartTime);
+            }
+
+            // Set the render target to our texture, it still holds the previous frame
+            // (the framebuffer is kept in memory, and does not need one):
+            if (!isFramebufferUsed) {
+                SDL_SetRenderTarget(renderer, renderTarget);
             }
 
+            drawSnapshot(snapshot, regions, renPerformance);
+            drawnSnapshot = *snapshot;
+            isFrameDrawn = true;
+
             // Clear the renderer:
-            SDL_SetRenderTarget(renderer, NULL);
+            if (isFramebufferUsed) {
+                uploadFramebuffer(renderTarget);
+            } else {
+                SDL_SetRenderTarget(renderer, NULL);
+            }
 
             // Draw the scaled-up texture to the screen
             SDL_Rect destRect = {0, 0, WINDOW_WIDTH, WINDOW_HEIGHT};
@@ -823,31 +1393,32 @@ int main(int argc, char *argv[]) {
 
             // Render:
             SDL_RenderPresent(renderer);
-            
-            // Reset flag:
-            pthread_mutex_lock(&state.mutex);
-            state.isRenderRequired = false;
-            pthread_mutex_unlock(&state.mutex);
 
             if (isTimeMeasured) {
                 clock_gettime(CLOCK_MONOTONIC, &renEndTime);
                 int64_t elapsedNs = getTimespecDiffInNanoSeconds(&renStartTime, &renEndTime);
                 double percentage = ((double)elapsedNs / state.nanoSecondsPerPulse) * 100.0;
-                pthread_mutex_lock(&state.mutex);
-                state.renPerformance = percentage;
-                pthread_mutex_unlock(&state.mutex);
+                renPerformance = percentage;
+                recordFrameTime(&frameStats, elapsedNs);
                 print("Renderer took %dns to run (%.2f%%)", elapsedNs, percentage);
             }
         }
     }
 
+    closeKeyQueue(&state.keyQueue);
+
     cleanupTextures();
+    cleanupIconTextures();
     SDL_DestroyTexture(renderTarget);
     SDL_DestroyRenderer(renderer);
     SDL_DestroyWindow(win);
     SDL_Quit();
 
-    writeProjectFile(state.project, projectFile);
+    if (autosaveIntervalMs > 0) {
+        stopAutosave();
+    } else {
+        saveDirtyRegions(state.project, projectFile, &state.mutex);
+    }
     cleanupSharedState(&state);
     
     return 0;
@@ -8,11 +8,42 @@
 #include "constants.h"
 #include "print.h"
 #include "globals.h"
+#include "midi.h"
+#include "pulse_clock.h"
+#include "midi_clock.h"
 
 #define INPUT_BUFFER_SIZE 100
-#define OUTPUT_BUFFER_SIZE 100
-#define MIDI_CLOCK 0xF8
 #define MAX_NOTES 512
+#define NOTE_WHEEL_SIZE 256     // Must be a power of 2, note lengths beyond this take more turns of the wheel
+#define NO_NOTE -1
+#define SOUNDING_NOTES_HASH_SIZE 1024     // Must be a power of 2
+#define MIDI_OUTPUT_BUFFERS 4   // One for every device (A, B, C and D)
+
+/**
+ * Outgoing events for a single stream, collected during a pulse
+ */
+struct MidiOutputBuffer {
+    PmStream *stream;       // NULL when the buffer is not in use
+    int count;
+    PmEvent events[BLIPR_MIDI_BUFFER_SIZE];
+    uint64_t eventTimes[BLIPR_MIDI_BUFFER_SIZE];    // When the events should be heard (monotonic time in ns)
+};
+
+/**
+ * Latency of an opened output stream
+ */
+struct MidiOutputLatency {
+    PmStream *stream;
+    int latencyMs;          // 0 means timestamps are ignored and events are sent immediately
+};
+
+static struct MidiOutputBuffer outputBuffers[MIDI_OUTPUT_BUFFERS];
+static struct MidiOutputLatency outputLatencies[MIDI_OUTPUT_BUFFERS];
+
+// Time of the pulse that is being processed, and of the events that are added:
+static uint64_t pulseTimeNs = 0;
+static uint64_t pulseDurationNs = 0;
+static uint64_t eventTimeNs = 0;
 
 void handleMidiError(PmError error) {
     if (error != pmNoError) {
@@ -30,12 +61,143 @@ void listMidiDevices() {
     }
 }
 
-void sendMidiClock(PmStream *outputStream) {
-    PmEvent event;
-    event.message = Pm_Message(MIDI_CLOCK, 0, 0);
-    event.timestamp = 0; // Send immediately
-    PmError error = Pm_Write(outputStream, &event, 1);
+/**
+ * Get the latency a stream was opened with
+ */
+static int getMidiOutputLatency(PmStream *outputStream) {
+    for (int i = 0; i < MIDI_OUTPUT_BUFFERS; i++) {
+        if (outputLatencies[i].stream == outputStream) {
+            return outputLatencies[i].latencyMs;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Remember the latency of an opened stream
+ */
+static void setMidiOutputLatency(PmStream *outputStream, int latencyMs) {
+    for (int i = 0; i < MIDI_OUTPUT_BUFFERS; i++) {
+        if (outputLatencies[i].stream == outputStream || outputLatencies[i].stream == NULL) {
+            outputLatencies[i].stream = outputStream;
+            outputLatencies[i].latencyMs = latencyMs;
+            return;
+        }
+    }
+    printWarning("No room to register the latency of MIDI output stream");
+}
+
+void setMidiPulseTime(uint64_t timeNs, uint64_t durationNs) {
+    pulseTimeNs = timeNs;
+    pulseDurationNs = durationNs;
+    eventTimeNs = timeNs;
+}
+
+void setMidiSubPulse(int index, int count) {
+    eventTimeNs = pulseTimeNs + ((pulseDurationNs * index) / count);
+}
+
+/**
+ * Write all buffered events of a stream with a single call
+ */
+static void writeMidiOutputBuffer(struct MidiOutputBuffer *buffer) {
+    PmError error = Pm_Write(buffer->stream, buffer->events, buffer->count);
     handleMidiError(error);
+    buffer->count = 0;
+    buffer->stream = NULL;
+}
+
+/**
+ * Get the buffer for a stream, or claim a free one
+ */
+static struct MidiOutputBuffer* getMidiOutputBuffer(PmStream *outputStream) {
+    struct MidiOutputBuffer *freeBuffer = NULL;
+    for (int i = 0; i < MIDI_OUTPUT_BUFFERS; i++) {
+        if (outputBuffers[i].stream == outputStream) {
+            return &outputBuffers[i];
+        } else if (outputBuffers[i].stream == NULL && freeBuffer == NULL) {
+            freeBuffer = &outputBuffers[i];
+        }
+    }
+
+    if (freeBuffer != NULL) {
+        freeBuffer->stream = outputStream;
+        freeBuffer->count = 0;
+    }
+    return freeBuffer;
+}
+
+/**
+ * Convert the event times of a buffer to PortMidi timestamps, returns the smallest lead time in µs
+ */
+static int64_t timestampMidiOutputBuffer(struct MidiOutputBuffer *buffer, int latencyMs, PmTimestamp ptNow, uint64_t nowNs) {
+    int64_t minLeadTimeUs = INT64_MAX;
+    for (int i = 0; i < buffer->count; i++) {
+        // Negative when the sequencer woke up late, the latency gives room to still be on time:
+        int64_t offsetNs = (int64_t)(buffer->eventTimes[i] - nowNs);
+        int64_t offsetMs = (offsetNs + (offsetNs < 0 ? -NANOS_PER_MS : NANOS_PER_MS) / 2) / NANOS_PER_MS;
+        buffer->events[i].timestamp = ptNow + (PmTimestamp)offsetMs;
+        minLeadTimeUs = MIN(minLeadTimeUs, (latencyMs * 1000) + (offsetNs / 1000));
+    }
+    return minLeadTimeUs;
+}
+
+/**
+ * Add an event to the buffer of the stream, it is sent when the buffers are flushed
+ */
+static void queueMidiEvent(PmStream *outputStream, PmMessage message) {
+    struct MidiOutputBuffer *buffer = getMidiOutputBuffer(outputStream);
+    if (buffer == NULL) {
+        // More streams than buffers, send it right away:
+        PmEvent event = {0};
+        event.message = message;
+        event.timestamp = Pt_Started() ? Pt_Time() : 0;
+        handleMidiError(Pm_Write(outputStream, &event, 1));
+        return;
+    }
+
+    if (buffer->count == BLIPR_MIDI_BUFFER_SIZE) {
+        // Buffer is full, send what we have so far to keep the order intact:
+        flushMidiOutput();
+        buffer = getMidiOutputBuffer(outputStream);
+    }
+
+    buffer->events[buffer->count].message = message;
+    buffer->events[buffer->count].timestamp = 0; // Set when flushing
+    buffer->eventTimes[buffer->count] = eventTimeNs;
+    buffer->count++;
+}
+
+struct MidiFlushStats flushMidiOutput() {
+    struct MidiFlushStats stats = {0};
+    uint64_t startNs = getMonotonicTimeNs();
+    PmTimestamp ptNow = Pt_Started() ? Pt_Time() : 0;
+
+    for (int i = 0; i < MIDI_OUTPUT_BUFFERS; i++) {
+        if (outputBuffers[i].stream != NULL && outputBuffers[i].count > 0) {
+            int latencyMs = getMidiOutputLatency(outputBuffers[i].stream);
+            if (latencyMs > 0) {
+                int64_t leadTimeUs = timestampMidiOutputBuffer(&outputBuffers[i], latencyMs, ptNow, startNs);
+                stats.minLeadTimeUs = stats.timestampedEvents == 0 ? leadTimeUs : MIN(stats.minLeadTimeUs, leadTimeUs);
+                stats.timestampedEvents += outputBuffers[i].count;
+            }
+            stats.events += outputBuffers[i].count;
+            stats.writes++;
+            writeMidiOutputBuffer(&outputBuffers[i]);
+        }
+        outputBuffers[i].stream = NULL;
+    }
+
+    stats.elapsedNs = getMonotonicTimeNs() - startNs;
+    return stats;
+}
+
+void sendMidiClock(PmStream *outputStream) {
+    if (outputStream == NULL) {
+        return;
+    }
+
+    queueMidiEvent(outputStream, Pm_Message(MIDI_CLOCK_TICK, 0, 0));
 }
 
 void openMidiInput(int deviceId, PmStream **inputStream) {
@@ -44,10 +206,44 @@ void openMidiInput(int deviceId, PmStream **inputStream) {
     printLog("Opened input device %d", deviceId);
 }
 
-void openMidiOutput(int deviceId, PmStream **outputStream) {
-    PmError error = Pm_OpenOutput(outputStream, deviceId, NULL, OUTPUT_BUFFER_SIZE, NULL, NULL, 0);
+/**
+ * Time proc for PortMidi, the same clock the timestamps are calculated with
+ */
+static PmTimestamp getPortTime(void *timeInfo) {
+    (void)timeInfo;
+    return Pt_Time();
+}
+
+void openMidiOutput(int deviceId, PmStream **outputStream, int latencyMs) {
+    // With a latency, PortMidi schedules the events on their timestamps (using PortTime as time base):
+    PmTimeProcPtr timeProc = NULL;
+    if (latencyMs > 0) {
+        if (!Pt_Started()) {
+            Pt_Start(1, NULL, NULL);
+        }
+        timeProc = getPortTime;
+    }
+
+    PmError error = Pm_OpenOutput(outputStream, deviceId, NULL, BLIPR_MIDI_BUFFER_SIZE, timeProc, NULL, latencyMs);
     handleMidiError(error);
-    printLog("Opened output device %d", deviceId);
+    if (*outputStream != NULL) {
+        setMidiOutputLatency(*outputStream, latencyMs);
+    }
+    printLog("Opened output device %d (latency %dms)", deviceId, latencyMs);
+}
+
+void closeMidiOutput(PmStream *outputStream) {
+    if (outputStream == NULL) {
+        return;
+    }
+
+    for (int i = 0; i < MIDI_OUTPUT_BUFFERS; i++) {
+        if (outputLatencies[i].stream == outputStream) {
+            outputLatencies[i].stream = NULL;
+            outputLatencies[i].latencyMs = 0;
+        }
+    }
+    handleMidiError(Pm_Close(outputStream));
 }
 
 void sendMidiMessage(PmStream *outputStream, int status, int data1, int data2) {
@@ -59,10 +255,7 @@ void sendMidiMessage(PmStream *outputStream, int status, int data1, int data2) {
         printLog("MIDI: 0x%X 0x%X 0x%X", status, data1, data2);
     }
 
-    PmEvent event = {0};
-    event.message = Pm_Message(status, data1, data2);
-    PmError error = Pm_Write(outputStream, &event, 1);
-    handleMidiError(error);
+    queueMidiEvent(outputStream, Pm_Message(status, data1, data2));
 }
 
 void sendMidiNoteOn(PmStream *outputStream, int channel, int noteNumber, int velocity) {
@@ -73,22 +266,47 @@ void sendMidiNoteOff(PmStream *outputStream, int channel, int noteNumber) {
     sendMidiMessage(outputStream, channel | 0x80, noteNumber, 0);
 }
 
-void processMidiInput(PmStream *inputStream) {
-    PmEvent buffer[32];
-    int num_events = Pm_Read(inputStream, buffer, 32);
-    
-    for (int i = 0; i < num_events; i++) {
-        int status = Pm_MessageStatus(buffer[i].message);
-        int data1 = Pm_MessageData1(buffer[i].message);
-        int data2 = Pm_MessageData2(buffer[i].message);
-        
-        printf("Received MIDI message: status = %02X, data1 = %02X, data2 = %02X\n", status, data1, data2);
-        
-        // Check for MIDI clock message
-        if (status == 0xF8) {
-            printf("Received MIDI Clock\n");
+int readMidiInput(PmStream *inputStream, PmEvent *events, int maxEvents) {
+    int num_events = Pm_Read(inputStream, events, maxEvents);
+    if (num_events < 0) {
+        return 0;
+    }
+
+    if (isMidiDataLogged) {
+        for (int i = 0; i < num_events; i++) {
+            int status = Pm_MessageStatus(events[i].message);
+            if (status != MIDI_CLOCK_TICK) {
+                // Ignoring clock:
+                printLog(
+                    "MIDI in: 0x%X 0x%X 0x%X",
+                    status,
+                    Pm_MessageData1(events[i].message),
+                    Pm_MessageData2(events[i].message)
+                );
+            }
+        }
+    }
+
+    return num_events;
+}
+
+void processMidiClockEvents(struct MidiClock *midiClock, const PmEvent *events, int count, uint64_t timeNs) {
+    for (int i = 0; i < count; i++) {
+        processMidiClockMessage(midiClock, Pm_MessageStatus(events[i].message), timeNs);
+    }
+}
+
+int getInputDeviceIdByDeviceName(char* deviceName) {
+    int num_devices = Pm_CountDevices();
+    for (int i = 0; i < num_devices; i++) {
+        const PmDeviceInfo *info = Pm_GetDeviceInfo(i);
+        if (info->input) {
+            if (strcmp(deviceName, info->name) == 0) {
+                return i;
+            }
         }
     }
+    return -1;
 }
 
 int getOutputDeviceIdByDeviceName(char* deviceName) {
@@ -111,50 +329,238 @@ typedef struct {
     struct Note note;  // Pointer to the original note
     PmStream* outputStream;   // The MIDI output stream
     int midiChannel;          // The MIDI channel
-    int counter;              // Counter for pulses
+    uint32_t expiresAt;       // Tick at which the note off is sent
+    int16_t next;             // Next/previous note in the same wheel slot (next is also used for the free list)
+    int16_t prev;
+    int16_t newer;            // Newer/older playing note, to find the oldest voice
+    int16_t older;
+    int16_t sameHash;         // Next note with the same (stream, channel, note) hash
     bool active;              // Whether this slot is in use
 } NoteTracker;
 
 NoteTracker activeNotes[MAX_NOTES];
 
+// Note offs are kept in a timing wheel, with a slot per tick:
+static int16_t noteWheel[NOTE_WHEEL_SIZE];
+static uint32_t noteTick = 0;
+static int16_t freeNotes = NO_NOTE;
+static int16_t oldestNote = NO_NOTE;
+static int16_t newestNote = NO_NOTE;
+static int activeNoteCount = 0;
+
+// Sounding notes by (stream, channel, note), to detect retriggers:
+static int16_t soundingNotes[SOUNDING_NOTES_HASH_SIZE];
+
 void initializeNoteTracker() {
     for (int i = 0; i < MAX_NOTES; i++) {
         activeNotes[i].outputStream = NULL;
         activeNotes[i].midiChannel = 0;
-        activeNotes[i].counter = 0;
+        activeNotes[i].expiresAt = 0;
+        activeNotes[i].next = i + 1 < MAX_NOTES ? i + 1 : NO_NOTE;
+        activeNotes[i].prev = NO_NOTE;
+        activeNotes[i].newer = NO_NOTE;
+        activeNotes[i].older = NO_NOTE;
+        activeNotes[i].sameHash = NO_NOTE;
         activeNotes[i].active = false;
     }
+    for (int i = 0; i < NOTE_WHEEL_SIZE; i++) {
+        noteWheel[i] = NO_NOTE;
+    }
+    for (int i = 0; i < SOUNDING_NOTES_HASH_SIZE; i++) {
+        soundingNotes[i] = NO_NOTE;
+    }
+    noteTick = 0;
+    freeNotes = 0;
+    oldestNote = NO_NOTE;
+    newestNote = NO_NOTE;
+    activeNoteCount = 0;
 }
 
-void addNoteToTracker(PmStream* outputStream, int midiChannel, const struct Note* note) {
-    // Create a copy of the struct, because when using a pointer the note off can be missed if the MIDI note byte is changed:
-    for (int i = 0; i < MAX_NOTES; i++) {
-        if (!activeNotes[i].active) {
-            activeNotes[i].note = *note;
-            activeNotes[i].outputStream = outputStream;
-            activeNotes[i].midiChannel = midiChannel;
-            activeNotes[i].counter = MAX(1, note->length);  // TODO: Make a proper calculation for length here.
-            activeNotes[i].active = true;
+/**
+ * Get the hash slot of a sounding note
+ */
+static int getSoundingNoteHash(PmStream *outputStream, int midiChannel, unsigned char midiNote) {
+    uintptr_t hash = ((uintptr_t)outputStream >> 4) * 31 + (midiChannel * 128) + midiNote;
+    return hash & (SOUNDING_NOTES_HASH_SIZE - 1);
+}
+
+/**
+ * Find the tracker of a note that is still sounding, returns NO_NOTE if there is none
+ */
+static int16_t findSoundingNote(PmStream *outputStream, int midiChannel, unsigned char midiNote) {
+    int16_t index = soundingNotes[getSoundingNoteHash(outputStream, midiChannel, midiNote)];
+    while (index != NO_NOTE) {
+        const NoteTracker *tracker = &activeNotes[index];
+        if (
+            tracker->outputStream == outputStream && 
+            tracker->midiChannel == midiChannel && 
+            tracker->note.note == midiNote
+        ) {
+            return index;
+        }
+        index = tracker->sameHash;
+    }
+    return NO_NOTE;
+}
+
+/**
+ * Add a note to the wheel slot of the tick it expires on
+ */
+static void linkNoteToWheel(int16_t index) {
+    NoteTracker *tracker = &activeNotes[index];
+    int slot = tracker->expiresAt & (NOTE_WHEEL_SIZE - 1);
+    tracker->prev = NO_NOTE;
+    tracker->next = noteWheel[slot];
+    if (tracker->next != NO_NOTE) {
+        activeNotes[tracker->next].prev = index;
+    }
+    noteWheel[slot] = index;
+}
+
+static void unlinkNoteFromWheel(int16_t index) {
+    NoteTracker *tracker = &activeNotes[index];
+    if (tracker->prev != NO_NOTE) {
+        activeNotes[tracker->prev].next = tracker->next;
+    } else {
+        noteWheel[tracker->expiresAt & (NOTE_WHEEL_SIZE - 1)] = tracker->next;
+    }
+    if (tracker->next != NO_NOTE) {
+        activeNotes[tracker->next].prev = tracker->prev;
+    }
+    tracker->prev = NO_NOTE;
+    tracker->next = NO_NOTE;
+}
+
+/**
+ * Add a note as the newest one
+ */
+static void linkNoteAsNewest(int16_t index) {
+    NoteTracker *tracker = &activeNotes[index];
+    tracker->newer = NO_NOTE;
+    tracker->older = newestNote;
+    if (newestNote != NO_NOTE) {
+        activeNotes[newestNote].newer = index;
+    } else {
+        oldestNote = index;
+    }
+    newestNote = index;
+}
+
+static void unlinkNoteFromAge(int16_t index) {
+    NoteTracker *tracker = &activeNotes[index];
+    if (tracker->older != NO_NOTE) {
+        activeNotes[tracker->older].newer = tracker->newer;
+    } else {
+        oldestNote = tracker->newer;
+    }
+    if (tracker->newer != NO_NOTE) {
+        activeNotes[tracker->newer].older = tracker->older;
+    } else {
+        newestNote = tracker->older;
+    }
+    tracker->newer = NO_NOTE;
+    tracker->older = NO_NOTE;
+}
+
+static void unlinkNoteFromHash(int16_t index) {
+    NoteTracker *tracker = &activeNotes[index];
+    int16_t *link = &soundingNotes[getSoundingNoteHash(tracker->outputStream, tracker->midiChannel, tracker->note.note)];
+    while (*link != NO_NOTE) {
+        if (*link == index) {
+            *link = tracker->sameHash;
             break;
         }
+        link = &activeNotes[*link].sameHash;
     }
+    tracker->sameHash = NO_NOTE;
 }
 
-void updateNotesAndSendOffs() {
-    for (int i = 0; i < MAX_NOTES; i++) {
-        if (activeNotes[i].active) {
-            activeNotes[i].counter--;
-            if (activeNotes[i].counter <= 0) {
-                sendMidiNoteOff(activeNotes[i].outputStream, 
-                                activeNotes[i].midiChannel, 
-                                activeNotes[i].note.note);
-                activeNotes[i].active = false;
-                activeNotes[i].outputStream = NULL;
+/**
+ * Remove a note from the tracker and send its note off
+ */
+static void releaseNote(int16_t index) {
+    NoteTracker *tracker = &activeNotes[index];
+
+    unlinkNoteFromWheel(index);
+    unlinkNoteFromAge(index);
+    unlinkNoteFromHash(index);
+
+    sendMidiNoteOff(tracker->outputStream, tracker->midiChannel, tracker->note.note);
+
+    tracker->active = false;
+    tracker->outputStream = NULL;
+    tracker->next = freeNotes;
+    freeNotes = index;
+    activeNoteCount--;
+}
+
+void addNoteToTracker(PmStream* outputStream, int midiChannel, const struct Note* note, int lengthInPulses) {
+    uint32_t expiresAt = noteTick + MAX(1, lengthInPulses);
+
+    // A retrigger of a note that is still sounding restarts it, instead of cutting the new note with the old note off:
+    int16_t index = findSoundingNote(outputStream, midiChannel, note->note);
+    if (index != NO_NOTE) {
+        NoteTracker *tracker = &activeNotes[index];
+        unlinkNoteFromWheel(index);
+        unlinkNoteFromAge(index);
+        tracker->note = *note;
+        tracker->expiresAt = expiresAt;
+        linkNoteToWheel(index);
+        linkNoteAsNewest(index);
+        return;
+    }
+
+    if (freeNotes == NO_NOTE) {
+        // All voices are in use, steal the oldest one (it gets its note off now, instead of never):
+        printWarning(
+            "Note tracker is full, stealing the oldest voice (note %d, channel %d)", 
+            activeNotes[oldestNote].note.note, 
+            activeNotes[oldestNote].midiChannel + 1
+        );
+        releaseNote(oldestNote);
+    }
+
+    index = freeNotes;
+    NoteTracker *tracker = &activeNotes[index];
+    freeNotes = tracker->next;
+
+    // Create a copy of the struct, because when using a pointer the note off can be missed if the MIDI note byte is changed:
+    tracker->note = *note;
+    tracker->outputStream = outputStream;
+    tracker->midiChannel = midiChannel;
+    tracker->expiresAt = expiresAt;
+    tracker->active = true;
+
+    linkNoteToWheel(index);
+    linkNoteAsNewest(index);
+
+    int hash = getSoundingNoteHash(outputStream, midiChannel, note->note);
+    tracker->sameHash = soundingNotes[hash];
+    soundingNotes[hash] = index;
+
+    activeNoteCount++;
+}
+
+void updateNotesAndSendOffs(int pulses) {
+    for (int i = 0; i < pulses; i++) {
+        noteTick++;
+
+        // Only the notes in the slot of this tick can be due (notes that are a full turn of the wheel away are skipped):
+        int16_t index = noteWheel[noteTick & (NOTE_WHEEL_SIZE - 1)];
+        while (index != NO_NOTE) {
+            int16_t next = activeNotes[index].next;
+            if (activeNotes[index].expiresAt == noteTick) {
+                releaseNote(index);
             }
+            index = next;
         }
     }
 }
 
+int getActiveNoteCount() {
+    return activeNoteCount;
+}
+
 char* getMidiNoteName(unsigned char midiNote) {
     static char noteName[5];  // Static array to hold the result
 
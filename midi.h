@@ -3,6 +3,20 @@
 
 #include <portmidi.h>
 #include <porttime.h>
+#include <stdint.h>
+#include "project.h"
+#include "midi_clock.h"
+
+/**
+ * Statistics of a single flush of the MIDI output buffers
+ */
+struct MidiFlushStats {
+    int events;             // Number of events sent
+    int writes;             // Number of Pm_Write() calls
+    uint64_t elapsedNs;     // Time it took to write everything
+    int timestampedEvents;  // Number of events sent to streams that have a latency
+    int64_t minLeadTimeUs;  // Smallest time between sending and hearing a timestamped event, negative if it was late
+};
 
 void handleMidiError(PmError error);
 
@@ -14,15 +28,34 @@ void listMidiDevices();
 /**
  * Open device for midi input
  */
-void openMidiInput(int deviceId, PmStream *inputStream);
+void openMidiInput(int deviceId, PmStream **inputStream);
+
+/**
+ * Open device for midi output.
+ * With a latency (in ms), events are timestamped and delivered by PortMidi at the time they should be heard
+ */
+void openMidiOutput(int deviceId, PmStream **outputStream, int latencyMs);
+
+/**
+ * Close a midi output device
+ */
+void closeMidiOutput(PmStream *outputStream);
+
+/**
+ * Set the time (monotonic, in ns) and duration of the pulse that is being processed.
+ * All following events are stamped with this time
+ */
+void setMidiPulseTime(uint64_t timeNs, uint64_t durationNs);
 
 /**
- * Open device for midi output
+ * Stamp the following events with the time of a part of the current pulse,
+ * for tracks that run faster than the clock
  */
-void openMidiOutput(int deviceId, PmStream *outputStream);
+void setMidiSubPulse(int index, int count);
 
 /**
- * Send midi message
+ * Send midi message.
+ * Messages are buffered per stream, and are sent with flushMidiOutput()
  */
 void sendMidiMessage(PmStream *outputStream, int status, int data1, int data2);
 
@@ -37,9 +70,21 @@ void sendMidiNoteOn(PmStream *outputStream, int channel, int noteNumber, int vel
 void sendMidiNoteOff(PmStream *outputStream, int channel, int noteNumber);
 
 /**
- * Process midi input
+ * Read the pending midi input (at most maxEvents messages), and log it if the MIDI data is logged.
+ * Returns the number of messages that were read
  */
-void processMidiInput(PmStream *inputStream);
+int readMidiInput(PmStream *inputStream, PmEvent *events, int maxEvents);
+
+/**
+ * Pass the clock messages of the read input to the MIDI clock, other messages are ignored.
+ * The time is when the input was read (monotonic time in nanoseconds)
+ */
+void processMidiClockEvents(struct MidiClock *midiClock, const PmEvent *events, int count, uint64_t timeNs);
+
+/**
+ * Returns -1 if not device is found with the given name
+ */
+int getInputDeviceIdByDeviceName(char* deviceName);
 
 /**
  * Returns -1 if not device is found with the given name
@@ -52,11 +97,31 @@ int getOutputDeviceIdByDeviceName(char* deviceName);
 void sendMidiClock(PortMidiStream *stream);
 
 void initializeNoteTracker();
-void addNoteToTracker(PmStream* outputStream, int midiChannel, const struct Note* note);
-void updateNotesAndSendOffs();
+
+/**
+ * Schedule the note off for a note that is played, after the given number of pulses.
+ * If the same note is still sounding on this stream and channel, that note is restarted instead.
+ * If all voices are in use, the oldest one is stopped to make room
+ */
+void addNoteToTracker(PmStream* outputStream, int midiChannel, const struct Note* note, int lengthInPulses);
+
+/**
+ * Advance the note tracker with a number of pulses, and send the note offs that are due
+ */
+void updateNotesAndSendOffs(int pulses);
+
+/**
+ * Get the number of notes that are waiting for their note off
+ */
+int getActiveNoteCount();
 
 char* getMidiNoteName(unsigned char midiNote);
 
 void sendProgramChange(PortMidiStream *stream, int channel, int program);
 
+/**
+ * Send all buffered messages, with a single write per stream (in the order they were added)
+ */
+struct MidiFlushStats flushMidiOutput();
+
 #endif
\ No newline at end of file
@@ -0,0 +1,123 @@
+#include <math.h>
+#include "midi_clock.h"
+#include "constants.h"
+
+// Loop gain: the phase follows this part of every error, the period a much smaller part of it.
+// Right after the tempo is measured, the gain starts higher, so the loop locks in quickly
+#define MIDI_CLOCK_PHASE_GAIN 0.1
+
+// Tempo range that is accepted (in ns per tick), slower or faster ticks do not set the tempo
+#define MIDI_CLOCK_MIN_PERIOD_NS (60.0 * NANOS_PER_SEC / (400.0 * PPQN))
+#define MIDI_CLOCK_MAX_PERIOD_NS (60.0 * NANOS_PER_SEC / (20.0 * PPQN))
+
+void initializeMidiClock(struct MidiClock *midiClock) {
+    midiClock->isRunning = false;
+    midiClock->isPhaseKnown = false;
+    midiClock->isPeriodKnown = false;
+    midiClock->tickTimeNs = 0.0;
+    midiClock->periodNs = 0.0;
+    midiClock->lockedTicks = 0;
+    midiClock->ticks = 0;
+    midiClock->starts = 0;
+    midiClock->updates = 0;
+}
+
+/**
+ * Update the loop with a received tick.
+ * Returns the number of ticks it advanced the clock, including the ticks that went missing
+ */
+static uint64_t processMidiClockTick(struct MidiClock *midiClock, double timeNs) {
+    if (!midiClock->isPhaseKnown) {
+        midiClock->tickTimeNs = timeNs;
+        midiClock->isPhaseKnown = true;
+        return 1;
+    }
+
+    double elapsedNs = timeNs - midiClock->tickTimeNs;
+    if (!midiClock->isPeriodKnown) {
+        if (elapsedNs < MIDI_CLOCK_MIN_PERIOD_NS || elapsedNs > MIDI_CLOCK_MAX_PERIOD_NS) {
+            // Not a usable tempo, start measuring again:
+            midiClock->tickTimeNs = timeNs;
+            return 0;
+        }
+        midiClock->periodNs = elapsedNs;
+        midiClock->isPeriodKnown = true;
+        midiClock->lockedTicks = 0;
+        midiClock->tickTimeNs = timeNs;
+        return 1;
+    }
+
+    // Ticks that went missing are counted as well:
+    double ticks = round(elapsedNs / midiClock->periodNs);
+    if (ticks < 1.0) {
+        ticks = 1.0;
+    }
+    double predictedNs = midiClock->tickTimeNs + ticks * midiClock->periodNs;
+    double errorNs = timeNs - predictedNs;
+
+    // Critically damped alpha-beta filter:
+    midiClock->lockedTicks++;
+    double phaseGain = fmax(MIDI_CLOCK_PHASE_GAIN, 2.0 / (midiClock->lockedTicks + 1));
+    double periodGain = phaseGain * phaseGain / (2.0 - phaseGain);
+    midiClock->tickTimeNs = predictedNs + phaseGain * errorNs;
+    midiClock->periodNs += periodGain * errorNs / ticks;
+    midiClock->periodNs = fmin(fmax(midiClock->periodNs, MIDI_CLOCK_MIN_PERIOD_NS), MIDI_CLOCK_MAX_PERIOD_NS);
+    return (uint64_t)ticks;
+}
+
+void processMidiClockMessage(struct MidiClock *midiClock, int status, uint64_t timeNs) {
+    switch (status) {
+        case MIDI_CLOCK_TICK:
+        {
+            // The tempo is followed while stopped as well, but the song position only moves while running
+            // (masters keep sending ticks while stopped):
+            uint64_t ticks = processMidiClockTick(midiClock, (double)timeNs);
+            if (midiClock->isRunning) {
+                midiClock->ticks += ticks;
+            }
+            break;
+        }
+        case MIDI_CLOCK_START:
+            midiClock->isRunning = true;
+            midiClock->isPhaseKnown = false;
+            midiClock->ticks = 0;
+            midiClock->starts++;
+            break;
+        case MIDI_CLOCK_CONTINUE:
+            // The position continues, but the phase is picked up from the next tick:
+            midiClock->isRunning = true;
+            midiClock->isPhaseKnown = false;
+            break;
+        case MIDI_CLOCK_STOP:
+            midiClock->isRunning = false;
+            break;
+        default:
+            return;
+    }
+    midiClock->updates++;
+}
+
+bool isMidiClockLocked(const struct MidiClock *midiClock) {
+    return midiClock->isRunning && midiClock->isPhaseKnown && midiClock->isPeriodKnown && midiClock->ticks > 0;
+}
+
+int getMidiClockBPM(const struct MidiClock *midiClock) {
+    if (!midiClock->isPeriodKnown) {
+        return 0;
+    }
+    return (int)round(60.0 * NANOS_PER_SEC / (midiClock->periodNs * PPQN));
+}
+
+uint64_t getMidiClockPulsePeriod(const struct MidiClock *midiClock) {
+    return (uint64_t)(midiClock->periodNs / PPQN_MULTIPLIER * 4294967296.0);
+}
+
+void syncPulseClockToMidiClock(struct PulseClock *pulseClock, const struct MidiClock *midiClock, uint64_t startPulse) {
+    pulseClock->anchorNs = (uint64_t)midiClock->tickTimeNs;
+    pulseClock->anchorPulse = startPulse + (midiClock->ticks - 1) * PPQN_MULTIPLIER;
+    pulseClock->period = getMidiClockPulsePeriod(midiClock);
+}
+
+uint64_t getMidiClockPulseLimit(const struct MidiClock *midiClock, uint64_t startPulse) {
+    return startPulse + midiClock->ticks * PPQN_MULTIPLIER;
+}
@@ -0,0 +1,70 @@
+#ifndef MIDI_CLOCK_H
+#define MIDI_CLOCK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "pulse_clock.h"
+
+#define MIDI_CLOCK_TICK 0xF8
+#define MIDI_CLOCK_START 0xFA
+#define MIDI_CLOCK_CONTINUE 0xFB
+#define MIDI_CLOCK_STOP 0xFC
+
+/**
+ * Follows an external MIDI clock (24 ticks per quarter note).
+ * The received ticks are jittery (USB polling, the input thread waking up), so they are not used
+ * directly: a phase locked loop predicts when the next tick should happen, and only corrects its
+ * phase and period with a fraction of the error of every tick. The internal pulse clock is
+ * anchored on the filtered ticks, which also interpolates the pulses in between (PPQN_MULTIPLIER
+ * pulses per tick).
+ */
+struct MidiClock {
+    bool isRunning;             // Between start (or continue) and stop
+    bool isPhaseKnown;          // Set by the first tick, after (re)starting
+    bool isPeriodKnown;         // Set by the second tick
+    double tickTimeNs;          // Filtered time of the last tick (monotonic time)
+    double periodNs;            // Filtered time between 2 ticks
+    uint64_t lockedTicks;       // Ticks since the period is known, for the loop gain
+    uint64_t ticks;             // Song position: ticks while running since the last start (including the ticks that went missing)
+    uint64_t starts;            // Increased on every start, the song starts from the beginning
+    uint64_t updates;           // Increased on every change, so followers know when to sync
+};
+
+/**
+ * Initialize a stopped clock
+ */
+void initializeMidiClock(struct MidiClock *midiClock);
+
+/**
+ * Process a MIDI realtime message (tick, start, continue or stop), other messages are ignored.
+ * The time is when the message was received (monotonic time in nanoseconds)
+ */
+void processMidiClockMessage(struct MidiClock *midiClock, int status, uint64_t timeNs);
+
+/**
+ * Check if the clock is running and its tempo is known, so pulses can be scheduled
+ */
+bool isMidiClockLocked(const struct MidiClock *midiClock);
+
+/**
+ * Get the tempo of the clock (rounded to whole BPM)
+ */
+int getMidiClockBPM(const struct MidiClock *midiClock);
+
+/**
+ * Get the period of the internal pulses in 32.32 fixed-point nanoseconds (like calculatePulsePeriod())
+ */
+uint64_t getMidiClockPulsePeriod(const struct MidiClock *midiClock);
+
+/**
+ * Anchor a pulse clock on the last tick, where startPulse is the pulse of the clock on which the song started.
+ * Only valid when the clock is locked
+ */
+void syncPulseClockToMidiClock(struct PulseClock *pulseClock, const struct MidiClock *midiClock, uint64_t startPulse);
+
+/**
+ * Get the last pulse that may be played, the pulse clock never runs more than a single tick ahead of the master
+ */
+uint64_t getMidiClockPulseLimit(const struct MidiClock *midiClock, uint64_t startPulse);
+
+#endif
@@ -11,6 +11,7 @@
 #include <portmidi.h>
 #include <porttime.h>
 #include "../print.h"
+#include "config_selection.h"
 
 bool isMidiConfigActive = false;
 int selectedMidiDevice = BLIPR_MIDI_DEVICE_A;
@@ -24,8 +25,49 @@ void resetConfigurationScreen() {
     selectedMidiDevice = BLIPR_MIDI_DEVICE_A;
 }
 
-void drawConfigSelection(struct Project *project) {
-    if (isMainScreen()) {
+/**
+ * Get the text for a latency button, 0 means the events are sent immediately
+ */
+static void getLatencyText(char text[4], unsigned char latency) {
+    if (latency == 0) {
+        strcpy(text, "OFF");
+    } else {
+        snprintf(text, 4, "%d", latency);
+    }
+}
+
+/**
+ * Increase the latency of a device, loops back to 0
+ */
+static void increaseLatency(unsigned char *latency) {
+    *latency = *latency + BLIPR_MIDI_LATENCY_STEP;
+    if (*latency > BLIPR_MIDI_MAX_LATENCY) {
+        *latency = 0;
+    }
+}
+
+/**
+ * Copy the settings of the project and the state of the configuration screen
+ */
+void getConfigScreenState(const struct Project *project, struct ConfigScreenState *config) {
+    config->isMidiConfigActive = isMidiConfigActive;
+    config->selectedMidiDevice = selectedMidiDevice;
+    memcpy(config->midiDeviceNames[BLIPR_MIDI_DEVICE_A], project->midiDeviceAName, 32);
+    memcpy(config->midiDeviceNames[BLIPR_MIDI_DEVICE_B], project->midiDeviceBName, 32);
+    memcpy(config->midiDeviceNames[BLIPR_MIDI_DEVICE_C], project->midiDeviceCName, 32);
+    memcpy(config->midiDeviceNames[BLIPR_MIDI_DEVICE_D], project->midiDeviceDName, 32);
+    config->midiDevicePcChannels[BLIPR_MIDI_DEVICE_A] = project->midiDevicePcChannelA;
+    config->midiDevicePcChannels[BLIPR_MIDI_DEVICE_B] = project->midiDevicePcChannelB;
+    config->midiDevicePcChannels[BLIPR_MIDI_DEVICE_C] = project->midiDevicePcChannelC;
+    config->midiDevicePcChannels[BLIPR_MIDI_DEVICE_D] = project->midiDevicePcChannelD;
+    config->midiDeviceLatencies[BLIPR_MIDI_DEVICE_A] = project->midiDeviceLatencyA;
+    config->midiDeviceLatencies[BLIPR_MIDI_DEVICE_B] = project->midiDeviceLatencyB;
+    config->midiDeviceLatencies[BLIPR_MIDI_DEVICE_C] = project->midiDeviceLatencyC;
+    config->midiDeviceLatencies[BLIPR_MIDI_DEVICE_D] = project->midiDeviceLatencyD;
+}
+
+void drawConfigSelection(const struct ConfigScreenState *config) {
+    if (!config->isMidiConfigActive) {
         drawIconOnIndex(0, BLIPR_ICON_MIDI);    // Midi Device A
         drawIconOnIndex(1, BLIPR_ICON_MIDI);    // Midi Device B
         drawIconOnIndex(2, BLIPR_ICON_MIDI);    // Midi Device C
@@ -33,15 +75,26 @@ void drawConfigSelection(struct Project *project) {
 
         // MIDI PC channel settings:
         char ch[4];
-        sprintf(ch, "%d", project->midiDevicePcChannelA + 1);
+        sprintf(ch, "%d", config->midiDevicePcChannels[BLIPR_MIDI_DEVICE_A] + 1);
         drawRotatingButton(4, "PC.A", ch);
-        sprintf(ch, "%d", project->midiDevicePcChannelB + 1);
+        sprintf(ch, "%d", config->midiDevicePcChannels[BLIPR_MIDI_DEVICE_B] + 1);
         drawRotatingButton(5, "PC.B", ch);
-        sprintf(ch, "%d", project->midiDevicePcChannelC + 1);
+        sprintf(ch, "%d", config->midiDevicePcChannels[BLIPR_MIDI_DEVICE_C] + 1);
         drawRotatingButton(6, "PC.C", ch);
-        sprintf(ch, "%d", project->midiDevicePcChannelD + 1);
+        sprintf(ch, "%d", config->midiDevicePcChannels[BLIPR_MIDI_DEVICE_D] + 1);
         drawRotatingButton(7, "PC.D", ch);
 
+        // MIDI output latency settings:
+        char lt[4];
+        getLatencyText(lt, config->midiDeviceLatencies[BLIPR_MIDI_DEVICE_A]);
+        drawRotatingButton(8, "LT.A", lt);
+        getLatencyText(lt, config->midiDeviceLatencies[BLIPR_MIDI_DEVICE_B]);
+        drawRotatingButton(9, "LT.B", lt);
+        getLatencyText(lt, config->midiDeviceLatencies[BLIPR_MIDI_DEVICE_C]);
+        drawRotatingButton(10, "LT.C", lt);
+        getLatencyText(lt, config->midiDeviceLatencies[BLIPR_MIDI_DEVICE_D]);
+        drawRotatingButton(11, "LT.D", lt);
+
         // Quit:
         drawTextOnButton(15, "Q");  // Quit
         drawCenteredLine(2, 133, "CONFIGURATION", TITLE_WIDTH, COLOR_WHITE);
@@ -51,10 +104,10 @@ void drawConfigSelection(struct Project *project) {
         drawABCDButtons(descriptions);
         drawHighlightedGridTile(18);
     } else {
-        if (isMidiConfigActive) {
+        if (config->isMidiConfigActive) {
             drawCenteredLine(2, 130, "SELECT A DEVICE FOR", TITLE_WIDTH, COLOR_WHITE);
             char line2[32];
-            switch (selectedMidiDevice) {
+            switch (config->selectedMidiDevice) {
                 case BLIPR_MIDI_DEVICE_A:
                     strcpy(line2, "MIDI SLOT A");
                     break;
@@ -77,13 +130,8 @@ void drawConfigSelection(struct Project *project) {
             // drawHighlightedGridTile(16 + selectedMidiDevice);
 
             // Midi device #0 is "NONE"
-            bool isSelected = false;
-            if (
-                (selectedMidiDevice == BLIPR_MIDI_DEVICE_A && strcmp(project->midiDeviceAName, "") == 0) ||
-                (selectedMidiDevice == BLIPR_MIDI_DEVICE_B && strcmp(project->midiDeviceBName, "") == 0) ||
-                (selectedMidiDevice == BLIPR_MIDI_DEVICE_C && strcmp(project->midiDeviceCName, "") == 0) ||
-                (selectedMidiDevice == BLIPR_MIDI_DEVICE_D && strcmp(project->midiDeviceDName, "") == 0)
-            ) { 
+            const char *deviceName = config->midiDeviceNames[config->selectedMidiDevice];
+            if (strcmp(deviceName, "") == 0) { 
                 drawText(4, 4, "1:*NONE", WIDTH, COLOR_WHITE);
             } else {
                 drawText(4, 4, "1: NONE", WIDTH, COLOR_WHITE);
@@ -99,16 +147,7 @@ void drawConfigSelection(struct Project *project) {
                     char name[32];
                     memcpy(name, info->name, 32);
                     upperCase(name);
-                    isSelected = false;          
-                    if (selectedMidiDevice == BLIPR_MIDI_DEVICE_A) { 
-                        isSelected =  strcmp(project->midiDeviceAName, info->name) == 0;
-                    } else if (selectedMidiDevice == BLIPR_MIDI_DEVICE_B) { 
-                        isSelected =  strcmp(project->midiDeviceBName, info->name) == 0;
-                    } else if (selectedMidiDevice == BLIPR_MIDI_DEVICE_C) { 
-                        isSelected =  strcmp(project->midiDeviceCName, info->name) == 0;
-                    } else if (selectedMidiDevice == BLIPR_MIDI_DEVICE_D) { 
-                        isSelected =  strcmp(project->midiDeviceDName, info->name) == 0;
-                    }
+                    bool isSelected = strcmp(deviceName, info->name) == 0;
                     int result = snprintf(line, sizeof(line), "%d:%s%s", y + 1, isSelected? "*" : " ", name);
                     if (result < 0 || result >= (int)sizeof(line)) {
                         // Handle error: string was truncated or an error occurred
@@ -166,6 +205,7 @@ void setMidiDeviceName(struct Project *project, int deviceOnProject, int indexIn
 }
 
 void updateConfiguration(struct Project *project, SDL_Scancode key, bool *reloadMidi, bool *quit) {
+    project->isDirty = true;
     if (isMainScreen()) {
         // No config selected, so we're on the main screen
         if (key == BLIPR_KEY_1) { selectedMidiDevice = BLIPR_MIDI_DEVICE_A; isMidiConfigActive = true; } else 
@@ -192,7 +232,11 @@ void updateConfiguration(struct Project *project, SDL_Scancode key, bool *reload
             if (project->midiDevicePcChannelD >= 16) {
                 project->midiDevicePcChannelD = 0;
             }
-        } else if (key == BLIPR_KEY_16) { *quit = (true); }
+        } else if (key == BLIPR_KEY_9) { increaseLatency(&project->midiDeviceLatencyA); *reloadMidi = (true); }
+        else if (key == BLIPR_KEY_10) { increaseLatency(&project->midiDeviceLatencyB); *reloadMidi = (true); }
+        else if (key == BLIPR_KEY_11) { increaseLatency(&project->midiDeviceLatencyC); *reloadMidi = (true); }
+        else if (key == BLIPR_KEY_12) { increaseLatency(&project->midiDeviceLatencyD); *reloadMidi = (true); }
+        else if (key == BLIPR_KEY_16) { *quit = (true); }
     } else {
         if (isMidiConfigActive) {
             // if (key == BLIPR_KEY_A) { selectedMidiDevice = BLIPR_MIDI_DEVICE_A; }
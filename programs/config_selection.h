@@ -4,10 +4,26 @@
 #include <SDL.h>
 #include "../project.h"
 
+/**
+ * The settings the configuration screen draws, copied by the sequencer thread for the renderer
+ */
+struct ConfigScreenState {
+    bool isMidiConfigActive;
+    int selectedMidiDevice;
+    char midiDeviceNames[4][32];
+    unsigned char midiDevicePcChannels[4];
+    unsigned char midiDeviceLatencies[4];
+};
+
+/**
+ * Copy the settings of the project and the state of the configuration screen
+ */
+void getConfigScreenState(const struct Project *project, struct ConfigScreenState *config);
+
 /**
  * Draw the config selection
  */
-void drawConfigSelection(struct Project *project);
+void drawConfigSelection(const struct ConfigScreenState *config);
 
 /**
  * Process a key during configuration mode
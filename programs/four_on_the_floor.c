@@ -3,10 +3,14 @@
 #include <portmidi.h>
 #include "../constants.h"
 #include "../drawing_icons.h"
+#include "../drawing.h"
+#include "../drawing_components.h"
+#include "../colors.h"
 #include "../project.h"
 #include "../midi.h"
 
 static bool isNotePlaying = false;
+static Blipr_Icon drawnFoot = BLIPR_ICON_EMPTY;     // Foot in the render target
 
 /**
  * Run FOTF
@@ -34,9 +38,22 @@ void drawFourOnTheFloor(
     struct Track *track
 ) {
     // Draw foot, stomping on the floor
-    drawIcon(
-        55, 
-        55, 
-        *ppqnCounter % (PPQN_MULTIPLIED) == 0 ? BLIPR_ICON_FOOT_DOWN : BLIPR_ICON_FOOT_UP
-    );
+    drawnFoot = *ppqnCounter % (PPQN_MULTIPLIED) == 0 ? BLIPR_ICON_FOOT_DOWN : BLIPR_ICON_FOOT_UP;
+    drawIcon(55, 55, drawnFoot);
+}
+
+void drawFourOnTheFloorFoot(uint64_t *ppqnCounter) {
+    Blipr_Icon foot = *ppqnCounter % (PPQN_MULTIPLIED) == 0 ? BLIPR_ICON_FOOT_DOWN : BLIPR_ICON_FOOT_UP;
+    if (foot == drawnFoot) {
+        return;
+    }
+
+    // Clear the previous foot, it covers the corners of the 4 center tiles:
+    drawRect(55, 55, ICON_WIDTH, ICON_HEIGHT, COLOR_BLACK);
+    int tiles[4] = {5, 6, 9, 10};
+    for (int i = 0; i < 4; i++) {
+        drawHighlightedGridTileInColor(tiles[i], COLOR_GRAY);
+    }
+    drawIcon(55, 55, foot);
+    drawnFoot = foot;
 }
@@ -35,4 +35,9 @@ void drawFourOnTheFloor(
     struct Track *track
 );
 
+/**
+ * Redraw only the foot of FOTF, if it changed since FOTF was drawn
+ */
+void drawFourOnTheFloorFoot(uint64_t *ppqnCounter);
+
 #endif
\ No newline at end of file
@@ -6,8 +6,18 @@
 #include "../drawing_components.h"
 #include "../drawing_text.h"
 #include "../utils.h"
+#include "pattern_options.h"
 
-void drawPatternOptions(struct Pattern* pattern) {
+void getPatternHeader(const struct Pattern *pattern, struct PatternHeader *header) {
+    header->bpm = pattern->bpm;
+    header->programA = pattern->programA;
+    header->programB = pattern->programB;
+    header->programC = pattern->programC;
+    header->programD = pattern->programD;
+    header->length = pattern->length;
+}
+
+void drawPatternOptions(const struct PatternHeader *pattern) {
     // BPM:
     char bpmText[4];
     sprintf(bpmText, "%d", pattern->bpm + 45);
@@ -36,6 +46,7 @@ void drawPatternOptions(struct Pattern* pattern) {
 }
 
 void updatePatternOptions(struct Pattern* pattern, SDL_Scancode key) {
+    pattern->isDirty = true;
     switch (key) {
         case BLIPR_KEY_1:
             pattern->bpm = MAX(0, pattern->bpm - 1);
@@ -4,7 +4,24 @@
 #include <SDL.h>
 #include "../project.h"
 
-void drawPatternOptions(struct Pattern* pattern);
+/**
+ * The header of a pattern, as drawn by the pattern options
+ */
+struct PatternHeader {
+    unsigned char bpm;
+    unsigned char programA;
+    unsigned char programB;
+    unsigned char programC;
+    unsigned char programD;
+    unsigned char length;
+};
+
+/**
+ * Copy the header of a pattern
+ */
+void getPatternHeader(const struct Pattern *pattern, struct PatternHeader *header);
+
+void drawPatternOptions(const struct PatternHeader *pattern);
 void updatePatternOptions(struct Pattern* pattern, SDL_Scancode key);
 
 #endif
\ No newline at end of file
@@ -6,6 +6,7 @@
 #include "../project.h"
 #include "../constants.h"
 #include "../colors.h"
+#include "sequencer_timeline.h"
 
 /**
  * Draw the program selection
@@ -38,4 +39,6 @@ void updateProgram(struct Track *track, SDL_Scancode key) {
     }
 
     track->program = index;    
+    invalidateTrackTimeline(track);
+    track->isDirty = true;
 }
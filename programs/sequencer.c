@@ -3,6 +3,7 @@
 #include <portmidi.h>
 #include <string.h>
 #include "sequencer.h"
+#include "sequencer_timeline.h"
 #include "../project.h"
 #include "../constants.h"
 #include "../colors.h"
@@ -25,6 +26,8 @@ bool isNoteEditorVisible = false;
 int cutCounter = 0;     // 0=none   1=note  2=step (all notes)
 int copyCounter = 0;
 bool isEditOnAllNotes = false;
+int drawnPlayheadTile = -1;             // Grid tile with the playhead outline in the render target, -1 if none is drawn
+int drawnPlayingPage = -1;              // Playing page in the page indicator of the render target
 // bool isHighPageBankSelected = false;
 
 // Boolean arrays that determine if for a step all note properties are the same:
@@ -99,6 +102,21 @@ void resetSelectedNote() {
     selectedNote = 0;
 }
 
+/**
+ * Copy the editing state of the sequencer screen
+ */
+void getSequencerEditorState(struct SequencerEditorState *editor) {
+    editor->templateNote = templateNote;
+    editor->selectedNote = selectedNote;
+    editor->selectedPageBank = selectedPageBank;
+    memcpy(editor->selectedSteps, selectedSteps, sizeof(editor->selectedSteps));
+    memcpy(editor->areAllStepPropertiesTheSame, areAllStepPropertiesTheSame, sizeof(editor->areAllStepPropertiesTheSame));
+    editor->isNoteEditorVisible = isNoteEditorVisible;
+    editor->isEditOnAllNotes = isEditOnAllNotes;
+    editor->cutCounter = cutCounter;
+    editor->copyCounter = copyCounter;
+}
+
 /**
  * Clear note
  */
@@ -116,7 +134,8 @@ void clearNote(struct Note *note) {
 /**
  * Clear step
  */
-void clearStep(struct Step *step) {
+void clearStep(struct Track *track, int stepIndex) {
+    struct Step *step = &track->steps[stepIndex];
     if (cutCounter == 0) {
         // This is the first cut, clear only the selected note:
         clearNote(&step->notes[selectedNote]);
@@ -126,6 +145,7 @@ void clearStep(struct Step *step) {
             clearNote(&step->notes[i]);
         }
     }
+    updateStepNoteMasks(track, stepIndex);
 }
 
 /**
@@ -145,7 +165,8 @@ void copyNote(const struct Note *src, struct Note *dst) {
 /**
  * Copy step
  */
-void copyStep(const struct Step *src, struct Step *dst) {
+void copyStep(const struct Step *src, struct Track *track, int stepIndex) {
+    struct Step *dst = &track->steps[stepIndex];
     if (copyCounter == 0) {
         // This is the first copy, only copy the selected note:
         copyNote(&src->notes[selectedNote], &dst->notes[selectedNote]);
@@ -155,6 +176,7 @@ void copyStep(const struct Step *src, struct Step *dst) {
             copyNote(&src->notes[i], &dst->notes[i]);
         }
     }
+    updateStepNoteMasks(track, stepIndex);
 }
 
 /**
@@ -174,7 +196,8 @@ void resetTemplateNote() {
 /**
  * Toggle a step
  */
-void toggleStep(struct Step *step, int noteIndex) {
+void toggleStep(struct Track *track, int stepIndex, int noteIndex) {
+    struct Step *step = &track->steps[stepIndex];
     step->notes[noteIndex].enabled = !step->notes[noteIndex].enabled;
     // Set default values:
     if (step->notes[noteIndex].enabled) {
@@ -183,12 +206,14 @@ void toggleStep(struct Step *step, int noteIndex) {
         // Reset enabled state, because template note might be a disabled note :-/
         step->notes[noteIndex].enabled = true;
     }
+    updateStepNoteMasks(track, stepIndex);
 }
 
 /**
  * Toggle a step when in drumkit mode
  */
-void toggleDrumkitStep(struct Step *step, int noteIndex) {
+void toggleDrumkitStep(struct Track *track, int stepIndex, int noteIndex) {
+    struct Step *step = &track->steps[stepIndex];
     if (step->notes[noteIndex].enabled) {
         // Decrease velocity:
         if (step->notes[noteIndex].velocity > 100) {
@@ -207,6 +232,7 @@ void toggleDrumkitStep(struct Step *step, int noteIndex) {
         // Reset enabled state, because template note might be a disabled note :-/
         step->notes[noteIndex].enabled = true;
     }
+    updateStepNoteMasks(track, stepIndex);
 }
 
 /**
@@ -500,6 +526,10 @@ void updateSequencer(
     SDL_Scancode key,
     bool isDrumkitSequencer
 ) {
+    // Any key might edit notes, so the timeline needs to be recompiled and the track saved:
+    invalidateTrackTimeline(track);
+    track->isDirty = true;
+
     int index = scancodeToStep(key);
     if (keyStates[BLIPR_KEY_SHIFT_1]) {
         // Shift 1 = utils:
@@ -531,7 +561,7 @@ void updateSequencer(
                         // Cut all steps:
                         for (int i=0; i<16; i++) {
                             if (selectedSteps[i]) {
-                                clearStep(&track->steps[i + (track->selectedPage * 16)]);
+                                clearStep(track, i + (track->selectedPage * 16));
                             }
                         }
                         cutCounter ++;
@@ -575,7 +605,8 @@ void updateSequencer(
                             if (clipBoard[i] != NULL) {
                                 copyStep(
                                     clipBoard[i],
-                                    &track->steps[pastePosition + (track->selectedPage * 16) + i - offset]
+                                    track,
+                                    (pastePosition + (track->selectedPage * 16) + i - offset) % 64
                                 );
                                 printLog("copied step %d from clipboard to position %d", i,pastePosition + (track->selectedPage * 16));
                             } else {
@@ -650,9 +681,9 @@ void updateSequencer(
             int stepIndex = (index + (track->selectedPage * 16)) % 64;
             printLog("setting note %d on step %d", (track->playingPageBank * polyCount) + selectedNote, stepIndex);
             if (!isDrumkitSequencer) {
-                toggleStep(&track->steps[stepIndex], (track->playingPageBank * polyCount) + selectedNote);
+                toggleStep(track, stepIndex, (track->playingPageBank * polyCount) + selectedNote);
             } else {
-                toggleDrumkitStep(&track->steps[stepIndex], (track->playingPageBank * polyCount) + selectedNote);
+                toggleDrumkitStep(track, stepIndex, (track->playingPageBank * polyCount) + selectedNote);
             }
         }
     }
@@ -687,155 +718,156 @@ void checkSequencerForKeyRepeats(
 }
 */
 
+// Inputs of a trig condition:
+#define TRIG_INPUT_REPEAT 0     // The repeat count of the track
+#define TRIG_INPUT_FIRST 1      // 0 the first time the note is played, 1 after that
+#define TRIG_INPUT_RANDOM 2     // A random number from the generator of the track
+#define TRIG_INPUT_TRANSITION 3 // 1 when the bit of the condition is set in the transition mask
+
 /**
- * Check if the note is triggered according to the trigg condition
- * @param triggValue    The Trigg value
- * @param repeatCount   How many times this note has already been played (determined by tracklength or page size)
+ * A trig condition in lookup form: the condition passes when its input modulo the modulus equals the residue
  */
-bool isNoteTrigged(int triggValue, int repeatCount) {
-    bool isEnabled = triggValue > 0; // get2FByteFlag1(triggValue);
-    if (!isEnabled) {
-        // If a trig condition is not enabled it will always pass:
-        return true;
+struct TrigCondition {
+    uint8_t input;
+    uint8_t modulus;
+    uint8_t residue;
+};
+
+#define TRIG_CONDITION_ALWAYS {TRIG_INPUT_REPEAT, 1, 0}
+#define TRIG_CONDITION_TRANSITION {TRIG_INPUT_TRANSITION, 2, 1}
+
+// Trig conditions by their value (the lower 6 bits of the trigg byte).
+// Values without a condition always pass:
+static const struct TrigCondition trigConditions[64] = {
+    [TRIG_DISABLED] = TRIG_CONDITION_ALWAYS,
+    [TRIG_1_2] = {TRIG_INPUT_REPEAT, 2, 0},
+    [TRIG_1_3] = {TRIG_INPUT_REPEAT, 3, 0},
+    [TRIG_2_3] = {TRIG_INPUT_REPEAT, 3, 1},
+    [TRIG_3_3] = {TRIG_INPUT_REPEAT, 3, 2},
+    [TRIG_1_4] = {TRIG_INPUT_REPEAT, 4, 0},
+    [TRIG_2_4] = {TRIG_INPUT_REPEAT, 4, 1},
+    [TRIG_3_4] = {TRIG_INPUT_REPEAT, 4, 2},
+    [TRIG_4_4] = {TRIG_INPUT_REPEAT, 4, 3},
+    [TRIG_1_5] = {TRIG_INPUT_REPEAT, 5, 0},
+    [TRIG_2_5] = {TRIG_INPUT_REPEAT, 5, 1},
+    [TRIG_3_5] = {TRIG_INPUT_REPEAT, 5, 2},
+    [TRIG_4_5] = {TRIG_INPUT_REPEAT, 5, 3},
+    [TRIG_5_5] = {TRIG_INPUT_REPEAT, 5, 4},
+    [TRIG_1_6] = {TRIG_INPUT_REPEAT, 6, 0},
+    [TRIG_2_6] = {TRIG_INPUT_REPEAT, 6, 1},
+    [TRIG_3_6] = {TRIG_INPUT_REPEAT, 6, 2},
+    [TRIG_4_6] = {TRIG_INPUT_REPEAT, 6, 3},
+    [TRIG_5_6] = {TRIG_INPUT_REPEAT, 6, 4},
+    [TRIG_6_6] = {TRIG_INPUT_REPEAT, 6, 5},
+    [TRIG_1_7] = {TRIG_INPUT_REPEAT, 7, 0},
+    [TRIG_2_7] = {TRIG_INPUT_REPEAT, 7, 1},
+    [TRIG_3_7] = {TRIG_INPUT_REPEAT, 7, 2},
+    [TRIG_4_7] = {TRIG_INPUT_REPEAT, 7, 3},
+    [TRIG_5_7] = {TRIG_INPUT_REPEAT, 7, 4},
+    [TRIG_6_7] = {TRIG_INPUT_REPEAT, 7, 5},
+    [TRIG_7_7] = {TRIG_INPUT_REPEAT, 7, 6},
+    [TRIG_1_8] = {TRIG_INPUT_REPEAT, 8, 0},
+    [TRIG_2_8] = {TRIG_INPUT_REPEAT, 8, 1},
+    [TRIG_3_8] = {TRIG_INPUT_REPEAT, 8, 2},
+    [TRIG_4_8] = {TRIG_INPUT_REPEAT, 8, 3},
+    [TRIG_5_8] = {TRIG_INPUT_REPEAT, 8, 4},
+    [TRIG_6_8] = {TRIG_INPUT_REPEAT, 8, 5},
+    [TRIG_7_8] = {TRIG_INPUT_REPEAT, 8, 6},
+    [TRIG_8_8] = {TRIG_INPUT_REPEAT, 8, 7},
+    [TRIG_1_PERCENT] = {TRIG_INPUT_RANDOM, 100, 0},
+    [TRIG_2_PERCENT] = {TRIG_INPUT_RANDOM, 50, 0},
+    [TRIG_5_PERCENT] = {TRIG_INPUT_RANDOM, 20, 0},
+    [TRIG_10_PERCENT] = {TRIG_INPUT_RANDOM, 10, 0},
+    [TRIG_25_PERCENT] = {TRIG_INPUT_RANDOM, 4, 0},
+    [TRIG_33_PERCENT] = {TRIG_INPUT_RANDOM, 3, 0},
+    [TRIG_50_PERCENT] = {TRIG_INPUT_RANDOM, 2, 0},
+    [TRIG_FILL] = TRIG_CONDITION_TRANSITION,
+    [TRIG_FIRST] = {TRIG_INPUT_FIRST, 2, 0},
+    [TRIG_TRANSITION] = TRIG_CONDITION_TRANSITION,
+    [TRIG_FIRST_PAGE] = TRIG_CONDITION_TRANSITION,
+    [TRIG_TRANSITION_PAGE] = TRIG_CONDITION_TRANSITION,
+    [TRIG_HIGHER_FIRST] = TRIG_CONDITION_TRANSITION,
+    [TRIG_HIGHER_TRANSITION] = TRIG_CONDITION_TRANSITION,
+    [TRIG_HIGHER_FIRST_PAGE] = TRIG_CONDITION_TRANSITION,
+    [TRIG_HIGHER_TRANSITION_PAGE] = TRIG_CONDITION_TRANSITION,
+    [TRIG_LOWER_FIRST] = TRIG_CONDITION_TRANSITION,
+    [TRIG_LOWER_TRANSITION] = TRIG_CONDITION_TRANSITION,
+    [TRIG_LOWER_FIRST_PAGE] = TRIG_CONDITION_TRANSITION,
+    [TRIG_LOWER_TRANSITION_PAGE] = TRIG_CONDITION_TRANSITION,
+    [TRIG_FIRST_PAGE_PLAY] = TRIG_CONDITION_TRANSITION,
+    [TRIG_FIRST_PATTERN_PLAY] = TRIG_CONDITION_TRANSITION,
+    [TRIG_TRANSITION_LAST_PAGE] = TRIG_CONDITION_TRANSITION,
+    [58] = TRIG_CONDITION_ALWAYS,
+    [59] = TRIG_CONDITION_ALWAYS,
+    [60] = TRIG_CONDITION_ALWAYS,
+    [61] = TRIG_CONDITION_ALWAYS,
+    [62] = TRIG_CONDITION_ALWAYS,
+    [63] = TRIG_CONDITION_ALWAYS,
+};
+
+// Transition trig conditions of the pattern, set once per pulse:
+static uint64_t patternTrigMask = 0;
+
+/**
+ * Set the transition state for the trig conditions of the notes in this pulse
+ */
+void setTransitionContext(const struct TransitionContext *context) {
+    bool isFirstLoop = context->patternLoopCount == 0;
+    uint64_t mask = 0;
+    mask |= (uint64_t)context->isFillActive << TRIG_FILL;
+    mask |= (uint64_t)(context->queuedPattern != context->currentPattern) << TRIG_TRANSITION;
+    mask |= (uint64_t)(context->queuedPattern > context->currentPattern) << TRIG_HIGHER_TRANSITION;
+    mask |= (uint64_t)(context->queuedPattern < context->currentPattern) << TRIG_LOWER_TRANSITION;
+    mask |= (uint64_t)(isFirstLoop && context->previousPattern < context->currentPattern) << TRIG_HIGHER_FIRST;
+    mask |= (uint64_t)(isFirstLoop && context->previousPattern > context->currentPattern) << TRIG_LOWER_FIRST;
+    mask |= (uint64_t)(isFirstLoop && (context->playedPatterns & (1 << context->currentPattern)) == 0) << TRIG_FIRST_PATTERN_PLAY;
+    patternTrigMask = mask;
+}
+
+/**
+ * Get the transition trig conditions that pass for a track: those of the pattern, and those of its pages
+ */
+uint64_t getTransitionTrigMask(const struct Track *track) {
+    if (track->pagePlayMode != PAGE_PLAY_MODE_REPEAT) {
+        // Continuous tracks do not switch pages:
+        return patternTrigMask;
     }
 
-    bool isTrigged = true;
-    bool isInversed = get2FByteFlag2(triggValue);
-    int value = get2FByteValue(triggValue);
-    
-    switch (value) {
-        case TRIG_DISABLED:
-            isTrigged = true;
-            break;
-        case TRIG_1_2:
-            isTrigged = repeatCount % 2 == 0;
-            break;
-        case TRIG_1_3:
-            isTrigged = repeatCount % 3 == 0;
-            break;
-        case TRIG_2_3:
-            isTrigged = repeatCount % 3 == 1;
-            break;
-        case TRIG_3_3:
-            isTrigged = repeatCount % 3 == 2;
-            break;
-        case TRIG_1_4:
-            isTrigged = repeatCount % 4 == 0;
-            break;
-        case TRIG_2_4:
-            isTrigged = repeatCount % 4 == 1;
-            break;
-        case TRIG_3_4:
-            isTrigged = repeatCount % 4 == 2;
-            break;
-        case TRIG_4_4:
-            isTrigged = repeatCount % 4 == 3;
-            break;
-        case TRIG_1_5:
-            isTrigged = repeatCount % 5 == 0;
-            break;
-        case TRIG_2_5:
-            isTrigged = repeatCount % 5 == 1;
-            break;
-        case TRIG_3_5:
-            isTrigged = repeatCount % 5 == 2;
-            break;
-        case TRIG_4_5:
-            isTrigged = repeatCount % 5 == 3;
-            break;
-        case TRIG_5_5:
-            isTrigged = repeatCount % 5 == 4;
-            break;
-        case TRIG_1_6:
-            isTrigged = repeatCount % 6 == 0;
-            break;
-        case TRIG_2_6:
-            isTrigged = repeatCount % 6 == 1;
-            break;
-        case TRIG_3_6:
-            isTrigged = repeatCount % 6 == 2;
-            break;
-        case TRIG_4_6:
-            isTrigged = repeatCount % 6 == 3;
-            break;
-        case TRIG_5_6:
-            isTrigged = repeatCount % 6 == 4;
-            break;
-        case TRIG_6_6:
-            isTrigged = repeatCount % 6 == 5;
-            break;
-        case TRIG_1_7:
-            isTrigged = repeatCount % 7 == 0;
-            break;
-        case TRIG_2_7:
-            isTrigged = repeatCount % 7 == 1;
-            break;
-        case TRIG_3_7:
-            isTrigged = repeatCount % 7 == 2;
-            break;
-        case TRIG_4_7:
-            isTrigged = repeatCount % 7 == 3;
-            break;
-        case TRIG_5_7:
-            isTrigged = repeatCount % 7 == 4;
-            break;
-        case TRIG_6_7:
-            isTrigged = repeatCount % 7 == 5;
-            break;
-        case TRIG_7_7:
-            isTrigged = repeatCount % 7 == 6;
-            break;
-        case TRIG_1_8:
-            isTrigged = repeatCount % 8 == 0;
-            break;
-        case TRIG_2_8:
-            isTrigged = repeatCount % 8 == 1;
-            break;
-        case TRIG_3_8:
-            isTrigged = repeatCount % 8 == 2;
-            break;
-        case TRIG_4_8:
-            isTrigged = repeatCount % 8 == 3;
-            break;
-        case TRIG_5_8:
-            isTrigged = repeatCount % 8 == 4;
-            break;
-        case TRIG_6_8:
-            isTrigged = repeatCount % 8 == 5;
-            break;
-        case TRIG_7_8:
-            isTrigged = repeatCount % 8 == 6;
-            break;
-        case TRIG_8_8:
-            isTrigged = repeatCount % 8 == 7;
-            break;
-        case TRIG_1_PERCENT:
-            isTrigged = rand() % 100 == 0;
-            break;
-        case TRIG_2_PERCENT:
-            isTrigged = rand() % 50 == 0;
-            break;
-        case TRIG_5_PERCENT:
-            isTrigged = rand() % 20 == 0;
-            break;
-        case TRIG_10_PERCENT:
-            isTrigged = rand() % 10 == 0;
-            break;
-        case TRIG_25_PERCENT:
-            isTrigged = rand() % 4 == 0;
-            break;
-        case TRIG_33_PERCENT:
-            isTrigged = rand() % 3 == 0;
-            break;
-        case TRIG_50_PERCENT:
-            isTrigged = rand() % 2 == 0;
-            break;
-        case TRIG_FIRST:
-            isTrigged = repeatCount == 0;
-            break;
+    bool isFirstLoop = track->repeatCount == 0;
+    bool isTransition = track->queuedPage != track->selectedPage;
+    uint64_t mask = patternTrigMask;
+    mask |= (uint64_t)isFirstLoop << TRIG_FIRST_PAGE;
+    mask |= (uint64_t)isTransition << TRIG_TRANSITION_PAGE;
+    mask |= (uint64_t)(track->queuedPage > track->selectedPage) << TRIG_HIGHER_TRANSITION_PAGE;
+    mask |= (uint64_t)(track->queuedPage < track->selectedPage) << TRIG_LOWER_TRANSITION_PAGE;
+    mask |= (uint64_t)(isFirstLoop && track->previousPage < track->selectedPage) << TRIG_HIGHER_FIRST_PAGE;
+    mask |= (uint64_t)(isFirstLoop && track->previousPage > track->selectedPage) << TRIG_LOWER_FIRST_PAGE;
+    mask |= (uint64_t)(isFirstLoop && (track->playedPages & (1 << track->selectedPage)) == 0) << TRIG_FIRST_PAGE_PLAY;
+    // The last repeat before the page switches (see isFirstPulseCallback()):
+    mask |= (uint64_t)(isTransition && (track->repeatCount + 1) % (track->transitionRepeats + 1) == 0) << TRIG_TRANSITION_LAST_PAGE;
+    return mask;
+}
+
+/**
+ * Check if the note is triggered according to the trigg condition
+ * @param triggValue        The Trigg value
+ * @param repeatCount       How many times this note has already been played (determined by tracklength or page size)
+ * @param randomState       State of the random generator of the track, NULL counts as a pass for the probability trigs
+ * @param transitionMask    The transition trig conditions that pass for the track (see getTransitionTrigMask())
+ */
+bool isNoteTrigged(int triggValue, int repeatCount, uint32_t *randomState, uint64_t transitionMask) {
+    // The value and inversed flag of the trigg byte (see get2FByteValue() and get2FByteFlag2()).
+    // A trigg value of 0 is a disabled trig condition, this is the first entry of the table and will always pass:
+    int value = (triggValue >> 2) & 0x3F;
+    bool isInversed = (triggValue & 0x02) != 0;
+    const struct TrigCondition *condition = &trigConditions[value];
+    uint32_t inputs[4] = {repeatCount, repeatCount != 0, 0, (transitionMask >> value) & 1};
+    if (condition->input == TRIG_INPUT_RANDOM && randomState != NULL) {
+        inputs[TRIG_INPUT_RANDOM] = getNextRandom(randomState);
     }
+    bool isTrigged = inputs[condition->input] % condition->modulus == condition->residue;
 
-    return isInversed ? !isTrigged : isTrigged;
+    return isTrigged != isInversed;
 }
 
 /**
@@ -1022,6 +1054,9 @@ void setTriggText(int triggValue, char *text) {
         case TRIG_FIRST_PATTERN_PLAY:
             sprintf(text, "%s1ST.PT", isInversed? "!" : "");
             break;
+        case TRIG_TRANSITION_LAST_PAGE:
+            sprintf(text, "%sTRN.LR", isInversed? "!" : "");
+            break;
         default:
             strcpy(text, "---");
             break;
@@ -1098,14 +1133,15 @@ void getNotesAtTrackStepIndex(int trackStepIndex, const struct Track *track, str
  */
 bool isNotePlayed(
     const struct Note *note,
-    const struct Track *track,
-    int nudgeCheck
+    struct Track *track,
+    int nudgeCheck,
+    uint64_t transitionMask
 ) {
     return 
         note != NULL &&
         note->enabled && 
         (note->nudge - PP16N) == nudgeCheck && 
-        isNoteTrigged(note->trigg, track->repeatCount);
+        isNoteTrigged(note->trigg, track->repeatCount, &track->randomState, transitionMask);
 }
 
 /**
@@ -1113,13 +1149,22 @@ bool isNotePlayed(
  */
 void processPulse(
     const uint64_t *currentPulse,
-    const struct Track *track,
+    struct Track *track,
     void (*isFirstPulseCallback)(void),
     void (*playNoteCallback)(const struct Note *note)
 ) {
     // Get the index for the current step
     int trackStepIndex = getTrackStepIndex(currentPulse, track, isFirstPulseCallback);
 
+    // Steps without enabled notes can be skipped without looking at their notes:
+    uint64_t stepMask = getPlayingStepMask(track);
+    if (stepMask == 0) {
+        return;
+    }
+
+    // The transition trigs are the same for all notes in this pulse:
+    uint64_t transitionMask = getTransitionTrigMask(track);
+
     // Get the nudge value that needs to be applied:
     int nudgeCheck = *currentPulse % PP16N;
 
@@ -1128,19 +1173,21 @@ void processPulse(
         nudgeCheck -= (track->shuffle - PP16N);
     }
 
-    // Get all notes that are in this step
     int polyCount = getPolyCount(track);
-    struct Note *notes[polyCount];
-    getNotesAtTrackStepIndex(trackStepIndex, track, notes);
+    if (stepMask & (1ULL << (trackStepIndex % 64))) {
+        // Get all notes that are in this step
+        struct Note *notes[polyCount];
+        getNotesAtTrackStepIndex(trackStepIndex, track, notes);
 
-    // Iterate over all notes in this step:
-    for (int i=0; i < polyCount; i++) {
-        // Get the note:
-        struct Note *note = notes[i];
+        // Iterate over all notes in this step:
+        for (int i=0; i < polyCount; i++) {
+            // Get the note:
+            struct Note *note = notes[i];
 
-        // If it's not null and matches the note boundaries it's viable for playing:
-        if (isNotePlayed(note, track, nudgeCheck)) {
-            playNoteCallback(note);
+            // If it's not null and matches the note boundaries it's viable for playing:
+            if (isNotePlayed(note, track, nudgeCheck, transitionMask)) {
+                playNoteCallback(note);
+            }
         }
     }
 
@@ -1150,6 +1197,9 @@ void processPulse(
     if (nextNudgeCheck != PP16N * -1) {
         uint64_t nextStepPulse = *currentPulse + PP16N;
         int nextTrackStepIndex = getTrackStepIndex(&nextStepPulse, track, NULL);
+        if ((stepMask & (1ULL << (nextTrackStepIndex % 64))) == 0) {
+            return;
+        }
 
         // Check for shuffle:
         if (nextTrackStepIndex % 2 == 1) {
@@ -1162,7 +1212,7 @@ void processPulse(
             // Get the note:
             struct Note *note = nextStepNotes[i];
 
-            if (isNotePlayed(note, track, nextNudgeCheck)) {
+            if (isNotePlayed(note, track, nextNudgeCheck, transitionMask)) {
                 playNoteCallback(note);
             }
         }
@@ -1178,11 +1228,13 @@ static struct Track *tmpTrack;
  * Note that this is AFTER the note has already played
  */
 void isFirstPulseCallback() {
-    tmpTrack->isFirstPulse = true;
     if (tmpTrack->pagePlayMode == PAGE_PLAY_MODE_CONTINUOUS) {
         tmpTrack->repeatCount += 1;
     } else {
         if (tmpTrack->selectedPage != tmpTrack->queuedPage && (tmpTrack->repeatCount + 1) % (tmpTrack->transitionRepeats + 1) == 0) {
+            // Remember the page we came from, for the page transition trigs:
+            tmpTrack->playedPages |= 1 << tmpTrack->selectedPage;
+            tmpTrack->previousPage = tmpTrack->selectedPage;
             tmpTrack->playingPageBank = selectedPageBank;
             tmpTrack->selectedPage = tmpTrack->queuedPage;
             // Reset repeat count, since we're switching pages:
@@ -1193,6 +1245,17 @@ void isFirstPulseCallback() {
     }
 }
 
+int getNoteLengthInPulses(const struct Track *track, const struct Note *note) {
+    // The length is in steps, a length of 0 is the shortest possible note:
+    int pulses = note->length * PP16N;
+    if (track->speed > TRACK_SPEED_NORMAL) {
+        pulses >>= track->speed - TRACK_SPEED_NORMAL;
+    } else if (track->speed < TRACK_SPEED_NORMAL) {
+        pulses <<= TRACK_SPEED_NORMAL - track->speed;
+    }
+    return MAX(1, pulses);
+}
+
 /**
  * Callback when a note is played
  */
@@ -1206,7 +1269,7 @@ void playNoteCallback(const struct Note *note) {
     }
 
     sendMidiNoteOn(tmpStream, tmpTrack->midiChannel, note->note, note->velocity);
-    addNoteToTracker(tmpStream, tmpTrack->midiChannel, note);
+    addNoteToTracker(tmpStream, tmpTrack->midiChannel, note, getNoteLengthInPulses(tmpTrack, note));
 }
 
 /**
@@ -1214,10 +1277,10 @@ void playNoteCallback(const struct Note *note) {
  * returns FALSE if further processing is not required
  */
 bool applySpeedToPulse(
-    const struct Track *track,
+    unsigned char speed,
     uint64_t *pulse
 ) {
-    switch (track->speed) {
+    switch (speed) {
         case TRACK_SPEED_DIV_TWO:
             // Only process when modulo is 0 (to prevent doubles)
             if (*pulse % 2 != 0) {
@@ -1256,6 +1319,21 @@ bool applySpeedToPulse(
     return true;
 }
 
+/**
+ * Get the number of track pulses in a single clock pulse
+ */
+static int getSubPulseCount(unsigned char speed) {
+    switch (speed) {
+        case TRACK_SPEED_TIMES_TWO:
+            return 2;
+        case TRACK_SPEED_TIMES_FOUR:
+            return 4;
+        case TRACK_SPEED_TIMES_EIGHT:
+            return 8;
+    }
+    return 1;
+}
+
 /**
  * Run the sequencer
  * @todo refactor this so it can be testable
@@ -1266,19 +1344,34 @@ void runSequencer(
     struct Track *selectedTrack
 ) {
     // Reset global properties:
-    selectedTrack->isFirstPulse = false;
     tmpStream = outputStream;
     tmpTrack = selectedTrack;
 
+    // The settings are read from the playback state, the track itself is only touched when a note is played:
+    struct TrackTimeline *timeline = getTrackTimeline(selectedTrack);
+    timeline->isFirstPulse = false;
+
     // Check track speed (we do this by manupulating the pulse):
     uint64_t pulse = *ppqnCounter;
-    bool process = applySpeedToPulse(selectedTrack, &pulse);
+    bool process = applySpeedToPulse(timeline->speed, &pulse);
     if (!process) {
         return;
     }
 
-    // Process pulse
-    processPulse(&pulse, selectedTrack, isFirstPulseCallback, playNoteCallback);
+    // Tracks that run faster than the clock have multiple pulses per clock pulse.
+    // These are all processed, and timestamped in between so they are heard at the right moment:
+    int subPulses = getSubPulseCount(timeline->speed);
+    for (int i = 0; i < subPulses; i++) {
+        uint64_t subPulse = pulse + i;
+        if (subPulses > 1) {
+            setMidiSubPulse(i, subPulses);
+        }
+        // Process pulse, using the compiled timeline:
+        processTimelinePulse(&subPulse, selectedTrack, isFirstPulseCallback, playNoteCallback);
+    }
+    if (subPulses > 1) {
+        setMidiSubPulse(0, 1);
+    }
 }
 
 /**
@@ -1302,44 +1395,233 @@ void drawPageIndicator(const struct Track *track, int playingPage)
 /**
  * Draw the template note
  */
-void drawTemplateNote() {
+void drawTemplateNote(const struct Note *templateNote) {
     // drawRect(SIDEBAR_OFFSET + 1, 27, SIDEBAR_WIDTH - 2, (CHAR_HEIGHT * 8) + 8, COLOR_BLACK);
     drawRect(SIDEBAR_OFFSET + 1, 27, SIDEBAR_WIDTH - 2, CHAR_HEIGHT + 2, COLOR_BLACK);
     drawText(SIDEBAR_OFFSET + 1, 28, "TEMPLATE", 20, COLOR_ORANGE);
     char text[8];
     drawSidebarTemplate(34, "NOT");
-    char *midiNote = getMidiNoteName(templateNote.note);
+    char *midiNote = getMidiNoteName(templateNote->note);
     drawText(SIDEBAR_OFFSET + 24, 35, midiNote, 20, COLOR_ORANGE);
     drawSidebarTemplate(40, "VEL");
-    sprintf(text, "%d", templateNote.velocity);
+    sprintf(text, "%d", templateNote->velocity);
     drawText(SIDEBAR_OFFSET + 24, 41, text, 18, COLOR_ORANGE);
     drawSidebarTemplate(46, "LEN");
-    sprintf(text, "%d", templateNote.length);
+    sprintf(text, "%d", templateNote->length);
     drawText(SIDEBAR_OFFSET + 24, 47, text, 18, COLOR_ORANGE);
     drawSidebarTemplate(52, "NDG");
-    sprintf(text, "%d", templateNote.nudge - PP16N);
+    sprintf(text, "%d", templateNote->nudge - PP16N);
     drawText(SIDEBAR_OFFSET + 24, 53, text, 18, COLOR_ORANGE);
     drawSidebarTemplate(58, "TRG");
-    setTriggText(templateNote.trigg, text);
+    setTriggText(templateNote->trigg, text);
     drawText(SIDEBAR_OFFSET + 24, 59, text, 18, COLOR_ORANGE);
     drawSidebarTemplate(64, "CC1");
-    sprintf(text, "%d", templateNote.cc1Value);
+    sprintf(text, "%d", templateNote->cc1Value);
     drawText(SIDEBAR_OFFSET + 24, 65, text, 18, COLOR_ORANGE);
     drawSidebarTemplate(70, "CC2");
-    sprintf(text, "%d", templateNote.cc2Value);
+    sprintf(text, "%d", templateNote->cc2Value);
     drawText(SIDEBAR_OFFSET + 24, 71, text, 18, COLOR_ORANGE);
 }
 
+/**
+ * Draw the step on a tile of the 16-pad (zero-based index)
+ */
+static void drawSequencerStepTile(
+    const struct Track *selectedTrack,
+    const struct SequencerEditorState *editor,
+    int tileIndex,
+    int polyCount,
+    uint64_t transitionMask,
+    bool isDrumkitSequencer
+) {
+    int width = HEIGHT / 6;
+    int height = width;
+    int i = tileIndex % 4;
+    int j = tileIndex / 4;
+    int noteIndicatorOffset = 12 - polyCount;
+
+    int stepIndex = ((i + (j * 4)) + (selectedTrack->selectedPage * 16)) % 64;
+
+    const struct Step *step = &selectedTrack->steps[stepIndex];
+    // Check if this is within the track length, or outside the page length:
+    if (
+        ((selectedTrack->pagePlayMode == PAGE_PLAY_MODE_CONTINUOUS) && (selectedTrack->selectedPage * 16) + i + (j * 4) > selectedTrack->trackLength) ||
+        ((selectedTrack->pagePlayMode == PAGE_PLAY_MODE_REPEAT) && (i + (j * 4)) > selectedTrack->pageLength)
+    ) {
+        // No note here
+        drawRect(
+            4 + i + (i * width),
+            4 + j + (j * height),
+            width - 4,
+            height - 4,
+            COLOR_GRAY
+        );
+    } else {
+        int noteIndex = (selectedTrack->playingPageBank * polyCount) + editor->selectedNote;
+
+        if (selectedTrack->noteMasks[noteIndex] & (1ULL << stepIndex)) {
+            const struct Note *note = &step->notes[noteIndex];
+            SDL_Color noteColor = note->velocity >= 100 ? COLOR_RED : 
+                (note->velocity >= 50 ? COLOR_DARK_RED : COLOR_LIGHT_GRAY);
+            if (isNoteTrigged(note->trigg, selectedTrack->repeatCount, NULL, transitionMask)) {
+                drawRect(
+                    4 + i + (i * width),
+                    4 + j + (j * height),
+                    width - 4,
+                    height - 4,
+                    noteColor
+                );
+                // Check if this note has a trigg condition
+                if (note->trigg > 0) {
+                    drawSingleLineRectOutline(
+                        4 + i + (i * width),
+                        4 + j + (j * height),
+                        width - 4,
+                        height - 4,
+                        mixColors(COLOR_RED, COLOR_WHITE, 0.5f)
+                    );    
+                }                      
+                if (!isDrumkitSequencer) {  
+                    drawTextOnButton((i + (j * 4)), getMidiNoteName(note->note));
+                } else {
+                    // If this note is not equal to the template note, it means that it is a different drumkit
+                    // Instrument. So we need to make that visually clear:
+                    if (note->note != editor->templateNote.note) {
+                        drawDimmedOverlay(
+                            4 + i + (i * width),
+                            4 + j + (j * height),
+                            width - 4,
+                            height - 4
+                        );
+                    }
+                }
+            } else {
+                // Here is a note, but it is not trigged by the fill condition:
+                drawSingleLineRectOutline(
+                    4 + i + (i * width),
+                    4 + j + (j * height),
+                    width - 4,
+                    height - 4,
+                    noteColor
+                );
+            }
+
+            // Draw nudge box:
+            if (note->nudge < PP16N) {
+                drawRect(
+                    2 + i + (i * width),
+                    2 + j + (j * height) + (BUTTON_HEIGHT * 0.4),
+                    2,
+                    5,
+                    noteColor
+                );
+            } else if (note->nudge > PP16N) {
+                drawRect(
+                    i + (i * width) + BUTTON_WIDTH,
+                    2 + j + (j * height) + (BUTTON_HEIGHT * 0.4),
+                    2,
+                    5,
+                    noteColor
+                );
+            }
+        }
+    }
+
+    // Draw selection outline:
+    if (editor->selectedSteps[i + (j * 4)]) {
+        drawSingleLineRectOutline(
+            4 + i + (i * width),
+            4 + j + (j * height),
+            width - 4,
+            height - 4,
+            COLOR_YELLOW
+        );
+    }
+    
+    // Poly count dots:
+    if (!isDrumkitSequencer) {
+        drawRect(
+            5 + i + (i * width) + noteIndicatorOffset,
+            5 + j + (j * height),
+            (polyCount * 2) + 1,
+            3,
+            COLOR_GRAY
+        );
+
+        int baseNoteIndex = (selectedTrack->playingPageBank * polyCount);
+        for (int p=0; p<polyCount; p++) {
+            drawPixel(
+                6 + i + (i * width) + (p * 2) + noteIndicatorOffset,
+                6 + j + (j * height),
+                p == editor->selectedNote ? COLOR_WHITE : ((selectedTrack->noteMasks[baseNoteIndex + p] & (1ULL << stepIndex)) ? COLOR_RED : COLOR_LIGHT_GRAY)
+            );
+        }
+    }
+}
+
+/**
+ * Get the tile of the 16-pad on which the playhead is drawn, -1 if it is not on the selected page
+ */
+static int getPlayheadTile(const uint64_t *ppqnCounter, const struct Track *selectedTrack, int *playingPage) {
+    // Check track speed (we do this by manupulating the pulse):
+    uint64_t pulse = *ppqnCounter;
+    applySpeedToPulse(selectedTrack->speed, &pulse);
+    int trackStepIndex = getTrackStepIndex(&pulse, selectedTrack, NULL);
+
+    // Get playing page:
+    if (selectedTrack->pagePlayMode == PAGE_PLAY_MODE_CONTINUOUS) {
+        *playingPage = trackStepIndex / 16;
+    } else {
+        *playingPage = selectedTrack->selectedPage;
+    }
+
+    if (*playingPage != selectedTrack->selectedPage) {
+        return -1;
+    }
+
+    return trackStepIndex % 16;
+}
+
+/**
+ * Draw the line below the 16-pad, with the playing page or the cut & copy information
+ */
+static void drawSequencerStatusLine(
+    const struct Track *selectedTrack,
+    const struct SequencerEditorState *editor,
+    int playingPage,
+    unsigned char heldModifiers
+) {
+    if (editor->cutCounter > 0 || editor->copyCounter > 0) {
+        char *bottomText[64];
+        if (editor->cutCounter == 1) {
+            sprintf(bottomText, "CUTTED 1 NOTE");
+        } else if (editor->cutCounter > 1) {
+            sprintf(bottomText, "CUTTED ALL NOTES");
+        }
+
+        if (editor->copyCounter == 1) {
+            sprintf(bottomText, "PASTED 1 NOTE");
+        } else if (editor->copyCounter > 1) {
+            sprintf(bottomText, "PASTED ALL NOTES");
+        }
+        drawCenteredLine(2, HEIGHT - BUTTON_HEIGHT - 12, bottomText, BUTTON_WIDTH * 4, COLOR_YELLOW);
+    } else if (!(heldModifiers & BLIPR_MODIFIER_SHIFT_2)) {
+        drawPageIndicator(selectedTrack, playingPage);
+    }
+}
+
 /**
  * Draw the sequencer
  */
 void drawSequencerMain(
     uint64_t *ppqnCounter, 
-    bool keyStates[SDL_NUM_SCANCODES],
-    struct Track *selectedTrack,
+    unsigned char heldModifiers,
+    const struct Track *selectedTrack,
+    const struct SequencerEditorState *editor,
+    uint64_t transitionMask,
     bool isDrumkitSequencer
 ) {
-    if (keyStates[BLIPR_KEY_SHIFT_2] && isDrumkitSequencer) {
+    if ((heldModifiers & BLIPR_MODIFIER_SHIFT_2) && isDrumkitSequencer) {
         // Draw drumkit instrument selector:
         drawIconOnIndex(0, BLIPR_ICON_KICK);
         // Snare
@@ -1360,201 +1642,37 @@ void drawSequencerMain(
         // Extra 1
         // Extra 2
         // Extra 3
+        drawnPlayheadTile = -1;
+        drawnPlayingPage = -1;
     } else {
-        // Draw currently playing steps:
-
-        // Outline currently active step:
-        int width = HEIGHT / 6;
-        int height = width;
-
-        // Step indicator:
+        // Outline currently playing step:
         int playingPage = 0;
-
-        // Check track speed (we do this by manupulating the pulse):
-        uint64_t pulse = *ppqnCounter;
-        applySpeedToPulse(selectedTrack, &pulse);
-        int trackStepIndex = getTrackStepIndex(&pulse, selectedTrack, NULL);
-
-        // Get playing page:
-        if (selectedTrack->pagePlayMode == PAGE_PLAY_MODE_CONTINUOUS) {
-            playingPage = trackStepIndex / 16;
-        } else {
-            playingPage = selectedTrack->selectedPage;
-        }    
-        
-        // Draw outline on currently playing note:
-        if (
-            playingPage >= selectedTrack->selectedPage && playingPage < selectedTrack->selectedPage + 1
-        ) {
-                int x = trackStepIndex % 4;
-                int y = (trackStepIndex / 4) % 4;
-                drawSingleLineRectOutline(
-                2 + x + (x * width),
-                2 + y + (y * height),
-                width,
-                height,
-                COLOR_WHITE
-            );
+        drawnPlayheadTile = getPlayheadTile(ppqnCounter, selectedTrack, &playingPage);
+        drawnPlayingPage = playingPage;
+        if (drawnPlayheadTile != -1) {
+            drawHighlightedGridTile(drawnPlayheadTile);
         }
 
-        // Highlight playing page:
         int polyCount = getPolyCount(selectedTrack);
 
-        // Show cut & copy information:
-        if (cutCounter > 0 || copyCounter > 0) {
-            char *bottomText[64];
-            if (cutCounter == 1) {
-                sprintf(bottomText, "CUTTED 1 NOTE");
-            } else if (cutCounter > 1) {
-                sprintf(bottomText, "CUTTED ALL NOTES");
-            }
-
-            if (copyCounter == 1) {
-                sprintf(bottomText, "PASTED 1 NOTE");
-            } else if (copyCounter > 1) {
-                sprintf(bottomText, "PASTED ALL NOTES");
-            }
-            drawCenteredLine(2, HEIGHT - BUTTON_HEIGHT - 12, bottomText, BUTTON_WIDTH * 4, COLOR_YELLOW);
-        } else if (!keyStates[BLIPR_KEY_SHIFT_2]) {
-            drawPageIndicator(selectedTrack, playingPage);
-        }
-
-        int noteIndicatorOffset = 12 - polyCount;
+        // Show cut & copy information, or the playing page:
+        drawSequencerStatusLine(selectedTrack, editor, playingPage, heldModifiers);
 
         // Highlight non-empty steps:
-        for (int j = 0; j < 4; j++) {
-            int height = width;
-            for (int i = 0; i < 4; i++) {
-                int stepIndex = ((i + (j * 4)) + (selectedTrack->selectedPage * 16)) % 64;
-
-                struct Step step = selectedTrack->steps[stepIndex];
-                // Check if this is within the track length, or outside the page length:
-                if (
-                    ((selectedTrack->pagePlayMode == PAGE_PLAY_MODE_CONTINUOUS) && (selectedTrack->selectedPage * 16) + i + (j * 4) > selectedTrack->trackLength) ||
-                    ((selectedTrack->pagePlayMode == PAGE_PLAY_MODE_REPEAT) && (i + (j * 4)) > selectedTrack->pageLength)
-                ) {
-                    // No note here
-                    drawRect(
-                        4 + i + (i * width),
-                        4 + j + (j * height),
-                        width - 4,
-                        height - 4,
-                        COLOR_GRAY
-                    );
-                } else {
-                    int noteIndex = (selectedTrack->playingPageBank * polyCount) + selectedNote;
-
-                    if (step.notes[noteIndex].enabled) {
-                        struct Note *note = &step.notes[noteIndex];
-                        SDL_Color noteColor = note->velocity >= 100 ? COLOR_RED : 
-                            (note->velocity >= 50 ? COLOR_DARK_RED : COLOR_LIGHT_GRAY);
-                        if (isNoteTrigged(note->trigg, selectedTrack->repeatCount)) {
-                            drawRect(
-                                4 + i + (i * width),
-                                4 + j + (j * height),
-                                width - 4,
-                                height - 4,
-                                noteColor
-                            );
-                            // Check if this note has a trigg condition
-                            if (note->trigg > 0) {
-                                drawSingleLineRectOutline(
-                                    4 + i + (i * width),
-                                    4 + j + (j * height),
-                                    width - 4,
-                                    height - 4,
-                                    mixColors(COLOR_RED, COLOR_WHITE, 0.5f)
-                                );    
-                            }                      
-                            if (!isDrumkitSequencer) {  
-                                drawTextOnButton((i + (j * 4)), getMidiNoteName(step.notes[noteIndex].note));
-                            } else {
-                                // If this note is not equal to the template note, it means that it is a different drumkit
-                                // Instrument. So we need to make that visually clear:
-                                if (note->note != templateNote.note) {
-                                    drawDimmedOverlay(
-                                        4 + i + (i * width),
-                                        4 + j + (j * height),
-                                        width - 4,
-                                        height - 4
-                                    );
-                                }
-                            }
-                        } else {
-                            // Here is a note, but it is not trigged by the fill condition:
-                            drawSingleLineRectOutline(
-                                4 + i + (i * width),
-                                4 + j + (j * height),
-                                width - 4,
-                                height - 4,
-                                noteColor
-                            );
-                        }
-
-                        // Draw nudge box:
-                        if (note->nudge < PP16N) {
-                            drawRect(
-                                2 + i + (i * width),
-                                2 + j + (j * height) + (BUTTON_HEIGHT * 0.4),
-                                2,
-                                5,
-                                noteColor
-                            );
-                        } else if (note->nudge > PP16N) {
-                            drawRect(
-                                i + (i * width) + BUTTON_WIDTH,
-                                2 + j + (j * height) + (BUTTON_HEIGHT * 0.4),
-                                2,
-                                5,
-                                noteColor
-                            );
-                        }
-                    }
-                }
-
-                // Draw selection outline:
-                if (selectedSteps[i + (j * 4)]) {
-                    drawSingleLineRectOutline(
-                        4 + i + (i * width),
-                        4 + j + (j * height),
-                        width - 4,
-                        height - 4,
-                        COLOR_YELLOW
-                    );
-                }
-                
-                // Poly count dots:
-                if (!isDrumkitSequencer) {
-                    drawRect(
-                        5 + i + (i * width) + noteIndicatorOffset,
-                        5 + j + (j * height),
-                        (polyCount * 2) + 1,
-                        3,
-                        COLOR_GRAY
-                    );
-
-                    int baseNoteIndex = (selectedTrack->playingPageBank * polyCount);
-                    for (int p=0; p<polyCount; p++) {
-                        drawPixel(
-                            6 + i + (i * width) + (p * 2) + noteIndicatorOffset,
-                            6 + j + (j * height),
-                            p == selectedNote ? COLOR_WHITE : (step.notes[baseNoteIndex + p].enabled ? COLOR_RED : COLOR_LIGHT_GRAY)
-                        );
-                    }
-                }
-            }
-        }   
+        for (int tileIndex = 0; tileIndex < 16; tileIndex++) {
+            drawSequencerStepTile(selectedTrack, editor, tileIndex, polyCount, transitionMask, isDrumkitSequencer);
+        }
     }
 
     // Draw template Note details:
-    drawTemplateNote();
+    drawTemplateNote(&editor->templateNote);
 
     // ABCD Buttons:
-    if (keyStates[BLIPR_KEY_SHIFT_1]) {
+    if (heldModifiers & BLIPR_MODIFIER_SHIFT_1) {
         // Show utilities:
         char descriptions[4][4] = {"OPT", "CUT", "CPY", "PST"};        
         drawABCDButtons(descriptions);
-    } else if (keyStates[BLIPR_KEY_SHIFT_2]) {
+    } else if (heldModifiers & BLIPR_MODIFIER_SHIFT_2) {
         // Note (for polyphony)
         char descriptions[4][4] = {"-", "-", "<", ">"};
         int polyCount = getPolyCount(selectedTrack);
@@ -1577,7 +1695,7 @@ void drawSequencerMain(
         );
         // Draw page bank number:
         char pageBankText[2];
-        sprintf(pageBankText, "%d", selectedPageBank + 1);
+        sprintf(pageBankText, "%d", editor->selectedPageBank + 1);
         drawText(2 + 28, HEIGHT - BUTTON_HEIGHT + 2, pageBankText, BUTTON_WIDTH, COLOR_WHITE);
         // Draw channel title:
         drawCenteredLine(
@@ -1589,12 +1707,12 @@ void drawSequencerMain(
         );
         // Draw channel number:
         char channelText[2];
-        sprintf(channelText, "%d", selectedNote + 1);
+        sprintf(channelText, "%d", editor->selectedNote + 1);
         drawText(92, HEIGHT - BUTTON_HEIGHT + 2, channelText, BUTTON_WIDTH, COLOR_WHITE);
     } else {
         // Page numbers:
         char descriptions[4][4] = {"P00", "P00", "P00", "P00"};
-        int startPage = (selectedPageBank * 4) + 1;
+        int startPage = (editor->selectedPageBank * 4) + 1;
         
         // Fill the descriptions array
         for (int i = 0; i < 4; i++) {
@@ -1619,15 +1737,15 @@ void drawSequencerMain(
         } else {
             // Highlight playing page + queued page:
             if (selectedTrack->queuedPage != selectedTrack->selectedPage) {
-                if (selectedTrack->queuedPage >= selectedPageBank * 4 && 
-                    selectedTrack->queuedPage < (selectedPageBank + 1) * 4) {
+                if (selectedTrack->queuedPage >= editor->selectedPageBank * 4 && 
+                    selectedTrack->queuedPage < (editor->selectedPageBank + 1) * 4) {
                     // Outline queued page:
                     drawHighlightedGridTileInColor((selectedTrack->queuedPage % 4) + 16, COLOR_RED);
                 }
             }
 
-            if (selectedTrack->selectedPage >= selectedPageBank * 4 && 
-                selectedTrack->selectedPage < (selectedPageBank + 1) * 4) {
+            if (selectedTrack->selectedPage >= editor->selectedPageBank * 4 && 
+                selectedTrack->selectedPage < (editor->selectedPageBank + 1) * 4) {
                 // Outline queued page:
                 drawHighlightedGridTile((selectedTrack->selectedPage % 4) + 16);
             }
@@ -1638,7 +1756,7 @@ void drawSequencerMain(
 /**
  * Draw the step editor
  */
-void drawStepEditor(struct Track *track, bool isDrumkitSequencer) {
+void drawStepEditor(const struct Track *track, const struct SequencerEditorState *editor, bool isDrumkitSequencer) {
     /*
         - 1-4   : Transpose -12 / -1 / +1 / +12
         - 5-6   : Increase / decrease velocity
@@ -1657,11 +1775,11 @@ void drawStepEditor(struct Track *track, bool isDrumkitSequencer) {
     drawCenteredLine(2, 133, "STEP OPTIONS", TITLE_WIDTH, COLOR_WHITE);
 
     // Step is the first selected step:
-    struct Note *note;
+    const struct Note *note;
     for (int i=0; i<16; i++) {
-        if (selectedSteps[i]) {
+        if (editor->selectedSteps[i]) {
             int stepIndex = i + (track->selectedPage * 16);
-            note = &track->steps[stepIndex].notes[selectedNote];
+            note = &track->steps[stepIndex].notes[editor->selectedNote];
             break;
         }
     }     
@@ -1670,7 +1788,7 @@ void drawStepEditor(struct Track *track, bool isDrumkitSequencer) {
     if (!isDrumkitSequencer) {
         drawCenteredLine(2, 7, "TRANSPOSE", TITLE_WIDTH, COLOR_WHITE);
         char *midiNoteName;
-        if (areAllStepPropertiesTheSame[PROPERTY_NOTE]) {
+        if (editor->areAllStepPropertiesTheSame[PROPERTY_NOTE]) {
             midiNoteName = getMidiNoteName(note->note);
         } else {
             midiNoteName = "##";
@@ -1685,7 +1803,7 @@ void drawStepEditor(struct Track *track, bool isDrumkitSequencer) {
     // Velocity:
     drawCenteredLine(2, 37, "VELOCITY", BUTTON_WIDTH * 2, COLOR_WHITE);
     char velocityChar[4];
-    if (areAllStepPropertiesTheSame[PROPERTY_VELOCITY]) {
+    if (editor->areAllStepPropertiesTheSame[PROPERTY_VELOCITY]) {
         snprintf(velocityChar, sizeof(velocityChar), "%d", note->velocity);
     } else {
         sprintf(velocityChar, "##");
@@ -1697,7 +1815,7 @@ void drawStepEditor(struct Track *track, bool isDrumkitSequencer) {
     // Length:
     drawCenteredLine(62, 37, "LENGTH", BUTTON_WIDTH * 2, COLOR_WHITE);
     char lengthChar[4];
-    if (areAllStepPropertiesTheSame[PROPERTY_LENGTH]) {
+    if (editor->areAllStepPropertiesTheSame[PROPERTY_LENGTH]) {
         snprintf(lengthChar, sizeof(lengthChar), "%d", note->length);
     } else {
         sprintf(lengthChar, "##");
@@ -1709,7 +1827,7 @@ void drawStepEditor(struct Track *track, bool isDrumkitSequencer) {
     // Nudge:
     drawCenteredLine(2, 67, "NUDGE", BUTTON_WIDTH * 2, COLOR_WHITE);
     char nudgeChar[4];
-    if (areAllStepPropertiesTheSame[PROPERTY_NUDGE]) {
+    if (editor->areAllStepPropertiesTheSame[PROPERTY_NUDGE]) {
         snprintf(nudgeChar, sizeof(nudgeChar), "%d", note->nudge - PP16N);
     } else {
         sprintf(nudgeChar, "##");
@@ -1721,7 +1839,7 @@ void drawStepEditor(struct Track *track, bool isDrumkitSequencer) {
     // Trig:
     drawCenteredLine(62, 67, "TRIGG", BUTTON_WIDTH * 2, COLOR_WHITE);
     char triggChar[4];
-    if (areAllStepPropertiesTheSame[PROPERTY_TRIG]) {
+    if (editor->areAllStepPropertiesTheSame[PROPERTY_TRIG]) {
         snprintf(
             triggChar, 
             sizeof(triggChar), 
@@ -1734,9 +1852,9 @@ void drawStepEditor(struct Track *track, bool isDrumkitSequencer) {
     drawCenteredLine(62, 77, triggChar, BUTTON_WIDTH * 2, COLOR_YELLOW);
     drawTextOnButton(10, "-");
     drawTextOnButton(11, "+");
-    // Trigg description:
-    char triggText[6];
-    if (areAllStepPropertiesTheSame[PROPERTY_TRIG]) {
+    // Trigg description (an inversed condition is up to 7 characters):
+    char triggText[8];
+    if (editor->areAllStepPropertiesTheSame[PROPERTY_TRIG]) {
         setTriggText(note->trigg, triggText);
     } else {
         sprintf(triggText, "##");
@@ -1746,7 +1864,7 @@ void drawStepEditor(struct Track *track, bool isDrumkitSequencer) {
     // CC1:
     drawCenteredLine(2, 97, "CC1 VALUE", BUTTON_WIDTH * 2, COLOR_WHITE);
     char cc1Value[4];
-    if (areAllStepPropertiesTheSame[PROPERTY_CC1]) {
+    if (editor->areAllStepPropertiesTheSame[PROPERTY_CC1]) {
         if (note->cc1Value == 0) {
             snprintf(cc1Value, sizeof(cc1Value), "OFF");
         } else {
@@ -1762,7 +1880,7 @@ void drawStepEditor(struct Track *track, bool isDrumkitSequencer) {
     // CC2:
     drawCenteredLine(62, 97, "CC2 VALUE", BUTTON_WIDTH * 2, COLOR_WHITE);
     char cc2Value[4];
-    if (areAllStepPropertiesTheSame[PROPERTY_CC2]) {
+    if (editor->areAllStepPropertiesTheSame[PROPERTY_CC2]) {
         if (note->cc2Value == 0) {
             snprintf(cc2Value, sizeof(cc2Value), "OFF");
         } else {
@@ -1782,21 +1900,65 @@ void drawStepEditor(struct Track *track, bool isDrumkitSequencer) {
     // D = ... fx? side chaining?
 
     char descriptions[4][4] = {"ONE", "OPT", "-", "-"};
-    sprintf(descriptions[0], isEditOnAllNotes ? "ALL" : "ONE");
+    sprintf(descriptions[0], editor->isEditOnAllNotes ? "ALL" : "ONE");
     drawABCDButtons(descriptions);
 }
 
 void drawSequencer(
     uint64_t *ppqnCounter, 
-    bool keyStates[SDL_NUM_SCANCODES],
-    struct Track *selectedTrack,
+    unsigned char heldModifiers,
+    const struct Track *selectedTrack,
+    const struct SequencerEditorState *editor,
+    uint64_t transitionMask,
     bool isDrumkitSequencer
 ) {
-    if (!isNoteEditorVisible) {
-        drawSequencerMain(ppqnCounter, keyStates, selectedTrack, isDrumkitSequencer);
+    if (!editor->isNoteEditorVisible) {
+        drawSequencerMain(ppqnCounter, heldModifiers, selectedTrack, editor, transitionMask, isDrumkitSequencer);
     } else {
         // int stepIndex = selectedStep + (selectedTrack->selectedPage * 16);
-        drawStepEditor(selectedTrack, isDrumkitSequencer);
+        drawStepEditor(selectedTrack, editor, isDrumkitSequencer);
+        drawnPlayheadTile = -1;
+        drawnPlayingPage = -1;
+    }
+}
+
+void drawSequencerPlayhead(
+    uint64_t *ppqnCounter,
+    unsigned char heldModifiers,
+    const struct Track *selectedTrack,
+    const struct SequencerEditorState *editor,
+    uint64_t transitionMask,
+    bool isDrumkitSequencer
+) {
+    if (editor->isNoteEditorVisible || ((heldModifiers & BLIPR_MODIFIER_SHIFT_2) && isDrumkitSequencer)) {
+        // The playhead is not shown:
+        return;
+    }
+
+    int playingPage = 0;
+    int playheadTile = getPlayheadTile(ppqnCounter, selectedTrack, &playingPage);
+    int polyCount = getPolyCount(selectedTrack);
+
+    if (playheadTile != drawnPlayheadTile) {
+        // Redraw the tile the playhead left, and the tile it moved to:
+        int tiles[2] = {drawnPlayheadTile, playheadTile};
+        for (int t = 0; t < 2; t++) {
+            if (tiles[t] == -1) {
+                continue;
+            }
+            int x = tiles[t] % 4;
+            int y = tiles[t] / 4;
+            drawRect(2 + x + (x * BUTTON_WIDTH), 2 + y + (y * BUTTON_HEIGHT), BUTTON_WIDTH, BUTTON_HEIGHT, COLOR_BLACK);
+            drawHighlightedGridTileInColor(tiles[t], tiles[t] == playheadTile ? COLOR_WHITE : COLOR_GRAY);
+            drawSequencerStepTile(selectedTrack, editor, tiles[t], polyCount, transitionMask, isDrumkitSequencer);
+        }
+        drawnPlayheadTile = playheadTile;
+    }
+
+    if (playingPage != drawnPlayingPage) {
+        drawRect(2, HEIGHT - BUTTON_HEIGHT - 12, BUTTON_WIDTH * 4, CHAR_HEIGHT, COLOR_BLACK);
+        drawSequencerStatusLine(selectedTrack, editor, playingPage, heldModifiers);
+        drawnPlayingPage = playingPage;
     }
 }
 
@@ -89,7 +89,7 @@
 #define TRIG_FIRST_PATTERN_PLAY 56      // Trigged when the pattern is played the 1st time (does not re-trig when the pattern is played a second time when coming back from another pattern)
 #define TRIG_TRANSITION_LAST_PAGE 57     // When transitioning to another page and the last repeat of transition repeats is played
 
-#define TRIG_HIGHEST_VALUE 56         // Used internally for decision making, make sure to change this if you add new trigg conditions
+#define TRIG_HIGHEST_VALUE TRIG_TRANSITION_LAST_PAGE   // Used internally for decision making, make sure to change this if you add new trigg conditions
 
 /**
  * Update the sequencer according to user input
@@ -111,6 +111,18 @@ void checkSequencerForKeyRepeats(
 );
 */
 
+/**
+ * Get the length of a note in (clock) pulses.
+ * The length of a note is set in steps, so it depends on the speed of the track
+ */
+int getNoteLengthInPulses(const struct Track *track, const struct Note *note);
+
+/**
+ * Apply the speed of a track to a pulse.
+ * Returns false if the track has nothing to process on this pulse (slower tracks skip pulses)
+ */
+bool applySpeedToPulse(unsigned char speed, uint64_t *pulse);
+
 /**
  * Run the sequencer
  */
@@ -121,12 +133,49 @@ void runSequencer(
 );
 
 /**
- * Draw the sequencer
+ * The editing state of the sequencer screen, copied by the sequencer thread so the renderer can draw it
+ * while the key thread changes it
+ */
+struct SequencerEditorState {
+    struct Note templateNote;
+    int selectedNote;
+    int selectedPageBank;
+    bool selectedSteps[16];
+    bool areAllStepPropertiesTheSame[8];
+    bool isNoteEditorVisible;
+    bool isEditOnAllNotes;
+    int cutCounter;
+    int copyCounter;
+};
+
+/**
+ * Copy the editing state of the sequencer screen
+ */
+void getSequencerEditorState(struct SequencerEditorState *editor);
+
+/**
+ * Draw the sequencer.
+ * Only the steps on the selected page of the track are drawn
  */
 void drawSequencer(
     uint64_t *ppqnCounter,
-    bool keyStates[SDL_NUM_SCANCODES],
-    struct Track *track,
+    unsigned char heldModifiers,
+    const struct Track *track,
+    const struct SequencerEditorState *editor,
+    uint64_t transitionMask,
+    bool isDrumkitSequencer
+);
+
+/**
+ * Redraw only the tiles of the playhead that moved since the sequencer was drawn.
+ * The rest of the render target should still contain the last frame drawn by drawSequencer()
+ */
+void drawSequencerPlayhead(
+    uint64_t *ppqnCounter,
+    unsigned char heldModifiers,
+    const struct Track *track,
+    const struct SequencerEditorState *editor,
+    uint64_t transitionMask,
     bool isDrumkitSequencer
 );
 
@@ -146,9 +195,35 @@ void resetSelectedNote();
 void resetTemplateNote();
 
 /**
- * Determine if a note is trigged according to it's TRIG condition
+ * Transition state of the playing pattern, the sequencer thread updates this once per pulse.
+ * Page transitions are kept per track (see getTransitionTrigMask())
+ */
+struct TransitionContext {
+    int currentPattern;
+    int queuedPattern;
+    int previousPattern;            // The pattern that played before the current one
+    unsigned int patternLoopCount;  // How many times the current pattern has played completely
+    uint16_t playedPatterns;        // Bit for every pattern in the sequence that was played before
+    bool isFillActive;
+};
+
+/**
+ * Set the transition state for the trig conditions of the notes in this pulse
  */
-bool isNoteTrigged(int triggValue, int repeatCount);
+void setTransitionContext(const struct TransitionContext *context);
+
+/**
+ * Get a mask with a bit for every transition trig condition (TRIG_FILL and up) that passes for a track.
+ * This is the same for all notes of a track in a pulse, so it only needs to be calculated once
+ */
+uint64_t getTransitionTrigMask(const struct Track *track);
+
+/**
+ * Determine if a note is trigged according to it's TRIG condition.
+ * The probability trigs draw from the random state of the track, when this is NULL they always pass.
+ * The transition trigs are looked up in the transition mask of the track
+ */
+bool isNoteTrigged(int triggValue, int repeatCount, uint32_t *randomState, uint64_t transitionMask);
 
 /**
  * Get track step index - this is the index in the steps-array on the track
@@ -169,7 +244,7 @@ void getNotesAtTrackStepIndex(int trackStepIndex, const struct Track *track, str
  */
 void processPulse(
     const uint64_t *currentPulse,
-    const struct Track *track,
+    struct Track *track,
     void (*isFirstPulseCallback)(void),
     void (*playNoteCallback)(const struct Note *note)
 );
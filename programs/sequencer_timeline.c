@@ -0,0 +1,213 @@
+#include <stdlib.h>
+#include <stdatomic.h>
+#include "sequencer_timeline.h"
+#include "sequencer.h"
+#include "../constants.h"
+#include "../project.h"
+
+// Playback state of the tracks that are playing, looked up by track:
+static struct TrackTimeline timelines[TIMELINE_CACHE_SIZE];
+static struct TimelineEvent timelineEvents[TIMELINE_CACHE_SIZE][TIMELINE_MAX_EVENTS];
+static int nextTimeline = 0;
+static int lastTimeline = 0;
+
+// Increased on every edit (by the key thread), so the playback state knows when to look at the tracks again.
+// The increase is a release, so the edit (and the dirty flag of the track) is seen by whoever reads the new generation:
+static atomic_uint timelineGeneration = 0;
+
+/**
+ * Temporary event with a sort key, used while compiling
+ */
+struct SortableEvent {
+    uint32_t key;
+    uint16_t pulse;
+    uint16_t noteIndex;
+};
+
+static struct SortableEvent sortableEvents[TIMELINE_MAX_EVENTS];
+
+static int compareSortableEvents(const void *a, const void *b) {
+    uint32_t lhKey = ((const struct SortableEvent *)a)->key;
+    uint32_t rhKey = ((const struct SortableEvent *)b)->key;
+    return (lhKey > rhKey) - (lhKey < rhKey);
+}
+
+/**
+ * Get the length of the loop of a track in pulses
+ */
+static int getLoopLength(const struct Track *track) {
+    if (track->pagePlayMode == PAGE_PLAY_MODE_CONTINUOUS) {
+        return PP16N * (track->trackLength + 1);
+    }
+    return PP16N * (track->pageLength + 1);
+}
+
+void invalidateTrackTimeline(struct Track *track) {
+    track->isTimelineDirty = true;
+    atomic_fetch_add_explicit(&timelineGeneration, 1, memory_order_release);
+}
+
+void compileTrackTimeline(struct TrackTimeline *timeline, const struct Track *track) {
+    int loopLength = getLoopLength(track);
+    int loopSteps = loopLength / PP16N;
+    int pageOffset = track->pagePlayMode == PAGE_PLAY_MODE_CONTINUOUS ? 0 : (track->selectedPage % 4) * 16;
+    int polyCount = getPolyCount(track);
+    int noteOffset = polyCount == 8 ? 0 : track->playingPageBank * polyCount;
+    uint64_t stepMask = getPlayingStepMask(track);
+    int count = 0;
+
+    // Pass 0 are notes played in their own step, pass 1 are notes with a negative nudge that are played in the previous step.
+    // Within a pulse, notes are ordered like processPulse() would play them: first the current step, then the next step.
+    for (int pass = 0; pass < 2; pass++) {
+        for (int i = 0; i < loopSteps; i++) {
+            int trackStepIndex = i + pageOffset;
+            int stepIndex = trackStepIndex % 64;
+            if ((stepMask & (1ULL << stepIndex)) == 0) {
+                continue;
+            }
+            int shuffle = trackStepIndex % 2 == 1 ? track->shuffle - PP16N : 0;
+
+            for (int n = 0; n < polyCount; n++) {
+                int noteIndex = noteOffset + n;
+                const struct Note *note = &track->steps[stepIndex].notes[noteIndex];
+                if (!note->enabled) {
+                    continue;
+                }
+
+                int pulseInStep = (note->nudge - PP16N) + shuffle;
+                int loopStep = i;
+                if (pass == 1) {
+                    // Played in the previous step, but never on its first pulse (that would be a double note):
+                    pulseInStep += PP16N;
+                    loopStep = (i + loopSteps - 1) % loopSteps;
+                    if (pulseInStep < 1 || pulseInStep >= PP16N) {
+                        continue;
+                    }
+                } else if (pulseInStep < 0 || pulseInStep >= PP16N) {
+                    continue;
+                }
+
+                int pulse = (loopStep * PP16N) + pulseInStep;
+                sortableEvents[count].key = (pulse * 2 * NOTES_IN_STEP) + (pass * NOTES_IN_STEP) + n;
+                sortableEvents[count].pulse = pulse;
+                sortableEvents[count].noteIndex = (stepIndex * NOTES_IN_STEP) + noteIndex;
+                count++;
+            }
+        }
+    }
+
+    qsort(sortableEvents, count, sizeof(struct SortableEvent), compareSortableEvents);
+
+    for (int i = 0; i < count; i++) {
+        timeline->events[i].pulse = sortableEvents[i].pulse;
+        timeline->events[i].noteIndex = sortableEvents[i].noteIndex;
+    }
+
+    timeline->track = track;
+    timeline->selectedPage = track->selectedPage;
+    timeline->playingPageBank = track->playingPageBank;
+    timeline->loopLength = loopLength;
+    timeline->lastPulse = 0;
+    timeline->cursor = 0;
+    timeline->eventCount = count;
+    timeline->nextPulse = count > 0 ? timeline->events[0].pulse : TIMELINE_NO_EVENT;
+}
+
+/**
+ * Recompile the timeline when the track was edited, or when it switched pages
+ */
+static void updateTrackTimeline(struct TrackTimeline *timeline, struct Track *track) {
+    if (
+        track->isTimelineDirty ||
+        timeline->selectedPage != track->selectedPage ||
+        timeline->playingPageBank != track->playingPageBank
+    ) {
+        // Reset the flag first, so an edit during compilation is picked up the next pulse:
+        track->isTimelineDirty = false;
+        compileTrackTimeline(timeline, track);
+    }
+}
+
+struct TrackTimeline* getTrackTimeline(struct Track *track) {
+    // Tracks are played in the same order every pulse, so start looking after the previous one:
+    struct TrackTimeline *timeline = NULL;
+    for (int i = 0; i < TIMELINE_CACHE_SIZE; i++) {
+        int index = (lastTimeline + i) % TIMELINE_CACHE_SIZE;
+        if (timelines[index].track == track) {
+            timeline = &timelines[index];
+            lastTimeline = index;
+            break;
+        }
+    }
+
+    if (timeline == NULL) {
+        // Not compiled yet, replace the oldest one:
+        timeline = &timelines[nextTimeline];
+        timeline->events = timelineEvents[nextTimeline];
+        timeline->generation = atomic_load_explicit(&timelineGeneration, memory_order_relaxed) - 1;
+        lastTimeline = nextTimeline;
+        nextTimeline = (nextTimeline + 1) % TIMELINE_CACHE_SIZE;
+        track->isTimelineDirty = true;
+    }
+
+    // Only look at the track when something was edited since the last check:
+    uint32_t generation = atomic_load_explicit(&timelineGeneration, memory_order_acquire);
+    if (timeline->generation != generation) {
+        timeline->generation = generation;
+        timeline->program = track->program;
+        timeline->midiDevice = track->midiDevice;
+        timeline->speed = track->speed;
+        updateTrackTimeline(timeline, track);
+    }
+
+    return timeline;
+}
+
+void processTimelinePulse(
+    const uint64_t *currentPulse,
+    struct Track *track,
+    void (*isFirstPulseCallback)(void),
+    void (*playNoteCallback)(const struct Note *note)
+) {
+    struct TrackTimeline *timeline = getTrackTimeline(track);
+    uint16_t pulse = *currentPulse % timeline->loopLength;
+
+    if (pulse == 0 && isFirstPulseCallback != NULL) {
+        timeline->isFirstPulse = true;
+        isFirstPulseCallback();
+        // The callback might have switched pages:
+        updateTrackTimeline(timeline, track);
+    }
+
+    // Rewind the cursor when the loop starts over:
+    if (pulse < timeline->lastPulse) {
+        timeline->cursor = 0;
+        timeline->nextPulse = timeline->eventCount > 0 ? timeline->events[0].pulse : TIMELINE_NO_EVENT;
+    }
+    timeline->lastPulse = pulse;
+
+    // Nothing to play on this pulse:
+    if (timeline->nextPulse > pulse) {
+        return;
+    }
+
+    // The transition trigs are the same for all notes in this pulse:
+    uint64_t transitionMask = getTransitionTrigMask(track);
+
+    while (timeline->cursor < timeline->eventCount && timeline->events[timeline->cursor].pulse < pulse) {
+        timeline->cursor++;
+    }
+
+    while (timeline->cursor < timeline->eventCount && timeline->events[timeline->cursor].pulse == pulse) {
+        uint16_t noteIndex = timeline->events[timeline->cursor].noteIndex;
+        const struct Note *note = &track->steps[noteIndex / NOTES_IN_STEP].notes[noteIndex % NOTES_IN_STEP];
+        if (note->enabled && isNoteTrigged(note->trigg, track->repeatCount, &track->randomState, transitionMask)) {
+            playNoteCallback(note);
+        }
+        timeline->cursor++;
+    }
+
+    timeline->nextPulse = timeline->cursor < timeline->eventCount ? 
+        timeline->events[timeline->cursor].pulse : 
+        TIMELINE_NO_EVENT;
+}
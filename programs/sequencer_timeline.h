@@ -0,0 +1,71 @@
+#ifndef SEQUENCER_TIMELINE_H
+#define SEQUENCER_TIMELINE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "../project.h"
+
+#define TIMELINE_MAX_EVENTS (512 * NOTES_IN_STEP)   // Max 512 steps, with all notes enabled
+#define TIMELINE_CACHE_SIZE 16                      // One timeline per track in the active pattern
+#define TIMELINE_NO_EVENT UINT16_MAX                // Next pulse when there are no more events in the loop
+
+/**
+ * A single note in the timeline, at a given pulse in the loop
+ */
+struct TimelineEvent {
+    uint16_t pulse;         // Pulse offset in the loop (includes nudge and shuffle)
+    uint16_t noteIndex;     // Index of the note in the track (step * NOTES_IN_STEP + note)
+};
+
+/**
+ * Playback state of a track: its compiled timeline, and the settings that are checked on every pulse.
+ * These are kept together in a small table, so running all tracks of a pattern does not touch the
+ * (large) tracks themselves, unless a note is played or the loop starts over.
+ * The timeline is rebuilt only when the track is edited or the playing page changes
+ */
+struct TrackTimeline {
+    const struct Track *track;      // The track this timeline is compiled for
+    struct TimelineEvent *events;   // Sorted events, stored apart from the playback state
+    uint32_t generation;            // Edit generation this state was last checked for
+    uint16_t loopLength;            // Length of the loop in pulses
+    uint16_t lastPulse;             // Last processed pulse offset, to detect the loop wrapping around
+    uint16_t cursor;                // Next event to check
+    uint16_t nextPulse;             // Pulse of the next event, so the events are only read when one is due
+    uint16_t eventCount;
+    unsigned char selectedPage;     // The page & page bank this timeline is compiled for
+    unsigned char playingPageBank;
+    unsigned char program;          // Copies of the track settings
+    unsigned char midiDevice;
+    unsigned char speed;
+    bool isFirstPulse;              // The loop started over on the last processed pulse
+};
+
+/**
+ * Mark the timeline of a track as outdated, so it is recompiled before the next pulse.
+ * This must be called after every edit of a track (notes or settings) that should be heard
+ */
+void invalidateTrackTimeline(struct Track *track);
+
+/**
+ * Compile the timeline for a track, the events must have room for TIMELINE_MAX_EVENTS
+ */
+void compileTrackTimeline(struct TrackTimeline *timeline, const struct Track *track);
+
+/**
+ * Get the playback state (and compiled timeline) for a track.
+ * The track itself is only read when it was edited since the last call
+ */
+struct TrackTimeline* getTrackTimeline(struct Track *track);
+
+/**
+ * Process a single pulse using the compiled timeline of the track.
+ * This has the same outcome as processPulse(), but only does work for the notes at this pulse
+ */
+void processTimelinePulse(
+    const uint64_t *currentPulse,
+    struct Track *track,
+    void (*isFirstPulseCallback)(void),
+    void (*playNoteCallback)(const struct Note *note)
+);
+
+#endif
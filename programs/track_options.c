@@ -7,6 +7,7 @@
 #include "../drawing_text.h"
 #include "../colors.h"
 #include "../print.h"
+#include "sequencer_timeline.h"
 
 char midiDeviceToCharacter(int midiDevice) {
     switch (midiDevice) {
@@ -163,6 +164,10 @@ void checkTrackOptionsForKeyRepeats(
  * Update track options according to key input
  */
 void updateTrackOptions(struct Track* track, SDL_Scancode key) {
+    // Length, poly, play mode and shuffle affect the compiled timeline:
+    invalidateTrackTimeline(track);
+    track->isDirty = true;
+
     switch (key) {
         case BLIPR_KEY_1:
             track->pagePlayMode = track->pagePlayMode == PAGE_PLAY_MODE_CONTINUOUS ? PAGE_PLAY_MODE_REPEAT : PAGE_PLAY_MODE_CONTINUOUS;
@@ -4,6 +4,7 @@
 #include "project.h"
 #include "constants.h"
 #include "print.h"
+#include "programs/sequencer_timeline.h"
 
 /**
  * Convert Note to Byte Array
@@ -78,6 +79,16 @@ struct Step byteArrayToStep(const unsigned char bytes[STEP_BYTE_SIZE]) {
  * byte 65-...  : Steps data (64 steps)
  */
 void trackToByteArray(const struct Track *track, unsigned char bytes[TRACK_BYTE_SIZE]) {
+    trackHeaderToByteArray(track, bytes);
+    for (int i = 0; i < 64; i++) {
+        stepToByteArray(&track->steps[i], bytes + 64 + (i * STEP_BYTE_SIZE));
+    }
+}
+
+/**
+ * Convert the header of a track to a byte array (everything but the steps)
+ */
+void trackHeaderToByteArray(const struct Track *track, unsigned char bytes[SMALL_HEADER_BYTE_SIZE]) {
     memcpy(bytes, track->name, 32);
     bytes[32] = track->midiDevice;
     bytes[33] = track->midiChannel;
@@ -91,22 +102,24 @@ void trackToByteArray(const struct Track *track, unsigned char bytes[TRACK_BYTE_
     bytes[42] = track->shuffle;
     bytes[43] = track->polyCount;
     bytes[44] = track->transitionRepeats;
-    memset(bytes + 45, 0, TRACK_BYTE_SIZE - 45);
-    for (int i = 0; i < 64; i++) {
-        stepToByteArray(&track->steps[i], bytes + 64 + (i * STEP_BYTE_SIZE));
-    }
+    memset(bytes + 45, 0, SMALL_HEADER_BYTE_SIZE - 45);
 }
 
 /**
- * Convert Byte Array to Track
+ * Convert Byte Array to Track, the track is decoded in place
  */
-struct Track* byteArrayToTrack(const unsigned char bytes[TRACK_BYTE_SIZE]) {
-    struct Track* track = malloc(TRACK_BYTE_SIZE);
-    if (track == NULL) {
-        printf("Error: cannot allocate memory for track\n");
-        exit(1);
+void byteArrayToTrack(struct Track *track, const unsigned char bytes[TRACK_BYTE_SIZE]) {
+    byteArrayToTrackHeader(track, bytes);
+    for (int i = 0; i < 64; i++) {
+        track->steps[i] = byteArrayToStep(bytes + 64 + (i * STEP_BYTE_SIZE));
     }
+    updateTrackNoteMasks(track);
+}
 
+/**
+ * Convert the header of a track byte array (everything but the steps)
+ */
+void byteArrayToTrackHeader(struct Track *track, const unsigned char bytes[SMALL_HEADER_BYTE_SIZE]) {
     memcpy(track->name, bytes, 32);
     track->midiDevice = bytes[32];
     track->midiChannel = bytes[33];
@@ -120,14 +133,8 @@ struct Track* byteArrayToTrack(const unsigned char bytes[TRACK_BYTE_SIZE]) {
     track->shuffle = bytes[42];
     track->polyCount = bytes[43];
     track->transitionRepeats = bytes[44];
+    track->isDirty = false;
     resetTrack(track);
-    for (int i = 0; i < 64; i++) {
-        unsigned char arr[STEP_BYTE_SIZE];
-        // Copy part of byte array into arr
-        memcpy(arr, bytes + 64 + (i * STEP_BYTE_SIZE), STEP_BYTE_SIZE);
-        track->steps[i] = byteArrayToStep(arr);
-    }
-    return track;
 }
 
 /**
@@ -138,6 +145,68 @@ void resetTrack(struct Track *track) {
     track->playingPageBank = 0;
     track->queuedPage = 0;
     track->repeatCount = 0;
+    track->previousPage = 0;
+    track->playedPages = 0;
+    // The track can be decoded or initialized again while its timeline is cached:
+    invalidateTrackTimeline(track);
+}
+
+/**
+ * Reset the playback state of a track when its pattern starts playing
+ */
+void restartTrack(struct Track *track, int index) {
+    track->repeatCount = 0;
+    track->previousPage = track->selectedPage;
+    track->playedPages = 0;
+    // Probability trigs play the same every time the pattern starts:
+    seedTrackRandomState(track, index);
+}
+
+/**
+ * Seed the random generator of a track
+ */
+void seedTrackRandomState(struct Track *track, int index) {
+    track->randomState = (uint32_t)(index + 1) * 0x9E3779B9u;
+}
+
+/**
+ * Update the note masks of a single step
+ */
+void updateStepNoteMasks(struct Track *track, int stepIndex) {
+    uint64_t stepBit = 1ULL << stepIndex;
+    for (int n = 0; n < NOTES_IN_STEP; n++) {
+        if (track->steps[stepIndex].notes[n].enabled) {
+            track->noteMasks[n] |= stepBit;
+        } else {
+            track->noteMasks[n] &= ~stepBit;
+        }
+    }
+}
+
+/**
+ * Rebuild all note masks of a track
+ */
+void updateTrackNoteMasks(struct Track *track) {
+    for (int n = 0; n < NOTES_IN_STEP; n++) {
+        uint64_t mask = 0;
+        for (int s = 0; s < 64; s++) {
+            mask |= (uint64_t)track->steps[s].notes[n].enabled << s;
+        }
+        track->noteMasks[n] = mask;
+    }
+}
+
+/**
+ * Get a mask with a bit for every step that has an enabled note in the playing note slots
+ */
+uint64_t getPlayingStepMask(const struct Track *track) {
+    int polyCount = getPolyCount(track);
+    int noteOffset = polyCount == 8 ? 0 : track->playingPageBank * polyCount;
+    uint64_t mask = 0;
+    for (int n = 0; n < polyCount; n++) {
+        mask |= track->noteMasks[noteOffset + n];
+    }
+    return mask;
 }
 
 /**
@@ -147,6 +216,16 @@ void resetTrack(struct Track *track) {
  * byte 65-...  : Track Data
  */
 void patternToByteArray(const struct Pattern *pattern, unsigned char bytes[PATTERN_BYTE_SIZE]) {
+    patternHeaderToByteArray(pattern, bytes);
+    for (int i = 0; i < 16; i++) {
+        trackToByteArray(&pattern->tracks[i], bytes + 64 + (i * TRACK_BYTE_SIZE));
+    }
+}
+
+/**
+ * Convert the header of a pattern to a byte array (everything but the track data)
+ */
+void patternHeaderToByteArray(const struct Pattern *pattern, unsigned char bytes[SMALL_HEADER_BYTE_SIZE]) {
     memcpy(bytes, pattern->name, 32);
     bytes[32] = pattern->bpm;
     bytes[33] = pattern->programA;
@@ -155,21 +234,23 @@ void patternToByteArray(const struct Pattern *pattern, unsigned char bytes[PATTE
     bytes[36] = pattern->programD;
     bytes[37] = pattern->length;
     memset(bytes + 38, 0, 64 - 38);
-    for (int i = 0; i < 16; i++) {
-        trackToByteArray(&pattern->tracks[i], bytes + 64 + (i * TRACK_BYTE_SIZE));
-    }
 }
 
 /**
- * Convert byte array to pattern
+ * Convert byte array to pattern, the pattern is decoded in place
  */
-struct Pattern* byteArrayToPattern(const unsigned char bytes[PATTERN_BYTE_SIZE]) {
-    struct Pattern* pattern = malloc(PATTERN_BYTE_SIZE);
-    if (pattern == NULL) {
-        printf("Error: cannot allocate memory for pattern\n");
-        exit(1);
+void byteArrayToPattern(struct Pattern *pattern, const unsigned char bytes[PATTERN_BYTE_SIZE]) {
+    byteArrayToPatternHeader(pattern, bytes);
+    for (int i = 0; i < 16; i++) {
+        byteArrayToTrack(&pattern->tracks[i], bytes + 64 + (i * TRACK_BYTE_SIZE));
+        seedTrackRandomState(&pattern->tracks[i], i);
     }
+}
 
+/**
+ * Convert the header of a pattern byte array (everything but the track data)
+ */
+void byteArrayToPatternHeader(struct Pattern *pattern, const unsigned char bytes[SMALL_HEADER_BYTE_SIZE]) {
     memcpy(pattern->name, bytes, 32);
     pattern->bpm = bytes[32];
     pattern->programA = bytes[33];
@@ -177,10 +258,7 @@ struct Pattern* byteArrayToPattern(const unsigned char bytes[PATTERN_BYTE_SIZE])
     pattern->programC = bytes[35];
     pattern->programD = bytes[36];
     pattern->length = bytes[37];
-    for (int i = 0; i < 16; i++) {
-        pattern->tracks[i] = *byteArrayToTrack(bytes + 64 + (i * TRACK_BYTE_SIZE));
-    }
-    return pattern;
+    pattern->isDirty = false;
 }
 
 /**
@@ -198,20 +276,13 @@ void sequenceToByteArray(const struct Sequence *sequence, unsigned char bytes[SE
 }
 
 /**
- * Convert Byte Array to Sequence
+ * Convert Byte Array to Sequence, the sequence is decoded in place
  */
-struct Sequence* byteArrayToSequence(const unsigned char bytes[SEQUENCE_BYTE_SIZE]) {
-    struct Sequence* sequence = malloc(SEQUENCE_BYTE_SIZE);
-    if (sequence == NULL) {
-        printf("Error: cannot allocate memory for sequence\n");
-        exit(1);
-    }
-
+void byteArrayToSequence(struct Sequence *sequence, const unsigned char bytes[SEQUENCE_BYTE_SIZE]) {
     memcpy(sequence->name, bytes, 32);
     for (int i = 0; i < 16; i++) {
-        sequence->patterns[i] = *byteArrayToPattern(bytes + 64 + (i * PATTERN_BYTE_SIZE));
+        byteArrayToPattern(&sequence->patterns[i], bytes + 64 + (i * PATTERN_BYTE_SIZE));
     }
-    return sequence;
 }
 
 /**
@@ -221,10 +292,22 @@ struct Sequence* byteArrayToSequence(const unsigned char bytes[SEQUENCE_BYTE_SIZ
  * byte 65-96   : Midi Device #2 name
  * byte 97-128  : Midi Device #3 name
  * byte 129-160 : Midi Device #4 name
- * byte 33-256  : Spare 
+ * byte 161-164 : Midi Device #1-#4 program change channel
+ * byte 165-168 : Midi Device #1-#4 output latency (ms)
+ * byte 169-256 : Spare 
  * byte 257-... : Sequence Data
  */
 void projectToByteArray(const struct Project *project, unsigned char bytes[PROJECT_BYTE_SIZE]) {
+    projectHeaderToByteArray(project, bytes);
+    for (int i = 0; i < 16; i++) {
+        sequenceToByteArray(&project->sequences[i], bytes + 256 + (i * SEQUENCE_BYTE_SIZE));
+    }
+}
+
+/**
+ * Convert the header of a project to a byte array (everything but the sequence data)
+ */
+void projectHeaderToByteArray(const struct Project *project, unsigned char bytes[LARGE_HEADER_BYTE_SIZE]) {
     memcpy(bytes, project->name, 32);
     memcpy(bytes + 32, project->midiDeviceAName, 32);
     memcpy(bytes + 64, project->midiDeviceBName, 32);
@@ -234,21 +317,17 @@ void projectToByteArray(const struct Project *project, unsigned char bytes[PROJE
     bytes[161] = project->midiDevicePcChannelB;
     bytes[162] = project->midiDevicePcChannelC;
     bytes[163] = project->midiDevicePcChannelD;
-    memset(bytes + 164, 0, 256 - 164);
-    for (int i = 0; i < 16; i++) {
-        sequenceToByteArray(&project->sequences[i], bytes + 256 + (i * SEQUENCE_BYTE_SIZE));
-    }
+    bytes[164] = project->midiDeviceLatencyA;
+    bytes[165] = project->midiDeviceLatencyB;
+    bytes[166] = project->midiDeviceLatencyC;
+    bytes[167] = project->midiDeviceLatencyD;
+    memset(bytes + 168, 0, 256 - 168);
 }
 
 /**
- * Convert Byte Array to Project
+ * Convert the header of a project byte array (everything but the sequence data)
  */
-struct Project* byteArrayToProject(const unsigned char bytes[PROJECT_BYTE_SIZE]) {
-    struct Project* project = malloc(PROJECT_BYTE_SIZE);
-    if (project == NULL) {
-        printf("Error: cannot allocate memory for project\n");
-        exit(1);
-    }
+void byteArrayToProjectHeader(struct Project *project, const unsigned char bytes[LARGE_HEADER_BYTE_SIZE]) {
     memcpy(project->name, bytes, 32);
     memcpy(project->midiDeviceAName, bytes + 32, 32);
     memcpy(project->midiDeviceBName, bytes + 64, 32);
@@ -258,10 +337,76 @@ struct Project* byteArrayToProject(const unsigned char bytes[PROJECT_BYTE_SIZE])
     project->midiDevicePcChannelB = bytes[161];
     project->midiDevicePcChannelC = bytes[162];
     project->midiDevicePcChannelD = bytes[163];
+    project->midiDeviceLatencyA = MIN(bytes[164], BLIPR_MIDI_MAX_LATENCY);
+    project->midiDeviceLatencyB = MIN(bytes[165], BLIPR_MIDI_MAX_LATENCY);
+    project->midiDeviceLatencyC = MIN(bytes[166], BLIPR_MIDI_MAX_LATENCY);
+    project->midiDeviceLatencyD = MIN(bytes[167], BLIPR_MIDI_MAX_LATENCY);
+    project->isDirty = false;
+}
+
+/**
+ * Convert Byte Array to Project, the project is decoded in place
+ */
+void byteArrayToProject(struct Project *project, const unsigned char bytes[PROJECT_BYTE_SIZE]) {
+    byteArrayToProjectHeader(project, bytes);
+    for (int i = 0; i < 16; i++) {
+        byteArrayToSequence(&project->sequences[i], bytes + 256 + (i * SEQUENCE_BYTE_SIZE));
+    }
+}
+
+/**
+ * Initialize an empty track
+ */
+void initializeTrack(struct Track *track, int index) {
+    memset(track->name, 0, sizeof(track->name));
+    snprintf(track->name, sizeof(track->name), "Track %d", index + 1);
+    track->midiDevice = 0;
+    track->midiChannel = 0;
+    track->program = BLIPR_PROGRAM_NONE;
+    track->pagePlayMode = PAGE_PLAY_MODE_REPEAT;
+    track->pageLength = 15;
+    track->trackLength = 63;
+    track->cc1Assignment = 0;
+    track->cc2Assignment = 0;
+    track->polyCount = 0;
+    track->shuffle = PP16N; // PP16N = middle, nudge 0
+    track->speed = TRACK_SPEED_NORMAL;
+    track->transitionRepeats = 0;
+    track->isDirty = false;
+    resetTrack(track);
+    seedTrackRandomState(track, index);
+    for (int s = 0; s < 64; s++) {
+        for (int n = 0; n < NOTES_IN_STEP; n++) {
+            struct Note *note = &track->steps[s].notes[n];
+            note->enabled = false;
+            note->note = 0;
+            note->velocity = 0;
+            note->length = 0;
+            note->nudge = PP16N; // PP16N = middle, nudge 0
+            note->trigg = 0;
+            note->cc1Value = 0;
+            note->cc2Value = 0;
+        }
+    }
+    memset(track->noteMasks, 0, sizeof(track->noteMasks));
+}
+
+/**
+ * Initialize an empty pattern
+ */
+void initializePattern(struct Pattern *pattern, int index) {
+    memset(pattern->name, 0, sizeof(pattern->name));
+    snprintf(pattern->name, sizeof(pattern->name), "Pattern %d", index + 1);
+    pattern->bpm = 120 - 45;
+    pattern->programA = 0;
+    pattern->programB = 0;
+    pattern->programC = 0;
+    pattern->programD = 0;
+    pattern->length = 63;
+    pattern->isDirty = false;
     for (int i = 0; i < 16; i++) {
-        project->sequences[i] = *byteArrayToSequence(bytes + 256  + (i  * SEQUENCE_BYTE_SIZE));
+        initializeTrack(&pattern->tracks[i], i);
     }
-    return project;
 }
 
 /**
@@ -269,50 +414,17 @@ struct Project* byteArrayToProject(const unsigned char bytes[PROJECT_BYTE_SIZE])
  */
 void initializeProject(struct Project* project) {
     strcpy(project->name, "New Project");
+    project->midiDeviceLatencyA = 0;
+    project->midiDeviceLatencyB = 0;
+    project->midiDeviceLatencyC = 0;
+    project->midiDeviceLatencyD = 0;
+    project->isDirty = false;
     for (int i = 0; i < 16; i++) {
-        struct Sequence sequence;
-        snprintf(sequence.name, sizeof(sequence.name), "Sequence %d", i + 1);
+        struct Sequence *sequence = &project->sequences[i];
+        snprintf(sequence->name, sizeof(sequence->name), "Sequence %d", i + 1);
         for (int j = 0; j < 16; j++) {
-            struct Pattern pattern;
-            snprintf(pattern.name, sizeof(pattern.name), "Pattern %d", j + 1);
-            pattern.bpm = 120 - 45;
-            pattern.length = 63;
-            for (int k = 0; k < 16; k++) {
-                struct Track track;
-                snprintf(track.name, sizeof(track.name), "Track %d", k + 1);
-                track.midiDevice = 0;
-                track.midiChannel = 0;
-                track.program = BLIPR_PROGRAM_NONE;
-                track.pagePlayMode = PAGE_PLAY_MODE_REPEAT;
-                track.pageLength = 15;
-                track.trackLength = 63;
-                track.polyCount = 0;
-                track.selectedPage = 0;
-                track.queuedPage = 0;
-                track.shuffle = PP16N; // PP16N = middle, nudge 0
-                track.speed = TRACK_SPEED_NORMAL;
-                track.transitionRepeats = 0;
-                for (int s = 0; s < 64; s++) {
-                    struct Step step;
-                    for (int n = 0; n < NOTES_IN_STEP; n++) {
-                        struct Note note;
-                        note.enabled = false;
-                        note.note = 0;
-                        note.velocity = 0;
-                        note.length = 0;
-                        note.nudge = PP16N; // PP16N = middle, nudge 0
-                        note.trigg = 0;
-                        note.cc1Value = 0;
-                        note.cc2Value = 0;
-                        step.notes[n] = note;
-                    }
-                    track.steps[s] = step;
-                }
-                pattern.tracks[k] = track;
-            }
-            sequence.patterns[j] = pattern;
+            initializePattern(&sequence->patterns[j], j);
         }
-        project->sequences[i] = sequence;
     }
 }
 
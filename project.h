@@ -83,20 +83,51 @@ struct Track {
     unsigned char playingPageBank;
     unsigned char queuedPage;
     unsigned int repeatCount;
-    bool isFirstPulse;
+    uint32_t randomState;   // State of the random generator for the probability trigs
+    unsigned char previousPage;     // The page that played before the selected page, for the page transition trigs
+    uint16_t playedPages;           // Bit for every page that was played since the pattern started
+    bool isTimelineDirty;   // The compiled timeline of this track needs to be rebuilt
+    bool isDirty;           // The track has changes that are not saved yet
+    uint64_t noteMasks[NOTES_IN_STEP];  // A bit per step for every note slot, set when the note is enabled
     
     // Steps are only used for the "Sequencer"-program
     struct Step steps[64];
 };
 
 void trackToByteArray(const struct Track *track, unsigned char bytes[TRACK_BYTE_SIZE]);
-struct Track* byteArrayToTrack(const unsigned char bytes[TRACK_BYTE_SIZE]);
+void byteArrayToTrack(struct Track *track, const unsigned char bytes[TRACK_BYTE_SIZE]);
+void trackHeaderToByteArray(const struct Track *track, unsigned char bytes[SMALL_HEADER_BYTE_SIZE]);
+void byteArrayToTrackHeader(struct Track *track, const unsigned char bytes[SMALL_HEADER_BYTE_SIZE]);
 
 /**
  * Reset internal, locally track data (like counters, etc)
  */
 void resetTrack(struct Track *track);
 
+/**
+ * Reset the playback state of a track when its pattern starts playing
+ */
+void restartTrack(struct Track *track, int index);
+
+/**
+ * Seed the random generator of a track, so probability trigs play the same every time a pattern starts.
+ * The index of the track makes sure tracks do not follow the same sequence
+ */
+void seedTrackRandomState(struct Track *track, int index);
+
+/**
+ * Update the note masks of a single step or a whole track.
+ * This needs to be called after the enabled state of a note is changed
+ */
+void updateStepNoteMasks(struct Track *track, int stepIndex);
+void updateTrackNoteMasks(struct Track *track);
+
+/**
+ * Get a mask with a bit for every step that has an enabled note in the playing note slots.
+ * This takes into account the polyphony sacrifice for more steps
+ */
+uint64_t getPlayingStepMask(const struct Track *track);
+
 /**
  * A pattern contains 16 tracks
  */
@@ -108,11 +139,14 @@ struct Pattern {
     unsigned char programC;
     unsigned char programD;
     unsigned char length;   // How many steps before a transition to take effect? (take into account page play mode)
+    bool isDirty;           // Not saved, the pattern header has changes that are not saved yet
     struct Track tracks[16];
 };
 
 void patternToByteArray(const struct Pattern *pattern, unsigned char bytes[PATTERN_BYTE_SIZE]);
-struct Pattern* byteArrayToPattern(const unsigned char bytes[PATTERN_BYTE_SIZE]);
+void patternHeaderToByteArray(const struct Pattern *pattern, unsigned char bytes[SMALL_HEADER_BYTE_SIZE]);
+void byteArrayToPattern(struct Pattern *pattern, const unsigned char bytes[PATTERN_BYTE_SIZE]);
+void byteArrayToPatternHeader(struct Pattern *pattern, const unsigned char bytes[SMALL_HEADER_BYTE_SIZE]);
 
 /**
  * A sequence contains 16 patterns
@@ -123,7 +157,7 @@ struct Sequence {
 };
 
 void sequenceToByteArray(const struct Sequence *sequence, unsigned char bytes[SEQUENCE_BYTE_SIZE]);
-struct Sequence* byteArrayToSequence(const unsigned char bytes[SEQUENCE_BYTE_SIZE]);
+void byteArrayToSequence(struct Sequence *sequence, const unsigned char bytes[SEQUENCE_BYTE_SIZE]);
 
 /**
  * A Project contains 16 sequences
@@ -138,11 +172,25 @@ struct Project {
     unsigned char midiDevicePcChannelB;
     unsigned char midiDevicePcChannelC;
     unsigned char midiDevicePcChannelD;
+    unsigned char midiDeviceLatencyA;   // Output latency in ms, 0 = send immediately
+    unsigned char midiDeviceLatencyB;
+    unsigned char midiDeviceLatencyC;
+    unsigned char midiDeviceLatencyD;
+    bool isDirty;                       // Not saved, the project header has changes that are not saved yet
     struct Sequence sequences[16];
 };
 
 void projectToByteArray(const struct Project *project, unsigned char bytes[PROJECT_BYTE_SIZE]);
-struct Project* byteArrayToProject(const unsigned char bytes[PROJECT_BYTE_SIZE]);
+void projectHeaderToByteArray(const struct Project *project, unsigned char bytes[LARGE_HEADER_BYTE_SIZE]);
+void byteArrayToProject(struct Project *project, const unsigned char bytes[PROJECT_BYTE_SIZE]);
+void byteArrayToProjectHeader(struct Project *project, const unsigned char bytes[LARGE_HEADER_BYTE_SIZE]);
+
+/**
+ * Initialize an empty track, pattern or project.
+ * The index is the position of the track or pattern, used for its default name
+ */
+void initializeTrack(struct Track *track, int index);
+void initializePattern(struct Pattern *pattern, int index);
 
 /**
  * Initialize an empty project
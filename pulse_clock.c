@@ -0,0 +1,102 @@
+#include <errno.h>
+#include <time.h>
+#include "pulse_clock.h"
+#include "constants.h"
+
+#define FRACTION_BITS 32
+#define FRACTION_MASK 0xFFFFFFFFULL
+
+uint64_t calculatePulsePeriod(int bpm) {
+    uint64_t pulsesPerMinute = (uint64_t)bpm * PPQN_MULTIPLIED;
+    uint64_t nanoSecondsPerMinute = 60 * NANOS_PER_SEC;
+    uint64_t whole = nanoSecondsPerMinute / pulsesPerMinute;
+    uint64_t remainder = nanoSecondsPerMinute % pulsesPerMinute;
+    // Round the fraction to the nearest 1/2^32 ns (a carry ends up in the whole part):
+    uint64_t fraction = ((remainder << FRACTION_BITS) + pulsesPerMinute / 2) / pulsesPerMinute;
+    return (whole << FRACTION_BITS) + fraction;
+}
+
+void initializePulseClock(struct PulseClock *pulseClock, uint64_t startNs, uint64_t period) {
+    pulseClock->anchorNs = startNs;
+    pulseClock->anchorPulse = 0;
+    pulseClock->period = period;
+}
+
+uint64_t getPulseDeadline(const struct PulseClock *pulseClock, uint64_t pulse) {
+    // 64 x 32.32 multiplication, split up so it does not overflow 64 bits (and does not need 128 bit integers):
+    uint64_t n = pulse - pulseClock->anchorPulse;
+    uint64_t whole = n * (pulseClock->period >> FRACTION_BITS);
+    uint64_t fraction = pulseClock->period & FRACTION_MASK;
+    uint64_t high = (n >> FRACTION_BITS) * fraction;
+    uint64_t low = (n & FRACTION_MASK) * fraction;
+    return pulseClock->anchorNs + whole + high + ((low + (1ULL << (FRACTION_BITS - 1))) >> FRACTION_BITS);
+}
+
+void setPulseClockPeriod(struct PulseClock *pulseClock, uint64_t pulse, uint64_t period) {
+    pulseClock->anchorNs = getPulseDeadline(pulseClock, pulse);
+    pulseClock->anchorPulse = pulse;
+    pulseClock->period = period;
+}
+
+uint64_t timespecToNs(struct timespec *ts) {
+    return (uint64_t)ts->tv_sec * NANOS_PER_SEC + (uint64_t)ts->tv_nsec;
+}
+
+uint64_t getMonotonicTimeNs() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return timespecToNs(&now);
+}
+
+uint64_t sleepUntil(uint64_t deadlineNs, uint64_t spinTailNs) {
+    uint64_t now = getMonotonicTimeNs();
+
+    if (deadlineNs > now + spinTailNs) {
+        uint64_t wakeUpNs = deadlineNs - spinTailNs;
+        struct timespec wakeUp;
+        wakeUp.tv_sec = wakeUpNs / NANOS_PER_SEC;
+        wakeUp.tv_nsec = wakeUpNs % NANOS_PER_SEC;
+#ifdef TIMER_ABSTIME
+        // Absolute deadlines do not accumulate the error of the previous wake-ups:
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wakeUp, NULL) == EINTR) {}
+#else
+        // No absolute sleep available (macOS), fall back to a relative sleep:
+        uint64_t relativeNs = wakeUpNs - now;
+        struct timespec relative;
+        relative.tv_sec = relativeNs / NANOS_PER_SEC;
+        relative.tv_nsec = relativeNs % NANOS_PER_SEC;
+        while (nanosleep(&relative, &relative) == -1 && errno == EINTR) {}
+#endif
+        now = getMonotonicTimeNs();
+    }
+
+    // Spin the remaining tail:
+    while (now < deadlineNs) {
+        now = getMonotonicTimeNs();
+    }
+
+    return now - deadlineNs;
+}
+
+void resetPulseSchedulerStats(struct PulseSchedulerStats *stats) {
+    stats->wakeUps = 0;
+    stats->totalLatenessNs = 0;
+    stats->maxLatenessNs = 0;
+    stats->lastLatenessNs = 0;
+}
+
+void recordPulseSchedulerLateness(struct PulseSchedulerStats *stats, uint64_t latenessNs) {
+    stats->wakeUps++;
+    stats->totalLatenessNs += latenessNs;
+    stats->lastLatenessNs = latenessNs;
+    if (latenessNs > stats->maxLatenessNs) {
+        stats->maxLatenessNs = latenessNs;
+    }
+}
+
+uint64_t getAveragePulseSchedulerLateness(const struct PulseSchedulerStats *stats) {
+    if (stats->wakeUps == 0) {
+        return 0;
+    }
+    return stats->totalLatenessNs / stats->wakeUps;
+}
@@ -0,0 +1,81 @@
+#ifndef PULSE_CLOCK_H
+#define PULSE_CLOCK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+/**
+ * Statistics on how late the pulse scheduler woke up compared to its deadlines
+ */
+struct PulseSchedulerStats {
+    uint64_t wakeUps;
+    uint64_t totalLatenessNs;
+    uint64_t maxLatenessNs;
+    uint64_t lastLatenessNs;
+};
+
+/**
+ * A pulse clock anchored to a start timestamp.
+ * The period is kept in 32.32 fixed-point nanoseconds, so pulse N is always scheduled at exactly
+ * anchor + N * period, without accumulating the rounding error of an integer period.
+ */
+struct PulseClock {
+    uint64_t anchorNs;      // Timestamp of the anchor pulse
+    uint64_t anchorPulse;   // Pulse number at the anchor
+    uint64_t period;        // Nanoseconds per pulse (32.32 fixed-point)
+};
+
+/**
+ * Calculate the 32.32 fixed-point period in nanoseconds per pulse for a given BPM
+ */
+uint64_t calculatePulsePeriod(int bpm);
+
+/**
+ * Initialize a pulse clock, with pulse 0 at the given start timestamp
+ */
+void initializePulseClock(struct PulseClock *pulseClock, uint64_t startNs, uint64_t period);
+
+/**
+ * Get the timestamp (in nanoseconds) at which the given pulse should happen
+ */
+uint64_t getPulseDeadline(const struct PulseClock *pulseClock, uint64_t pulse);
+
+/**
+ * Change the period of the clock. The clock is re-anchored on the given pulse, so there is no phase jump
+ */
+void setPulseClockPeriod(struct PulseClock *pulseClock, uint64_t pulse, uint64_t period);
+
+/**
+ * Convert a timespec to nanoseconds
+ */
+uint64_t timespecToNs(struct timespec *ts);
+
+/**
+ * Get the current time of the monotonic clock in nanoseconds
+ */
+uint64_t getMonotonicTimeNs();
+
+/**
+ * Sleep until the given absolute deadline (in monotonic nanoseconds).
+ * The last spinTailNs before the deadline are busy-waited to compensate for wake-up latency.
+ * Returns how many nanoseconds after the deadline this function returned.
+ */
+uint64_t sleepUntil(uint64_t deadlineNs, uint64_t spinTailNs);
+
+/**
+ * Reset scheduler statistics
+ */
+void resetPulseSchedulerStats(struct PulseSchedulerStats *stats);
+
+/**
+ * Record the lateness of a single wake-up
+ */
+void recordPulseSchedulerLateness(struct PulseSchedulerStats *stats, uint64_t latenessNs);
+
+/**
+ * Get the average lateness of all recorded wake-ups
+ */
+uint64_t getAveragePulseSchedulerLateness(const struct PulseSchedulerStats *stats);
+
+#endif
@@ -0,0 +1,83 @@
+#include <stddef.h>
+#include <string.h>
+#include "render_snapshot.h"
+
+#define RENDER_SNAPSHOT_FRESH 4
+#define RENDER_SNAPSHOT_INDEX 3
+
+void initializeRenderSnapshotBuffer(struct RenderSnapshotBuffer *buffer) {
+    buffer->back = 0;
+    atomic_init(&buffer->middle, 1);
+    buffer->front = 2;
+}
+
+struct RenderSnapshot* getRenderSnapshotBackSlot(struct RenderSnapshotBuffer *buffer) {
+    return &buffer->slots[buffer->back];
+}
+
+void publishRenderSnapshot(struct RenderSnapshotBuffer *buffer) {
+    // Release the written slot and take over the previous one (which the consumer did not pick up, or already released):
+    unsigned int previous = atomic_exchange_explicit(
+        &buffer->middle,
+        buffer->back | RENDER_SNAPSHOT_FRESH,
+        memory_order_acq_rel
+    );
+    buffer->back = previous & RENDER_SNAPSHOT_INDEX;
+}
+
+struct RenderSnapshot* acquireRenderSnapshot(struct RenderSnapshotBuffer *buffer) {
+    if ((atomic_load_explicit(&buffer->middle, memory_order_relaxed) & RENDER_SNAPSHOT_FRESH) == 0) {
+        return NULL;
+    }
+
+    // Only the consumer clears the fresh flag, so the exchange always returns a fresh slot:
+    unsigned int latest = atomic_exchange_explicit(&buffer->middle, buffer->front, memory_order_acq_rel);
+    buffer->front = latest & RENDER_SNAPSHOT_INDEX;
+
+    return &buffer->slots[buffer->front];
+}
+
+void copyRenderSnapshotTrack(struct RenderSnapshot *snapshot, const struct Track *track) {
+    memcpy(&snapshot->track, track, offsetof(struct Track, steps));
+    int firstStep = (track->selectedPage * 16) % 64;
+    memcpy(&snapshot->track.steps[firstStep], &track->steps[firstStep], sizeof(struct Step) * 16);
+}
+
+/**
+ * Check if 2 snapshots draw the same, apart from the playhead
+ */
+static bool isRenderLayoutEqual(const struct RenderSnapshot *a, const struct RenderSnapshot *b) {
+    return a->editCount == b->editCount &&
+        a->screen == b->screen &&
+        a->selectedSequence == b->selectedSequence &&
+        a->selectedPattern == b->selectedPattern &&
+        a->queuedPattern == b->queuedPattern &&
+        a->selectedTrack == b->selectedTrack &&
+        a->bpm == b->bpm &&
+        a->patternLength == b->patternLength &&
+        a->isFillActive == b->isFillActive &&
+        a->transitionMask == b->transitionMask &&
+        a->track.selectedPage == b->track.selectedPage &&
+        a->track.queuedPage == b->track.queuedPage &&
+        a->track.playingPageBank == b->track.playingPageBank &&
+        a->track.repeatCount == b->track.repeatCount;
+}
+
+int getDirtyRenderRegions(const struct RenderSnapshot *drawn, const struct RenderSnapshot *next) {
+    if (drawn == NULL || !isRenderLayoutEqual(drawn, next)) {
+        return RENDER_REGION_ALL;
+    }
+
+    int regions = 0;
+    if (drawn->ppqnCounter % PPQN_MULTIPLIED != next->ppqnCounter % PPQN_MULTIPLIED) {
+        regions |= RENDER_REGION_BORDER;
+    }
+    if (drawn->patternStepCounter != next->patternStepCounter) {
+        regions |= RENDER_REGION_PATTERN_LENGTH;
+    }
+    if (drawn->ppqnCounter != next->ppqnCounter) {
+        regions |= RENDER_REGION_PLAYHEAD;
+    }
+
+    return regions;
+}
@@ -0,0 +1,94 @@
+#ifndef RENDER_SNAPSHOT_H
+#define RENDER_SNAPSHOT_H
+
+#include <SDL.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include "constants.h"
+#include "project.h"
+#include "programs/sequencer.h"
+#include "programs/config_selection.h"
+#include "programs/pattern_options.h"
+
+/**
+ * Everything the renderer needs to draw a frame, copied from the shared state by the sequencer thread.
+ * Only what the screens draw is copied, so the renderer never reads the project or the state of the screens.
+ */
+struct RenderSnapshot {
+    uint64_t ppqnCounter;
+    uint64_t patternStepCounter;
+    int patternLength;
+    int bpm;
+    int selectedSequence;
+    int selectedPattern;
+    int queuedPattern;
+    int selectedTrack;
+    BliprScreen screen;
+    bool isFillActive;
+    uint64_t transitionMask;        // Transition trig conditions that pass for the selected track
+    uint32_t editCount;             // Increased by the key thread on every key event
+    unsigned char heldModifiers;    // BLIPR_MODIFIER_* bits of the shift & function keys that are held
+    struct Track track;             // The selected track, only the steps on its selected page are copied
+    struct PatternHeader pattern;   // Header of the selected pattern
+    struct SequencerEditorState editor;     // Only copied on the sequencer screens
+    struct ConfigScreenState config;        // Only copied on the configuration screen
+
+    // For monitoring:
+    int64_t midiLeadTimeUs;
+    uint64_t clockLatenessNs;
+    double seqPerformance;
+};
+
+// Regions of the render target that need to be drawn again:
+#define RENDER_REGION_BORDER            0x01    // The BPM blinker
+#define RENDER_REGION_PATTERN_LENGTH    0x02    // The pattern length indicator in the sidebar
+#define RENDER_REGION_PLAYHEAD          0x04    // The parts of the screen that follow the playhead
+#define RENDER_REGION_ALL               0xFF    // Everything, including the static parts
+
+/**
+ * Lock-free triple buffer of render snapshots, with a single producer (the sequencer thread) and
+ * a single consumer (the renderer). The producer always has a slot to write to and the consumer
+ * always has a slot to read from, so neither of them ever waits for the other.
+ * The slot in the middle holds the latest published snapshot, and is swapped in by the consumer.
+ */
+struct RenderSnapshotBuffer {
+    struct RenderSnapshot slots[3];
+    atomic_uint middle;     // Index of the latest published slot, with RENDER_SNAPSHOT_FRESH set until it is acquired
+    unsigned int back;      // Slot that is being written, only used by the producer
+    unsigned int front;     // Slot that is being read, only used by the consumer
+};
+
+/**
+ * Initialize an empty snapshot buffer
+ */
+void initializeRenderSnapshotBuffer(struct RenderSnapshotBuffer *buffer);
+
+/**
+ * Get the slot to fill with the next snapshot (producer side)
+ */
+struct RenderSnapshot* getRenderSnapshotBackSlot(struct RenderSnapshotBuffer *buffer);
+
+/**
+ * Publish the filled slot as the latest snapshot (producer side)
+ */
+void publishRenderSnapshot(struct RenderSnapshotBuffer *buffer);
+
+/**
+ * Get the latest published snapshot (consumer side). Returns NULL if nothing was published since
+ * the last call. The snapshot stays valid until the next acquire
+ */
+struct RenderSnapshot* acquireRenderSnapshot(struct RenderSnapshotBuffer *buffer);
+
+/**
+ * Copy the selected track to a snapshot. The steps on the other pages are not drawn, so they are skipped
+ */
+void copyRenderSnapshotTrack(struct RenderSnapshot *snapshot, const struct Track *track);
+
+/**
+ * Get the regions (RENDER_REGION_*) that changed between the drawn snapshot and the next one.
+ * Anything other than the playhead moving requires the whole frame to be drawn again
+ */
+int getDirtyRenderRegions(const struct RenderSnapshot *drawn, const struct RenderSnapshot *next);
+
+#endif
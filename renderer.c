@@ -0,0 +1,141 @@
+#include <SDL.h>
+#include "renderer.h"
+#include "colors.h"
+#include "constants.h"
+#include "drawing.h"
+#include "drawing_components.h"
+#include "drawing_text.h"
+#include "programs/sequencer.h"
+#include "programs/track_selection.h"
+#include "programs/pattern_selection.h"
+#include "programs/sequence_selection.h"
+#include "programs/config_selection.h"
+#include "programs/program_selection.h"
+#include "programs/track_options.h"
+#include "programs/four_on_the_floor.h"
+#include "programs/pattern_options.h"
+
+/**
+ * Draw a complete frame in the render target
+ */
+static void drawFrame(struct RenderSnapshot *snapshot) {
+    // Clear the render target
+    clearScreen(COLOR_BLACK);
+
+    // BPM Blinker:
+    drawBPMBlinker(&snapshot->ppqnCounter);
+
+    // Sidebar:
+    drawSideBar();
+    drawCurrentTrackIndicator(
+        snapshot->selectedSequence + 1,
+        snapshot->selectedPattern + 1,
+        snapshot->selectedTrack + 1
+    );
+    drawBPMIndiciator(snapshot->bpm);
+    drawPatternLengthIndicator(
+        snapshot->patternStepCounter, 
+        snapshot->patternLength
+    );
+
+    // Basic Grid:
+    drawBasicGrid(snapshot->heldModifiers);
+    
+    // Render proper screen / program / menu:
+    switch (snapshot->screen) {
+        case BLIPR_SCREEN_TRACK_SELECTION:
+            drawTrackSelection(&snapshot->selectedTrack);    
+            break;
+        case BLIPR_SCREEN_PATTERN_SELECTION:
+            drawPatternSelection(&snapshot->selectedPattern, &snapshot->queuedPattern);
+            break;
+        case BLIPR_SCREEN_SEQUENCE_SELECTION:
+            drawSequenceSelection(&snapshot->selectedSequence);
+            break;
+        case BLIPR_SCREEN_CONFIGURATION:
+            drawConfigSelection(&snapshot->config);    
+            break;
+        case BLIPR_SCREEN_TRACK_OPTIONS:
+            drawTrackOptions(&snapshot->track);
+            break;
+        case BLIPR_SCREEN_PROGRAM_SELECTION:
+            drawProgramSelection(&snapshot->track);
+            break;
+        case BLIPR_SCREEN_PATTERN_OPTIONS:
+            // No sequence options required?
+            drawPatternOptions(&snapshot->pattern);
+            break;
+        case BLIPR_SCREEN_UTILITIES:
+            // Is this used?
+            drawCenteredLine(2, 61, "(UTILITIES)", TITLE_WIDTH, COLOR_WHITE);
+            break;
+        case BLIPR_SCREEN_TRANSPORT:
+            drawCenteredLine(2, 61, "(TRANSPORT)", TITLE_WIDTH, COLOR_WHITE);
+            drawCenteredLine(2, 73, snapshot->isFillActive ? "1: FILL ON" : "1: FILL OFF", TITLE_WIDTH, COLOR_WHITE);
+            break;
+        case BLIPR_SCREEN_NO_PROGRAM:
+            drawCenteredLine(2, 61, "(NO PROGRAM)", TITLE_WIDTH, COLOR_WHITE);
+            break;
+        case BLIPR_SCREEN_SEQUENCER: 
+        case BLIPR_SCREEN_DRUMKIT_SEQUENCER:
+            drawSequencer(
+                &snapshot->ppqnCounter, 
+                snapshot->heldModifiers, 
+                &snapshot->track,
+                &snapshot->editor,
+                snapshot->transitionMask,
+                snapshot->screen == BLIPR_SCREEN_DRUMKIT_SEQUENCER
+            );
+            break;
+        case BLIPR_SCREEN_FOUR_ON_THE_FLOOR:
+            drawFourOnTheFloor(&snapshot->ppqnCounter, &snapshot->track);
+            break;
+        default:
+            // Should not happen, but just in case
+            drawCenteredLine(2, 61, "(NO SCREEN)", TITLE_WIDTH, COLOR_WHITE);
+            break;
+    }
+}
+
+/**
+ * Draw only the regions that changed since the last frame, the rest of the render target is kept
+ */
+static void drawDirtyRegions(struct RenderSnapshot *snapshot, int regions) {
+    if (regions & RENDER_REGION_BORDER) {
+        drawBPMBlinker(&snapshot->ppqnCounter);
+    }
+
+    if (regions & RENDER_REGION_PATTERN_LENGTH) {
+        drawPatternLengthIndicator(snapshot->patternStepCounter, snapshot->patternLength);
+    }
+
+    if (regions & RENDER_REGION_PLAYHEAD) {
+        switch (snapshot->screen) {
+            case BLIPR_SCREEN_SEQUENCER: 
+            case BLIPR_SCREEN_DRUMKIT_SEQUENCER:
+                drawSequencerPlayhead(
+                    &snapshot->ppqnCounter, 
+                    snapshot->heldModifiers, 
+                    &snapshot->track,
+                    &snapshot->editor,
+                    snapshot->transitionMask,
+                    snapshot->screen == BLIPR_SCREEN_DRUMKIT_SEQUENCER
+                );
+                break;
+            case BLIPR_SCREEN_FOUR_ON_THE_FLOOR:
+                drawFourOnTheFloorFoot(&snapshot->ppqnCounter);
+                break;
+            default:
+                // Menus do not follow the playhead
+                break;
+        }
+    }
+}
+
+void drawRenderSnapshot(struct RenderSnapshot *snapshot, int regions) {
+    if (regions == RENDER_REGION_ALL) {
+        drawFrame(snapshot);
+    } else {
+        drawDirtyRegions(snapshot, regions);
+    }
+}
@@ -0,0 +1,13 @@
+#ifndef RENDERER_H
+#define RENDERER_H
+
+#include "render_snapshot.h"
+
+/**
+ * Draw the regions (RENDER_REGION_*) of a snapshot in the render target.
+ * With RENDER_REGION_ALL the complete frame is drawn, otherwise the rest of the render target should
+ * still contain the frame of the previous snapshot
+ */
+void drawRenderSnapshot(struct RenderSnapshot *snapshot, int regions);
+
+#endif
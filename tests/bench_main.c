@@ -0,0 +1,37 @@
+#include <SDL.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+// Globals that are required for compiling (but not used in the benchmarks):
+SDL_Renderer *renderer = NULL;
+bool isMidiDataLogged = false;
+
+// --- Measurement methods:
+
+uint64_t getBenchmarkTimeNs() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000LL + (uint64_t)now.tv_nsec;
+}
+
+void printBenchmark(const char *name, uint64_t elapsedNs, uint64_t iterations) {
+    printf("%-48s %10.1f ns\n", name, (double)elapsedNs / iterations);
+}
+
+#include "sequencer_bench.c"
+#include "file_handling_bench.c"
+
+/**
+ * Entry point
+ */
+int main(void)
+{
+    printf("blipr benchmarks\n\n");
+
+    benchmarkSequencer();
+    benchmarkFileHandling();
+
+    printf("\n");
+}
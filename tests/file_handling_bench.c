@@ -0,0 +1,93 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "../file_handling.h"
+#include "../project.h"
+
+#define BENCHMARK_PROJECT_FILE "/tmp/blipr_bench.blipr"
+#define BENCHMARK_VERSION_1_FILE "/tmp/blipr_bench_v1.blipr"
+
+/**
+ * Write a project in the version 1 format (the whole project, without a header)
+ */
+static void writeVersion1ProjectFile(const struct Project *project, const char *fileName) {
+    FILE *file = fopen(fileName, "wb");
+    unsigned char *arr = malloc(PROJECT_BYTE_SIZE);
+    projectToByteArray(project, arr);
+    fwrite(arr, PROJECT_BYTE_SIZE, 1, file);
+    fclose(file);
+    free(arr);
+}
+
+/**
+ * Read and decode the whole version 1 project file, like the loader did before patterns were loaded on demand
+ */
+static struct Project* readFullProjectFile(const char *fileName) {
+    FILE *file = fopen(fileName, "rb");
+    unsigned char *arr = malloc(PROJECT_BYTE_SIZE);
+    size_t bytesRead = fread(arr, 1, PROJECT_BYTE_SIZE, file);
+    fclose(file);
+    struct Project *project = NULL;
+    if (bytesRead == PROJECT_BYTE_SIZE) {
+        project = malloc(sizeof(struct Project));
+        byteArrayToProject(project, arr);
+    }
+    free(arr);
+    return project;
+}
+
+/**
+ * Get the size of a file in bytes
+ */
+static long getBenchmarkFileSize(const char *fileName) {
+    FILE *file = fopen(fileName, "rb");
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fclose(file);
+    return size;
+}
+
+void benchmarkFileHandling() {
+    // A small song: 4 patterns with 4 tracks of 16 notes each:
+    struct Project *project = malloc(sizeof(struct Project));
+    initializeProject(project);
+    for (int p = 0; p < 4; p++) {
+        for (int t = 0; t < 4; t++) {
+            for (int s = 0; s < 16; s++) {
+                struct Note *note = &project->sequences[0].patterns[p].tracks[t].steps[s].notes[0];
+                note->enabled = true;
+                note->note = 36 + s;
+                note->velocity = 100;
+            }
+        }
+    }
+    writeVersion1ProjectFile(project, BENCHMARK_VERSION_1_FILE);
+    writeProjectFile(project, BENCHMARK_PROJECT_FILE);
+    free(project);
+    printf("project file size: %ld bytes (version 1: %ld bytes)\n", 
+        getBenchmarkFileSize(BENCHMARK_PROJECT_FILE), 
+        getBenchmarkFileSize(BENCHMARK_VERSION_1_FILE)
+    );
+
+    // Time until the first pattern can be played:
+    uint64_t startNs = getBenchmarkTimeNs();
+    project = readFullProjectFile(BENCHMARK_VERSION_1_FILE);
+    printBenchmark("load version 1 project (decode everything)", getBenchmarkTimeNs() - startNs, 1);
+
+    startNs = getBenchmarkTimeNs();
+    struct Project *lazyProject = readProjectFile(BENCHMARK_PROJECT_FILE, NULL);
+    printBenchmark("load project (mapped, first pattern)", getBenchmarkTimeNs() - startNs, 1);
+
+    startNs = getBenchmarkTimeNs();
+    loadPattern(lazyProject, 0, 3);
+    printBenchmark("load another pattern on first access", getBenchmarkTimeNs() - startNs, 1);
+
+    startNs = getBenchmarkTimeNs();
+    loadPattern(lazyProject, 7, 7);
+    printBenchmark("load an empty pattern on first access", getBenchmarkTimeNs() - startNs, 1);
+
+    closeProjectFile();
+    free(project);
+    free(lazyProject);
+    remove(BENCHMARK_PROJECT_FILE);
+    remove(BENCHMARK_VERSION_1_FILE);
+}
@@ -0,0 +1,440 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include "../file_handling.h"
+#include "../project.h"
+#include "../journal.h"
+
+#define TEST_PROJECT_FILE "/tmp/blipr_test.blipr"
+#define TEST_JOURNALED_FILE "/tmp/blipr_test.bin"
+#define TEST_UNWRITABLE_FILE "/tmp/blipr_test_missing/blipr_test.blipr"
+
+void testReadProjectFileLoadsPatternsOnDemand() {
+    struct Project *project = malloc(sizeof(struct Project));
+    initializeProject(project);
+    strcpy(project->name, "Lazy Project");
+    project->sequences[3].patterns[5].bpm = 99;
+    project->sequences[3].patterns[5].tracks[7].steps[11].notes[2].note = 42;
+    writeProjectFile(project, TEST_PROJECT_FILE);
+    free(project);
+
+    project = readProjectFile(TEST_PROJECT_FILE, NULL);
+    assert(project != NULL);
+    assert(strcmp(project->name, "Lazy Project") == 0);
+    assert(strcmp(project->sequences[3].name, "Sequence 4") == 0);
+    assert(strcmp(project->sequences[0].patterns[0].name, "Pattern 1") == 0);
+
+    loadPattern(project, 3, 5);
+    assert(project->sequences[3].patterns[5].bpm == 99);
+    assert(project->sequences[3].patterns[5].tracks[7].steps[11].notes[2].note == 42);
+
+    // Saving loads the other patterns first, so nothing gets lost:
+    writeProjectFile(project, TEST_PROJECT_FILE);
+    free(project);
+    project = readProjectFile(TEST_PROJECT_FILE, NULL);
+    loadPattern(project, 3, 5);
+    assert(project->sequences[3].patterns[5].tracks[7].steps[11].notes[2].note == 42);
+
+    closeProjectFile();
+    free(project);
+    remove(TEST_PROJECT_FILE);
+}
+
+void testDecodePatternLeavesProjectAlone() {
+    struct Project *project = malloc(sizeof(struct Project));
+    initializeProject(project);
+    project->sequences[1].patterns[2].tracks[3].steps[4].notes[0].note = 77;
+    writeProjectFile(project, TEST_PROJECT_FILE);
+    free(project);
+
+    project = readProjectFile(TEST_PROJECT_FILE, NULL);
+    assert(project != NULL);
+    project->sequences[1].patterns[2].tracks[3].steps[4].notes[0].note = 1;
+
+    // The pattern is decoded in the buffer, the project only changes when it is stored:
+    struct Pattern *decodedPattern = malloc(sizeof(struct Pattern));
+    assert(decodePattern(1, 2, decodedPattern));
+    assert(decodedPattern->tracks[3].steps[4].notes[0].note == 77);
+    assert(project->sequences[1].patterns[2].tracks[3].steps[4].notes[0].note == 1);
+    storeDecodedPattern(project, 1, 2, decodedPattern);
+    assert(project->sequences[1].patterns[2].tracks[3].steps[4].notes[0].note == 77);
+
+    // A loaded pattern is not decoded or stored again, so edits are kept:
+    project->sequences[1].patterns[2].tracks[3].steps[4].notes[0].note = 2;
+    assert(!decodePattern(1, 2, decodedPattern));
+    storeDecodedPattern(project, 1, 2, decodedPattern);
+    loadPattern(project, 1, 2);
+    assert(project->sequences[1].patterns[2].tracks[3].steps[4].notes[0].note == 2);
+
+    closeProjectFile();
+    free(decodedPattern);
+    free(project);
+    remove(TEST_PROJECT_FILE);
+}
+
+void testSaveDirtyRegionsWritesOnlyChanges() {
+    struct Project *project = malloc(sizeof(struct Project));
+    initializeProject(project);
+    writeProjectFile(project, TEST_PROJECT_FILE);
+    free(project);
+
+    project = readProjectFile(TEST_PROJECT_FILE, NULL);
+    loadPattern(project, 2, 3);
+    struct Pattern *pattern = &project->sequences[2].patterns[3];
+    strcpy(project->name, "Saved Project");
+    project->isDirty = true;
+    pattern->bpm = 33;
+    pattern->isDirty = true;
+    pattern->tracks[4].steps[5].notes[0].note = 64;
+    pattern->tracks[4].isDirty = true;
+    loadPattern(project, 2, 4);
+    project->sequences[2].patterns[4].tracks[6].steps[5].notes[0].note = 65;    // Not marked as dirty, so not saved
+
+    // The file header and one pattern (its header and a single note):
+    struct SaveStats stats = saveDirtyRegions(project, TEST_PROJECT_FILE, NULL);
+    assert(stats.regions == 2);
+    assert(stats.bytes == PATTERN_DATA_OFFSET + SMALL_HEADER_BYTE_SIZE + 2 + SMALL_HEADER_BYTE_SIZE + 2 + SPARSE_NOTE_BYTE_SIZE);
+    assert(pattern->tracks[4].isDirty == false);
+
+    // Nothing changed since:
+    stats = saveDirtyRegions(project, TEST_PROJECT_FILE, NULL);
+    assert(stats.regions == 0);
+
+    closeProjectFile();
+    free(project);
+    project = readProjectFile(TEST_PROJECT_FILE, NULL);
+    loadPattern(project, 2, 3);
+    pattern = &project->sequences[2].patterns[3];
+    assert(strcmp(project->name, "Saved Project") == 0);
+    assert(pattern->bpm == 33);
+    assert(pattern->tracks[4].steps[5].notes[0].note == 64);
+    loadPattern(project, 2, 4);
+    assert(project->sequences[2].patterns[4].tracks[6].steps[5].notes[0].note == 0);
+
+    closeProjectFile();
+    free(project);
+    remove(TEST_PROJECT_FILE);
+}
+
+/**
+ * Check if a pattern or one of its tracks is marked as changed
+ */
+static bool isPatternDirtyForTest(const struct Pattern *pattern) {
+    bool isDirty = pattern->isDirty;
+    for (int t = 0; t < 16; t++) {
+        isDirty = isDirty || pattern->tracks[t].isDirty;
+    }
+    return isDirty;
+}
+
+void testFailedSaveKeepsChanges() {
+    struct Project *project = malloc(sizeof(struct Project));
+    initializeProject(project);
+    writeProjectFile(project, TEST_PROJECT_FILE);
+    free(project);
+
+    project = readProjectFile(TEST_PROJECT_FILE, NULL);
+    loadPattern(project, 0, 1);
+    struct Pattern *pattern = &project->sequences[0].patterns[1];
+    pattern->tracks[2].steps[3].notes[0].note = 62;
+    pattern->tracks[2].isDirty = true;
+    project->isDirty = true;
+
+    // The directory does not exist, so nothing is written and the changes stay dirty:
+    assert(saveDirtyRegions(project, TEST_UNWRITABLE_FILE, NULL).regions == 0);
+    assert(isPatternDirtyForTest(pattern));
+    assert(project->isDirty == true);
+
+    // They are saved the next time:
+    assert(saveDirtyRegions(project, TEST_PROJECT_FILE, NULL).regions == 2);
+    assert(!isPatternDirtyForTest(pattern));
+    closeProjectFile();
+    free(project);
+    project = readProjectFile(TEST_PROJECT_FILE, NULL);
+    loadPattern(project, 0, 1);
+    assert(project->sequences[0].patterns[1].tracks[2].steps[3].notes[0].note == 62);
+
+    closeProjectFile();
+    free(project);
+    remove(TEST_PROJECT_FILE);
+}
+
+/**
+ * Get the size of a file
+ */
+static long getFileSize(const char *fileName) {
+    FILE *file = fopen(fileName, "rb");
+    if (file == NULL) {
+        return -1;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fclose(file);
+    return size;
+}
+
+void testProjectFileOnlyStoresContent() {
+    struct Project *project = malloc(sizeof(struct Project));
+    initializeProject(project);
+    writeProjectFile(project, TEST_PROJECT_FILE);
+    assert(getFileSize(TEST_PROJECT_FILE) == PATTERN_DATA_OFFSET);
+
+    // 64 notes make the file grow with 64 times the size of a note (plus the headers and some room to grow):
+    struct Track *track = &project->sequences[1].patterns[2].tracks[3];
+    for (int s = 0; s < 64; s++) {
+        track->steps[s].notes[s % NOTES_IN_STEP].enabled = true;
+        track->steps[s].notes[s % NOTES_IN_STEP].note = s;
+    }
+    track->midiChannel = 9;
+    writeProjectFile(project, TEST_PROJECT_FILE);
+    long size = getFileSize(TEST_PROJECT_FILE);
+    assert(size > PATTERN_DATA_OFFSET + (64 * SPARSE_NOTE_BYTE_SIZE));
+    assert(size < 8192);
+    free(project);
+
+    project = readProjectFile(TEST_PROJECT_FILE, NULL);
+    loadPattern(project, 1, 2);
+    track = &project->sequences[1].patterns[2].tracks[3];
+    assert(track->midiChannel == 9);
+    assert(track->steps[10].notes[2].enabled == true);
+    assert(track->steps[10].notes[2].note == 10);
+    assert(track->steps[10].notes[3].enabled == false);
+    assert(track->noteMasks[2] == ((1ULL << 2) | (1ULL << 10) | (1ULL << 18) | (1ULL << 26) | (1ULL << 34) | (1ULL << 42) | (1ULL << 50) | (1ULL << 58)));
+    assert(strcmp(track->name, "Track 4") == 0);
+
+    // Edits that no longer fit move the pattern, the file stays readable:
+    for (int s = 0; s < 64; s++) {
+        for (int n = 0; n < NOTES_IN_STEP; n++) {
+            track->steps[s].notes[n].velocity = 100;
+        }
+    }
+    track->isDirty = true;
+    assert(saveDirtyRegions(project, TEST_PROJECT_FILE, NULL).regions == 2);
+    closeProjectFile();
+    free(project);
+    project = readProjectFile(TEST_PROJECT_FILE, NULL);
+    loadPattern(project, 1, 2);
+    track = &project->sequences[1].patterns[2].tracks[3];
+    assert(track->steps[63].notes[7].velocity == 100);
+    assert(track->steps[10].notes[2].note == 10);
+
+    closeProjectFile();
+    free(project);
+    remove(TEST_PROJECT_FILE);
+}
+
+void testReadVersion1ProjectFile() {
+    struct Project *project = malloc(sizeof(struct Project));
+    initializeProject(project);
+    strcpy(project->name, "Old Project");
+    project->sequences[15].patterns[15].tracks[15].steps[63].notes[7].note = 99;
+    unsigned char *arr = malloc(PROJECT_BYTE_SIZE);
+    projectToByteArray(project, arr);
+    FILE *file = fopen(TEST_PROJECT_FILE, "wb");
+    fwrite(arr, PROJECT_BYTE_SIZE, 1, file);
+    fclose(file);
+    free(arr);
+    free(project);
+
+    // The file is converted, the original is kept:
+    project = readProjectFile(TEST_PROJECT_FILE, NULL);
+    assert(project != NULL);
+    assert(strcmp(project->name, "Old Project") == 0);
+    assert(project->sequences[15].patterns[15].tracks[15].steps[63].notes[7].note == 99);
+    assert(getFileSize(TEST_PROJECT_FILE) < 8192);
+    assert(getFileSize(TEST_PROJECT_FILE ".v1") == PROJECT_BYTE_SIZE);
+    free(project);
+
+    project = readProjectFile(TEST_PROJECT_FILE, NULL);
+    loadPattern(project, 15, 15);
+    assert(project->sequences[15].patterns[15].tracks[15].steps[63].notes[7].note == 99);
+
+    closeProjectFile();
+    free(project);
+    remove(TEST_PROJECT_FILE);
+    remove(TEST_PROJECT_FILE ".v1");
+}
+
+void testReadOnlyProjectFileIsNeverWritten() {
+    struct Project *project = malloc(sizeof(struct Project));
+    initializeProject(project);
+    strcpy(project->name, "Old Project");
+    unsigned char *arr = malloc(PROJECT_BYTE_SIZE);
+    projectToByteArray(project, arr);
+    FILE *file = fopen(TEST_PROJECT_FILE, "wb");
+    fwrite(arr, PROJECT_BYTE_SIZE, 1, file);
+    fclose(file);
+    free(arr);
+    free(project);
+
+    // A version 1 file is only converted in memory:
+    remove(TEST_PROJECT_FILE ".v1");
+    project = readProjectFileReadOnly(TEST_PROJECT_FILE, NULL);
+    assert(project != NULL);
+    assert(strcmp(project->name, "Old Project") == 0);
+    assert(getFileSize(TEST_PROJECT_FILE) == PROJECT_BYTE_SIZE);
+    assert(getFileSize(TEST_PROJECT_FILE ".v1") == -1);
+    free(project);
+
+    // An interrupted save is left alone:
+    project = malloc(sizeof(struct Project));
+    initializeProject(project);
+    writeProjectFile(project, TEST_PROJECT_FILE);
+    long size = getFileSize(TEST_PROJECT_FILE);
+    unsigned char data[4] = {'b', 'l', 'i', 'p'};
+    struct JournalRegion region = {size + 16, 4, data};
+    remove(TEST_JOURNALED_FILE);
+    assert(writeRegionsJournaled(TEST_JOURNALED_FILE, &region, 1) == false);
+    rename(TEST_JOURNALED_FILE ".journal", TEST_PROJECT_FILE ".journal");
+    free(project);
+    project = readProjectFileReadOnly(TEST_PROJECT_FILE, NULL);
+    assert(project != NULL);
+    assert(getFileSize(TEST_PROJECT_FILE) == size);
+    assert(getFileSize(TEST_PROJECT_FILE ".journal") > 0);
+
+    closeProjectFile();
+    free(project);
+    remove(TEST_PROJECT_FILE);
+    remove(TEST_PROJECT_FILE ".journal");
+}
+
+void testDamagedProjectFileIsDetected() {
+    struct Project *project = malloc(sizeof(struct Project));
+    initializeProject(project);
+    project->sequences[0].patterns[1].tracks[0].steps[0].notes[0].note = 12;
+    writeProjectFile(project, TEST_PROJECT_FILE);
+    free(project);
+
+    // Damage the pattern data, the pattern is loaded empty:
+    FILE *file = fopen(TEST_PROJECT_FILE, "r+b");
+    fseek(file, PATTERN_DATA_OFFSET + 4, SEEK_SET);
+    fputc('!', file);
+    fclose(file);
+    project = readProjectFile(TEST_PROJECT_FILE, NULL);
+    assert(project != NULL);
+    loadPattern(project, 0, 1);
+    assert(project->sequences[0].patterns[1].tracks[0].steps[0].notes[0].note == 0);
+    closeProjectFile();
+    free(project);
+
+    // Damage the header, the file can not be read:
+    file = fopen(TEST_PROJECT_FILE, "r+b");
+    fseek(file, PATTERN_INDEX_OFFSET, SEEK_SET);
+    fputc('!', file);
+    fclose(file);
+    assert(readProjectFile(TEST_PROJECT_FILE, NULL) == NULL);
+
+    remove(TEST_PROJECT_FILE);
+}
+
+/**
+ * Read a whole file in a new buffer
+ */
+static unsigned char* readFileBytes(const char *fileName, long size) {
+    unsigned char *bytes = malloc(size);
+    FILE *file = fopen(fileName, "rb");
+    fread(bytes, 1, size, file);
+    fclose(file);
+    return bytes;
+}
+
+void testUnreadableProjectFileIsNeverReplaced() {
+    struct Project *project = malloc(sizeof(struct Project));
+    initializeProject(project);
+    project->sequences[2].patterns[3].tracks[4].steps[5].notes[0].note = 64;
+    writeProjectFile(project, TEST_PROJECT_FILE);
+    free(project);
+
+    // Damage the header:
+    FILE *file = fopen(TEST_PROJECT_FILE, "r+b");
+    fseek(file, PATTERN_INDEX_OFFSET + 2, SEEK_SET);
+    fputc('!', file);
+    fclose(file);
+    long size = getFileSize(TEST_PROJECT_FILE);
+    unsigned char *damagedBytes = readFileBytes(TEST_PROJECT_FILE, size);
+
+    ProjectFileStatus status;
+    assert(readProjectFile(TEST_PROJECT_FILE, &status) == NULL);
+    assert(status == PROJECT_FILE_DAMAGED);
+    assert(openProjectFile(TEST_PROJECT_FILE) == NULL);
+    assert(getFileSize(TEST_PROJECT_FILE) == size);
+    unsigned char *bytes = readFileBytes(TEST_PROJECT_FILE, size);
+    assert(memcmp(bytes, damagedBytes, size) == 0);
+    free(bytes);
+    free(damagedBytes);
+
+    // A file of a newer version:
+    file = fopen(TEST_PROJECT_FILE, "r+b");
+    fseek(file, 4, SEEK_SET);
+    fputc(PROJECT_FILE_VERSION + 1, file);
+    fclose(file);
+    assert(readProjectFile(TEST_PROJECT_FILE, &status) == NULL);
+    assert(status == PROJECT_FILE_UNSUPPORTED);
+    assert(openProjectFile(TEST_PROJECT_FILE) == NULL);
+    assert(getFileSize(TEST_PROJECT_FILE) == size);
+
+    // Only a missing file is created:
+    remove(TEST_PROJECT_FILE);
+    assert(readProjectFile(TEST_PROJECT_FILE, &status) == NULL);
+    assert(status == PROJECT_FILE_MISSING);
+    project = openProjectFile(TEST_PROJECT_FILE);
+    assert(project != NULL);
+    assert(getFileSize(TEST_PROJECT_FILE) == PATTERN_DATA_OFFSET);
+
+    closeProjectFile();
+    free(project);
+    remove(TEST_PROJECT_FILE);
+}
+
+void testRecoverJournalCompletesInterruptedWrite() {
+    remove(TEST_JOURNALED_FILE);
+    unsigned char data[4] = {'b', 'l', 'i', 'p'};
+    struct JournalRegion region = {2, 4, data};
+
+    // The file can not be written, so the changes stay in the journal:
+    assert(writeRegionsJournaled(TEST_JOURNALED_FILE, &region, 1) == false);
+
+    FILE *file = fopen(TEST_JOURNALED_FILE, "wb");
+    fwrite("--------", 1, 8, file);
+    fclose(file);
+    recoverJournal(TEST_JOURNALED_FILE);
+
+    char contents[9] = {0};
+    file = fopen(TEST_JOURNALED_FILE, "rb");
+    fread(contents, 1, 8, file);
+    fclose(file);
+    assert(strcmp(contents, "--blip--") == 0);
+    assert(fopen(TEST_JOURNALED_FILE ".journal", "rb") == NULL);
+
+    // An incomplete journal is discarded:
+    file = fopen(TEST_JOURNALED_FILE ".journal", "wb");
+    fwrite("BLPJ", 1, 4, file);
+    fwrite(data, 1, 4, file);
+    fwrite(data, 1, 4, file);
+    fwrite(data, 1, 4, file);
+    fclose(file);
+    recoverJournal(TEST_JOURNALED_FILE);
+    file = fopen(TEST_JOURNALED_FILE, "rb");
+    fread(contents, 1, 8, file);
+    fclose(file);
+    assert(strcmp(contents, "--blip--") == 0);
+    assert(fopen(TEST_JOURNALED_FILE ".journal", "rb") == NULL);
+
+    remove(TEST_JOURNALED_FILE);
+}
+
+/// --- Entry point
+
+void testFileHandling() {
+    testReadProjectFileLoadsPatternsOnDemand();
+    testDecodePatternLeavesProjectAlone();
+    testSaveDirtyRegionsWritesOnlyChanges();
+    testFailedSaveKeepsChanges();
+    testProjectFileOnlyStoresContent();
+    testReadVersion1ProjectFile();
+    testReadOnlyProjectFileIsNeverWritten();
+    testDamagedProjectFileIsDetected();
+    testUnreadableProjectFileIsNeverReplaced();
+    testRecoverJournalCompletesInterruptedWrite();
+}
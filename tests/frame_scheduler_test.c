@@ -0,0 +1,71 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "../frame_scheduler.h"
+#include "../constants.h"
+
+#define NANOS_PER_FRAME (NANOS_PER_SEC / 50)
+
+void testFrameSchedulerCoalescesFrames() {
+    struct FrameScheduler scheduler;
+    initializeFrameScheduler(&scheduler, 50, 1000);
+
+    // The first frame is due right away:
+    assert(getFrameTimeoutMs(&scheduler, 1000) == 0);
+    assert(isFrameDue(&scheduler, 1000));
+
+    // Everything until the next frame waits for it:
+    assert(!isFrameDue(&scheduler, 1000 + NANOS_PER_FRAME / 2));
+    assert(getFrameTimeoutMs(&scheduler, 1000 + NANOS_PER_FRAME / 2) == 10);
+    assert(getFrameTimeoutMs(&scheduler, 1001 + NANOS_PER_FRAME / 2) == 10);
+    assert(isFrameDue(&scheduler, 1000 + NANOS_PER_FRAME));
+
+    // Frames stay on the grid when they are drawn a bit late:
+    assert(isFrameDue(&scheduler, 1000 + NANOS_PER_FRAME * 2 + 300));
+    assert(!isFrameDue(&scheduler, 1000 + NANOS_PER_FRAME * 3 - 1));
+    assert(isFrameDue(&scheduler, 1000 + NANOS_PER_FRAME * 3));
+
+    // Missed frames are dropped, instead of drawn in a burst:
+    uint64_t lateNs = 1000 + NANOS_PER_FRAME * 10 + 5;
+    assert(isFrameDue(&scheduler, lateNs));
+    assert(!isFrameDue(&scheduler, lateNs + NANOS_PER_FRAME - 1));
+    assert(isFrameDue(&scheduler, lateNs + NANOS_PER_FRAME));
+}
+
+void testFrameSchedulerWithoutLimit() {
+    struct FrameScheduler scheduler;
+    initializeFrameScheduler(&scheduler, 0, 1000);
+    for (uint64_t i = 0; i < 10; i++) {
+        assert(isFrameDue(&scheduler, 1000 + i));
+
+        // Never spin, wait for the next snapshot:
+        assert(getFrameTimeoutMs(&scheduler, 1000 + i) == FRAME_IDLE_TIMEOUT_MS);
+    }
+}
+
+void testFrameTimeHistogram() {
+    assert(getFrameTimeBucket(0) == 0);
+    assert(getFrameTimeBucket(999999) == 0);
+    assert(getFrameTimeBucket(1000000) == 1);
+    assert(getFrameTimeBucket(3999999) == 2);
+    assert(getFrameTimeBucket(16000000) == 5);
+    assert(getFrameTimeBucket(NANOS_PER_SEC) == FRAME_TIME_BUCKETS - 1);
+
+    struct FrameStats stats;
+    resetFrameStats(&stats);
+    recordFrameTime(&stats, 500000);
+    recordFrameTime(&stats, 700000);
+    recordFrameTime(&stats, 5000000);
+    recordSkippedFrame(&stats);
+    assert(stats.drawnFrames == 3 && stats.skippedFrames == 1);
+    assert(stats.histogram[0] == 2 && stats.histogram[3] == 1);
+    assert(stats.maxFrameTimeNs == 5000000);
+}
+
+/// --- Entry point
+
+void testFrameScheduler() {
+    testFrameSchedulerCoalescesFrames();
+    testFrameSchedulerWithoutLimit();
+    testFrameTimeHistogram();
+}
@@ -0,0 +1,71 @@
+#include <stdio.h>
+#include <stdbool.h>
+#include "../framebuffer.h"
+#include "../drawing.h"
+
+static SDL_Color testFramebufferColor = {0x12, 0x34, 0x56, 0xFF};
+static SDL_Color testFramebufferBackground = {0x00, 0x00, 0x00, 0xFF};
+
+/**
+ * Count the pixels with the test color in a region of the framebuffer
+ */
+static int countFramebufferPixels(int x, int y, int width, int height) {
+    uint32_t pixel = getFramebufferPixel(testFramebufferColor);
+    int count = 0;
+    for (int row = y; row < y + height; row++) {
+        for (int column = x; column < x + width; column++) {
+            count += framebuffer[row * WIDTH + column] == pixel;
+        }
+    }
+    return count;
+}
+
+void testFramebufferRectsAreClipped() {
+    clearFramebuffer(testFramebufferBackground);
+    fillFramebufferRect(-2, -3, 5, 5, testFramebufferColor);
+    assert(countFramebufferPixels(0, 0, WIDTH, HEIGHT) == 3 * 2);
+    fillFramebufferRect(WIDTH - 1, HEIGHT - 1, 10, 10, testFramebufferColor);
+    assert(countFramebufferPixels(0, 0, WIDTH, HEIGHT) == 3 * 2 + 1);
+    fillFramebufferRect(10, 10, 0, 5, testFramebufferColor);
+    assert(countFramebufferPixels(0, 0, WIDTH, HEIGHT) == 3 * 2 + 1);
+}
+
+void testFramebufferDrawsTheSamePrimitivesAsTheRenderer() {
+    isFramebufferUsed = true;
+
+    // Outlines only draw the edge:
+    clearScreen(testFramebufferBackground);
+    drawRectOutline(10, 10, 6, 5, 1, testFramebufferColor);
+    assert(countFramebufferPixels(0, 0, WIDTH, HEIGHT) == 6 + 6 + 3 + 3);
+    assert(countFramebufferPixels(11, 11, 4, 3) == 0);
+
+    // Lines include both end points:
+    clearScreen(testFramebufferBackground);
+    drawLine(20, 5, 10, 5, testFramebufferColor);
+    assert(countFramebufferPixels(10, 5, 11, 1) == 11);
+    drawLine(0, 10, 4, 14, testFramebufferColor);
+    assert(countFramebufferPixels(0, 10, 5, 5) == 5);
+    assert(countFramebufferPixels(4, 14, 1, 1) == 1);
+
+    // Glyphs only draw their set pixels:
+    clearScreen(testFramebufferBackground);
+    const int mask[] = {1, 0, 1, 0, 1, 0};
+    blitFramebufferMask(30, 30, mask, 3, 2, testFramebufferColor);
+    assert(countFramebufferPixels(30, 30, 3, 2) == 3);
+    assert(countFramebufferPixels(31, 31, 1, 1) == 1);
+
+    // Pixels without alpha are transparent:
+    const uint32_t pixels[] = {getFramebufferPixel(testFramebufferColor), 0};
+    blitFramebufferPixels(40, 40, pixels, 2, 1, 2);
+    assert(countFramebufferPixels(40, 40, 1, 1) == 1);
+    assert(framebuffer[40 * WIDTH + 41] == getFramebufferPixel(testFramebufferBackground));
+
+    isFramebufferUsed = false;
+}
+
+/// --- Entry point
+
+void testFramebuffer() {
+    testFramebufferRectsAreClipped();
+    testFramebufferDrawsTheSamePrimitivesAsTheRenderer();
+}
@@ -0,0 +1,58 @@
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include "../headless.h"
+
+#define TEST_SNAPSHOT_FILE "/tmp/blipr_test.ppm"
+
+void testHeadlessCommandsAreParsed() {
+    struct HeadlessCommand command;
+
+    assert(parseHeadlessCommand("down SHIFT3\n", &command));
+    assert(command.type == HEADLESS_COMMAND_KEY_DOWN && command.scancode == BLIPR_KEY_SHIFT_3);
+    assert(parseHeadlessCommand("  press 16", &command));
+    assert(command.type == HEADLESS_COMMAND_KEY_PRESS && command.scancode == BLIPR_KEY_16);
+    assert(parseHeadlessCommand("render 100\n", &command));
+    assert(command.type == HEADLESS_COMMAND_RENDER && command.count == 100);
+    assert(command.budgetUs == 0);
+    assert(parseHeadlessCommand("render 50 16000\n", &command));
+    assert(command.type == HEADLESS_COMMAND_RENDER && command.count == 50 && command.budgetUs == 16000);
+    assert(parseHeadlessCommand("snapshot out/sequencer.ppm\n", &command));
+    assert(command.type == HEADLESS_COMMAND_SNAPSHOT && strcmp(command.path, "out/sequencer.ppm") == 0);
+
+    // Empty lines & comments do nothing:
+    assert(parseHeadlessCommand("\n", &command) && command.type == HEADLESS_COMMAND_NONE);
+    assert(parseHeadlessCommand("# comment", &command) && command.type == HEADLESS_COMMAND_NONE);
+
+    // Mistakes in the script are reported:
+    assert(!parseHeadlessCommand("press 17", &command));
+    assert(!parseHeadlessCommand("press", &command));
+    assert(!parseHeadlessCommand("render 0", &command));
+    assert(!parseHeadlessCommand("render 50 -1", &command));
+    assert(!parseHeadlessCommand("press 1 100", &command));
+    assert(!parseHeadlessCommand("jump 1", &command));
+}
+
+void testHeadlessSnapshotIsWrittenAsPPM() {
+    const uint32_t pixels[] = {0xFF0000FF, 0x00FF00FF, 0x0000FFFF, 0x12345678};
+    assert(writeFramePPM(TEST_SNAPSHOT_FILE, pixels, 2, 2));
+
+    FILE *file = fopen(TEST_SNAPSHOT_FILE, "rb");
+    char header[16] = {0};
+    uint8_t rgb[12] = {0};
+    assert(fread(header, 1, 11, file) == 11);
+    assert(strcmp(header, "P6\n2 2\n255\n") == 0);
+    assert(fread(rgb, 1, sizeof(rgb), file) == sizeof(rgb));
+    fclose(file);
+    remove(TEST_SNAPSHOT_FILE);
+
+    const uint8_t expected[] = {0xFF, 0, 0, 0, 0xFF, 0, 0, 0, 0xFF, 0x12, 0x34, 0x56};
+    assert(memcmp(rgb, expected, sizeof(expected)) == 0);
+}
+
+/// --- Entry point
+
+void testHeadless() {
+    testHeadlessCommandsAreParsed();
+    testHeadlessSnapshotIsWrittenAsPPM();
+}
@@ -32,6 +32,15 @@ bool assert(bool value) {
 
 #include "project_test.c"
 #include "sequencer_test.c"
+#include "pulse_clock_test.c"
+#include "midi_test.c"
+#include "file_handling_test.c"
+#include "render_snapshot_test.c"
+#include "renderer_test.c"
+#include "framebuffer_test.c"
+#include "headless_test.c"
+#include "frame_scheduler_test.c"
+#include "midi_clock_test.c"
 
 /**
  * Entry point
@@ -42,6 +51,15 @@ int main(void)
 
     testProjectFile();
     testSequencer();
+    testPulseClock();
+    testMidi();
+    testFileHandling();
+    testRenderSnapshot();
+    testRenderer();
+    testFramebuffer();
+    testHeadless();
+    testFrameScheduler();
+    testMidiClock();
 
     printf("\n");
 }
\ No newline at end of file
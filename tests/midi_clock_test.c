@@ -0,0 +1,219 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+#include "../midi_clock.h"
+#include "../pulse_clock.h"
+#include "../constants.h"
+
+#define MIDI_CLOCK_TEST_START_NS 1000000000ULL
+#define MIDI_CLOCK_TEST_SETTLE_TICKS (PPQN * 2)     // Ticks before the loop is locked in
+
+/**
+ * Stability of the pulses that are scheduled on a jittery clock
+ */
+struct MidiClockJitterResult {
+    double maxPulseErrorNs;     // Largest distance between a pulse and its exact time
+    double rmsPulseErrorNs;
+    double maxIntervalErrorNs;  // Largest difference between the time between 2 pulses and the exact period
+    double maxTickJitterNs;     // Largest distance between a received tick and its exact time
+    int bpm;                    // Tempo at the end
+};
+
+/**
+ * Random jitter between -maxJitterNs and +maxJitterNs (deterministic)
+ */
+static int64_t getTestJitter(uint32_t *seed, int64_t maxJitterNs) {
+    *seed = *seed * 1664525u + 1013904223u;
+    return (int64_t)(*seed >> 8) % (2 * maxJitterNs + 1) - maxJitterNs;
+}
+
+/**
+ * Feed a clock at a tempo with jitter, and measure the pulses that are scheduled like the timer thread does
+ */
+static struct MidiClockJitterResult runMidiClockJitterTest(double bpm, int64_t maxJitterNs, int ticks, uint32_t seed) {
+    struct MidiClockJitterResult result = {0};
+    struct MidiClock midiClock;
+    struct PulseClock pulseClock;
+    initializeMidiClock(&midiClock);
+    initializePulseClock(&pulseClock, 0, 0);
+
+    double periodNs = 60.0 * NANOS_PER_SEC / (bpm * PPQN);
+    double squaredErrors = 0.0;
+    int measuredPulses = 0;
+    uint64_t previousDeadlineNs = 0;
+
+    processMidiClockMessage(&midiClock, MIDI_CLOCK_START, MIDI_CLOCK_TEST_START_NS);
+    for (int tick = 0; tick < ticks; tick++) {
+        double exactNs = MIDI_CLOCK_TEST_START_NS + tick * periodNs;
+        int64_t jitterNs = getTestJitter(&seed, maxJitterNs);
+        result.maxTickJitterNs = fmax(result.maxTickJitterNs, fabs((double)jitterNs));
+        processMidiClockMessage(&midiClock, MIDI_CLOCK_TICK, (uint64_t)(exactNs + jitterNs));
+
+        if (!isMidiClockLocked(&midiClock) || tick < MIDI_CLOCK_TEST_SETTLE_TICKS) {
+            continue;
+        }
+
+        // The pulses until the next tick follow the filtered clock:
+        syncPulseClockToMidiClock(&pulseClock, &midiClock, 0);
+        for (uint64_t pulse = pulseClock.anchorPulse + 1; pulse <= getMidiClockPulseLimit(&midiClock, 0); pulse++) {
+            uint64_t deadlineNs = getPulseDeadline(&pulseClock, pulse);
+            double exactPulseNs = MIDI_CLOCK_TEST_START_NS + (double)pulse * periodNs / PPQN_MULTIPLIER;
+            double errorNs = fabs((double)deadlineNs - exactPulseNs);
+            result.maxPulseErrorNs = fmax(result.maxPulseErrorNs, errorNs);
+            squaredErrors += errorNs * errorNs;
+            measuredPulses++;
+
+            if (previousDeadlineNs > 0) {
+                double intervalErrorNs = fabs((double)(deadlineNs - previousDeadlineNs) - periodNs / PPQN_MULTIPLIER);
+                result.maxIntervalErrorNs = fmax(result.maxIntervalErrorNs, intervalErrorNs);
+            }
+            previousDeadlineNs = deadlineNs;
+        }
+    }
+
+    result.rmsPulseErrorNs = sqrt(squaredErrors / measuredPulses);
+    result.bpm = getMidiClockBPM(&midiClock);
+    return result;
+}
+
+void testMidiClockSmoothsJitter() {
+    double bpms[] = {60, 120, 174.5};
+    for (size_t i = 0; i < ARRAY_LENGTH(bpms); i++) {
+        // Ticks are up to 1ms off:
+        struct MidiClockJitterResult result = runMidiClockJitterTest(bpms[i], 1000000, PPQN * 64, i + 1);
+        assert(result.bpm == (int)round(bpms[i]));
+        // The pulses are less than half of that off, and most of them a lot less:
+        assert(result.maxPulseErrorNs < result.maxTickJitterNs * 0.6);
+        assert(result.rmsPulseErrorNs < result.maxTickJitterNs * 0.2);
+        // And the time between 2 pulses hardly changes:
+        assert(result.maxIntervalErrorNs < result.maxTickJitterNs * 0.3);
+    }
+
+    // A clean clock is followed exactly (apart from rounding to whole nanoseconds):
+    struct MidiClockJitterResult result = runMidiClockJitterTest(120, 0, PPQN * 16, 1);
+    assert(result.maxPulseErrorNs < 2.0);
+}
+
+void testMidiClockFollowsTempoChanges() {
+    struct MidiClock midiClock;
+    initializeMidiClock(&midiClock);
+    processMidiClockMessage(&midiClock, MIDI_CLOCK_START, 0);
+
+    uint64_t timeNs = MIDI_CLOCK_TEST_START_NS;
+    for (int tick = 0; tick < PPQN * 8; tick++) {
+        processMidiClockMessage(&midiClock, MIDI_CLOCK_TICK, timeNs);
+        timeNs += NANOS_PER_SEC / 2 / PPQN;     // 120 BPM
+    }
+    assert(getMidiClockBPM(&midiClock) == 120);
+
+    // After 2 bars, the new tempo is followed:
+    for (int tick = 0; tick < PPQN * 8; tick++) {
+        processMidiClockMessage(&midiClock, MIDI_CLOCK_TICK, timeNs);
+        timeNs += NANOS_PER_SEC * 60 / 130 / PPQN;
+    }
+    assert(getMidiClockBPM(&midiClock) == 130);
+    assert(fabs(midiClock.tickTimeNs - (timeNs - NANOS_PER_SEC * 60 / 130 / PPQN)) < 100000);
+    assert(midiClock.ticks == PPQN * 16);
+}
+
+void testMidiClockCountsMissingTicks() {
+    struct MidiClock midiClock;
+    initializeMidiClock(&midiClock);
+    processMidiClockMessage(&midiClock, MIDI_CLOCK_START, 0);
+
+    for (int tick = 0; tick < PPQN * 4; tick++) {
+        if (tick % 10 != 9) {
+            processMidiClockMessage(&midiClock, MIDI_CLOCK_TICK, MIDI_CLOCK_TEST_START_NS + tick * 20000000ULL);
+        }
+    }
+    assert(midiClock.ticks == PPQN * 4);
+    assert(fabs(midiClock.periodNs - 20000000.0) < 1.0);
+}
+
+void testMidiClockTransport() {
+    struct MidiClock midiClock;
+    initializeMidiClock(&midiClock);
+    uint64_t timeNs = MIDI_CLOCK_TEST_START_NS;
+
+    // The tempo is followed while stopped, but nothing is played:
+    for (int tick = 0; tick < PPQN; tick++, timeNs += 20000000) {
+        processMidiClockMessage(&midiClock, MIDI_CLOCK_TICK, timeNs);
+    }
+    assert(!isMidiClockLocked(&midiClock));
+    assert(getMidiClockBPM(&midiClock) == 125);
+
+    // Start plays from the first tick after it:
+    processMidiClockMessage(&midiClock, MIDI_CLOCK_START, timeNs - 10000000);
+    assert(!isMidiClockLocked(&midiClock) && midiClock.starts == 1);
+    assert(getMidiClockPulseLimit(&midiClock, 100) == 100);
+    processMidiClockMessage(&midiClock, MIDI_CLOCK_TICK, timeNs);
+    assert(isMidiClockLocked(&midiClock));
+    assert(getMidiClockPulseLimit(&midiClock, 100) == 100 + PPQN_MULTIPLIER);
+
+    struct PulseClock pulseClock;
+    syncPulseClockToMidiClock(&pulseClock, &midiClock, 100);
+    assert(getPulseDeadline(&pulseClock, 100) == timeNs);
+    assert(getPulseDeadline(&pulseClock, 102) == timeNs + 10000000);
+
+    // Stop halts the clock, continue picks up the position from the next tick:
+    timeNs += 20000000;
+    processMidiClockMessage(&midiClock, MIDI_CLOCK_TICK, timeNs);
+    processMidiClockMessage(&midiClock, MIDI_CLOCK_STOP, timeNs + 1);
+    assert(!isMidiClockLocked(&midiClock));
+    timeNs += 1000000000;
+    processMidiClockMessage(&midiClock, MIDI_CLOCK_CONTINUE, timeNs - 1);
+    processMidiClockMessage(&midiClock, MIDI_CLOCK_TICK, timeNs);
+    assert(isMidiClockLocked(&midiClock) && midiClock.ticks == 3 && midiClock.starts == 1);
+    syncPulseClockToMidiClock(&pulseClock, &midiClock, 100);
+    assert(getPulseDeadline(&pulseClock, 100 + PPQN_MULTIPLIER * 2) == timeNs);
+
+    // Other messages are ignored:
+    uint64_t updates = midiClock.updates;
+    processMidiClockMessage(&midiClock, 0x90, timeNs);
+    assert(midiClock.updates == updates);
+}
+
+void testMidiClockKeepsPositionWhileStopped() {
+    struct MidiClock midiClock;
+    initializeMidiClock(&midiClock);
+    uint64_t timeNs = MIDI_CLOCK_TEST_START_NS;
+
+    processMidiClockMessage(&midiClock, MIDI_CLOCK_START, timeNs - 1);
+    for (int tick = 0; tick < PPQN; tick++, timeNs += 20000000) {
+        processMidiClockMessage(&midiClock, MIDI_CLOCK_TICK, timeNs);
+    }
+    assert(midiClock.ticks == PPQN);
+
+    // Masters keep sending ticks while stopped, they do not move the song position:
+    processMidiClockMessage(&midiClock, MIDI_CLOCK_STOP, timeNs - 1);
+    for (int tick = 0; tick < PPQN * 4; tick++, timeNs += 20000000) {
+        processMidiClockMessage(&midiClock, MIDI_CLOCK_TICK, timeNs);
+    }
+    assert(!isMidiClockLocked(&midiClock) && midiClock.ticks == PPQN);
+
+    // Continue plays on from where it stopped:
+    processMidiClockMessage(&midiClock, MIDI_CLOCK_CONTINUE, timeNs - 1);
+    processMidiClockMessage(&midiClock, MIDI_CLOCK_TICK, timeNs);
+    assert(isMidiClockLocked(&midiClock) && midiClock.ticks == PPQN + 1);
+    assert(getMidiClockPulseLimit(&midiClock, 100) == 100 + (PPQN + 1) * PPQN_MULTIPLIER);
+    struct PulseClock pulseClock;
+    syncPulseClockToMidiClock(&pulseClock, &midiClock, 100);
+    assert(getPulseDeadline(&pulseClock, 100 + PPQN * PPQN_MULTIPLIER) == timeNs);
+
+    // Only start goes back to the beginning:
+    timeNs += 20000000;
+    processMidiClockMessage(&midiClock, MIDI_CLOCK_START, timeNs - 1);
+    processMidiClockMessage(&midiClock, MIDI_CLOCK_TICK, timeNs);
+    assert(midiClock.ticks == 1 && midiClock.starts == 2);
+}
+
+/// --- Entry point
+
+void testMidiClock() {
+    testMidiClockSmoothsJitter();
+    testMidiClockFollowsTempoChanges();
+    testMidiClockCountsMissingTicks();
+    testMidiClockTransport();
+    testMidiClockKeepsPositionWhileStopped();
+}
@@ -0,0 +1,107 @@
+#include <stdio.h>
+#include <stdbool.h>
+#include "../midi.h"
+#include "../project.h"
+
+void testNoteTrackerSendsNoteOffsAfterLength() {
+    initializeNoteTracker();
+
+    struct Note note = {0};
+    note.note = 60;
+    addNoteToTracker(NULL, 0, &note, 3);
+    note.note = 62;
+    addNoteToTracker(NULL, 0, &note, 0);   // Shortest note, note off is sent the same pulse
+    assert(getActiveNoteCount() == 2);
+
+    updateNotesAndSendOffs(1);
+    assert(getActiveNoteCount() == 1);
+    updateNotesAndSendOffs(1);
+    assert(getActiveNoteCount() == 1);
+    updateNotesAndSendOffs(1);
+    assert(getActiveNoteCount() == 0);
+}
+
+void testNoteTrackerHandlesLengthsBeyondTheWheel() {
+    initializeNoteTracker();
+
+    struct Note note = {0};
+    note.note = 60;
+    addNoteToTracker(NULL, 0, &note, 257);
+
+    // Notes in the same wheel slot that are not due yet are kept:
+    updateNotesAndSendOffs(1);
+    assert(getActiveNoteCount() == 1);
+    note.note = 62;
+    addNoteToTracker(NULL, 0, &note, 256);
+    updateNotesAndSendOffs(255);
+    assert(getActiveNoteCount() == 2);
+    updateNotesAndSendOffs(1);
+    assert(getActiveNoteCount() == 0);
+}
+
+void testNoteTrackerStealsOldestVoice() {
+    initializeNoteTracker();
+
+    struct Note note = {0};
+    for (int i = 0; i < 600; i++) {
+        note.note = i / 16;
+        addNoteToTracker(NULL, i % 16, &note, 10);
+    }
+    assert(getActiveNoteCount() == 512);
+
+    // All stolen voices are gone, the rest still expires on time:
+    updateNotesAndSendOffs(9);
+    assert(getActiveNoteCount() == 512);
+    updateNotesAndSendOffs(1);
+    assert(getActiveNoteCount() == 0);
+}
+
+void testNoteTrackerRestartsRetriggeredNotes() {
+    initializeNoteTracker();
+
+    struct Note note = {0};
+    note.note = 42;
+    addNoteToTracker(NULL, 9, &note, 3);
+    updateNotesAndSendOffs(2);
+
+    // Same note on the same channel is restarted, the old note off is not sent:
+    addNoteToTracker(NULL, 9, &note, 3);
+    assert(getActiveNoteCount() == 1);
+    updateNotesAndSendOffs(2);
+    assert(getActiveNoteCount() == 1);
+    updateNotesAndSendOffs(1);
+    assert(getActiveNoteCount() == 0);
+
+    // A different channel is a different voice:
+    addNoteToTracker(NULL, 9, &note, 3);
+    addNoteToTracker(NULL, 10, &note, 3);
+    assert(getActiveNoteCount() == 2);
+}
+
+void testMidiClockEventsAreProcessed() {
+    struct MidiClock midiClock;
+    initializeMidiClock(&midiClock);
+    PmEvent events[4] = {
+        {Pm_Message(MIDI_CLOCK_START, 0, 0), 0},
+        {Pm_Message(0x90, 60, 100), 0},
+        {Pm_Message(MIDI_CLOCK_TICK, 0, 0), 0},
+        {Pm_Message(MIDI_CLOCK_STOP, 0, 0), 0},
+    };
+
+    // Only the clock messages update the clock:
+    processMidiClockEvents(&midiClock, events, 3, 1000000);
+    assert(midiClock.starts == 1 && midiClock.ticks == 1 && midiClock.isRunning);
+    assert(midiClock.updates == 2);
+    processMidiClockEvents(&midiClock, &events[3], 1, 2000000);
+    assert(!midiClock.isRunning && midiClock.updates == 3);
+}
+
+/// --- Entry point
+
+void testMidi() {
+    testNoteTrackerSendsNoteOffsAfterLength();
+    testNoteTrackerHandlesLengthsBeyondTheWheel();
+    testNoteTrackerStealsOldestVoice();
+    testNoteTrackerRestartsRetriggeredNotes();
+    testMidiClockEventsAreProcessed();
+}
@@ -1,6 +1,10 @@
 #include <stdio.h>
 #include <stdbool.h>
 #include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
 #include "../project.h"
 
 /// --- Note tests
@@ -31,9 +35,121 @@ void testByteArrayToNote() {
     assert(note.nudge == 0);
 }
 
+/// --- Project tests
+
+void testProjectRoundTrip() {
+    struct Project *project = malloc(sizeof(struct Project));
+    initializeProject(project);
+    strcpy(project->name, "Round Trip");
+    project->sequences[9].patterns[4].bpm = 140 - 45;
+    project->sequences[9].patterns[4].tracks[2].midiChannel = 10;
+    project->sequences[9].patterns[4].tracks[2].steps[17].notes[3].enabled = true;
+    project->sequences[9].patterns[4].tracks[2].steps[17].notes[3].note = 60;
+
+    unsigned char *arr = malloc(PROJECT_BYTE_SIZE);
+    projectToByteArray(project, arr);
+    struct Project *decoded = malloc(sizeof(struct Project));
+    byteArrayToProject(decoded, arr);
+
+    assert(strcmp(decoded->name, "Round Trip") == 0);
+    assert(decoded->sequences[9].patterns[4].bpm == 140 - 45);
+    assert(decoded->sequences[9].patterns[4].tracks[2].midiChannel == 10);
+    assert(decoded->sequences[9].patterns[4].tracks[2].steps[17].notes[3].enabled == true);
+    assert(decoded->sequences[9].patterns[4].tracks[2].steps[17].notes[3].note == 60);
+
+    // Encoding it again gives the same bytes:
+    unsigned char *encoded = malloc(PROJECT_BYTE_SIZE);
+    projectToByteArray(decoded, encoded);
+    assert(memcmp(arr, encoded, PROJECT_BYTE_SIZE) == 0);
+
+    free(encoded);
+    free(decoded);
+    free(arr);
+    free(project);
+}
+
+void testNoteMasksFollowNotes() {
+    struct Track *track = malloc(sizeof(struct Track));
+    initializeTrack(track, 0);
+    assert(getPlayingStepMask(track) == 0);
+
+    track->steps[5].notes[0].enabled = true;
+    track->steps[63].notes[6].enabled = true;
+    updateStepNoteMasks(track, 5);
+    updateStepNoteMasks(track, 63);
+    assert(track->noteMasks[0] == 1ULL << 5);
+    assert(track->noteMasks[6] == 1ULL << 63);
+    assert(getPlayingStepMask(track) == ((1ULL << 5) | (1ULL << 63)));
+
+    // Only the note slots of the playing page bank count with less polyphony:
+    track->polyCount = 1;   // 4 voice polyphony
+    track->playingPageBank = 1;
+    assert(getPlayingStepMask(track) == 1ULL << 63);
+
+    // Disabling a note clears its bit:
+    track->steps[63].notes[6].enabled = false;
+    updateStepNoteMasks(track, 63);
+    assert(getPlayingStepMask(track) == 0);
+
+    // Decoding a track rebuilds the masks:
+    unsigned char bytes[TRACK_BYTE_SIZE];
+    trackToByteArray(track, bytes);
+    memset(track->noteMasks, 0xFF, sizeof(track->noteMasks));
+    byteArrayToTrack(track, bytes);
+    assert(track->noteMasks[0] == 1ULL << 5);
+    for (int n = 1; n < NOTES_IN_STEP; n++) {
+        assert(track->noteMasks[n] == 0);
+    }
+
+    free(track);
+}
+
+/**
+ * Get the peak resident set size of this process in KB
+ */
+static long getPeakRssKb() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+}
+
+void testByteArrayToProjectUsesOneProjectOfMemory() {
+    unsigned char *arr = malloc(PROJECT_BYTE_SIZE);
+    struct Project *project = malloc(sizeof(struct Project));
+    initializeProject(project);
+    projectToByteArray(project, arr);
+    free(project);
+
+    // Measure in a child process, so the memory used before (and by the other tests) does not count:
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0) {
+        // Touch all memory of the project first, so only what is used while decoding counts:
+        project = malloc(sizeof(struct Project));
+        memset(project, 0, sizeof(struct Project));
+        long peakRssKb = getPeakRssKb();
+        byteArrayToProject(project, arr);
+        long growthKb = getPeakRssKb() - peakRssKb;
+        free(project);
+        _exit(growthKb < (long)(sizeof(struct Project) / 1024) / 2 ? 0 : 1);
+    }
+
+    int status = 1;
+    waitpid(pid, &status, 0);
+    assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    free(arr);
+}
+
 /// --- Entry point
 
 void testProjectFile() {
     testNoteToByteArray();
     testByteArrayToNote();
+    testProjectRoundTrip();
+    testNoteMasksFollowNotes();
+    testByteArrayToProjectUsesOneProjectOfMemory();
 }
@@ -0,0 +1,63 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "../pulse_clock.h"
+#include "../constants.h"
+
+#define NANOS_PER_HOUR (3600 * NANOS_PER_SEC)
+
+/**
+ * The exact (rational) time of a pulse, rounded down to whole nanoseconds
+ */
+static uint64_t getExactPulseTime(int bpm, uint64_t pulse) {
+    return (pulse * 60 * NANOS_PER_SEC) / ((uint64_t)bpm * PPQN_MULTIPLIED);
+}
+
+void testPulseClockHasNoDriftAfterAnHour() {
+    int bpms[] = {45, 91, 120, 137, 173, 299};
+    uint64_t startNs = 123456789;
+
+    for (size_t i = 0; i < ARRAY_LENGTH(bpms); i++) {
+        struct PulseClock pulseClock;
+        initializePulseClock(&pulseClock, startNs, calculatePulsePeriod(bpms[i]));
+
+        // Every pulse should be within rounding distance of the exact time:
+        uint64_t pulsesPerHour = (uint64_t)bpms[i] * 60 * PPQN_MULTIPLIED;
+        uint64_t maxErrorNs = 0;
+        for (uint64_t pulse = 0; pulse <= pulsesPerHour; pulse++) {
+            uint64_t deadline = getPulseDeadline(&pulseClock, pulse) - startNs;
+            uint64_t exact = getExactPulseTime(bpms[i], pulse);
+            uint64_t errorNs = deadline > exact ? deadline - exact : exact - deadline;
+            maxErrorNs = MAX(maxErrorNs, errorNs);
+        }
+        assert(maxErrorNs <= 1);
+
+        // And after exactly an hour of pulses, there is no drift at all:
+        assert(getPulseDeadline(&pulseClock, pulsesPerHour) - startNs == NANOS_PER_HOUR);
+    }
+}
+
+void testPulseClockTempoChangeHasNoPhaseJump() {
+    struct PulseClock pulseClock;
+    initializePulseClock(&pulseClock, 0, calculatePulsePeriod(137));
+
+    uint64_t pulse = PPQN_MULTIPLIED * 100 + 7;
+    uint64_t deadline = getPulseDeadline(&pulseClock, pulse);
+    setPulseClockPeriod(&pulseClock, pulse, calculatePulsePeriod(91));
+
+    // The anchor pulse stays where it was, the next pulses follow the new tempo:
+    assert(getPulseDeadline(&pulseClock, pulse) == deadline);
+    uint64_t roundedPeriod = (calculatePulsePeriod(91) + (1ULL << 31)) >> 32;
+    assert(getPulseDeadline(&pulseClock, pulse + 1) - deadline == roundedPeriod);
+
+    // An hour at the new tempo is still exactly an hour:
+    uint64_t pulsesPerHour = 91 * 60 * PPQN_MULTIPLIED;
+    assert(getPulseDeadline(&pulseClock, pulse + pulsesPerHour) - deadline == NANOS_PER_HOUR);
+}
+
+/// --- Entry point
+
+void testPulseClock() {
+    testPulseClockHasNoDriftAfterAnHour();
+    testPulseClockTempoChangeHasNoPhaseJump();
+}
@@ -0,0 +1,137 @@
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <pthread.h>
+#include "../render_snapshot.h"
+
+#define SNAPSHOTS_TO_PUBLISH 100000
+
+void testRenderSnapshotOnlyReturnsNewSnapshots() {
+    static struct RenderSnapshotBuffer buffer;
+    initializeRenderSnapshotBuffer(&buffer);
+
+    // Nothing is published yet:
+    assert(acquireRenderSnapshot(&buffer) == NULL);
+
+    getRenderSnapshotBackSlot(&buffer)->ppqnCounter = 1;
+    publishRenderSnapshot(&buffer);
+    struct RenderSnapshot *snapshot = acquireRenderSnapshot(&buffer);
+    assert(snapshot != NULL && snapshot->ppqnCounter == 1);
+    assert(acquireRenderSnapshot(&buffer) == NULL);
+
+    // When the renderer falls behind, it only gets the latest one:
+    for (int i = 2; i <= 4; i++) {
+        getRenderSnapshotBackSlot(&buffer)->ppqnCounter = i;
+        publishRenderSnapshot(&buffer);
+        // The producer never writes to the slot that is being read:
+        assert(getRenderSnapshotBackSlot(&buffer) != snapshot);
+    }
+    assert(snapshot->ppqnCounter == 1);
+    snapshot = acquireRenderSnapshot(&buffer);
+    assert(snapshot != NULL && snapshot->ppqnCounter == 4);
+    assert(acquireRenderSnapshot(&buffer) == NULL);
+}
+
+static void* publishRenderSnapshots(void *arg) {
+    struct RenderSnapshotBuffer *buffer = arg;
+    for (uint64_t i = 1; i <= SNAPSHOTS_TO_PUBLISH; i++) {
+        struct RenderSnapshot *snapshot = getRenderSnapshotBackSlot(buffer);
+        snapshot->ppqnCounter = i;
+        snapshot->patternStepCounter = i / PP16N;
+        snapshot->track.repeatCount = i % 1000;
+        publishRenderSnapshot(buffer);
+    }
+    return NULL;
+}
+
+void testRenderSnapshotIsNeverTorn() {
+    static struct RenderSnapshotBuffer buffer;
+    initializeRenderSnapshotBuffer(&buffer);
+
+    pthread_t producer;
+    pthread_create(&producer, NULL, publishRenderSnapshots, &buffer);
+
+    // Every acquired snapshot is complete and newer than the previous one:
+    uint64_t previous = 0;
+    bool isConsistent = true;
+    while (previous < SNAPSHOTS_TO_PUBLISH) {
+        struct RenderSnapshot *snapshot = acquireRenderSnapshot(&buffer);
+        if (snapshot == NULL) {
+            continue;
+        }
+        uint64_t pulse = snapshot->ppqnCounter;
+        isConsistent &= pulse > previous;
+        isConsistent &= snapshot->patternStepCounter == pulse / PP16N;
+        isConsistent &= snapshot->track.repeatCount == pulse % 1000;
+        previous = pulse;
+    }
+    pthread_join(producer, NULL);
+    assert(isConsistent);
+}
+
+void testDirtyRenderRegionsFollowThePlayhead() {
+    static struct RenderSnapshot drawn, next;
+    drawn.screen = BLIPR_SCREEN_SEQUENCER;
+    drawn.ppqnCounter = PP16N;
+    drawn.patternStepCounter = 1;
+    next = drawn;
+
+    // Nothing drawn yet:
+    assert(getDirtyRenderRegions(NULL, &next) == RENDER_REGION_ALL);
+    assert(getDirtyRenderRegions(&drawn, &next) == 0);
+
+    // Playback only moves the playhead, the blinker and the pattern length indicator:
+    next.ppqnCounter += PP16N;
+    next.patternStepCounter++;
+    assert(getDirtyRenderRegions(&drawn, &next) == (RENDER_REGION_BORDER | RENDER_REGION_PATTERN_LENGTH | RENDER_REGION_PLAYHEAD));
+
+    // A full beat later the blinker looks the same:
+    next.ppqnCounter = drawn.ppqnCounter + PPQN_MULTIPLIED;
+    next.patternStepCounter = drawn.patternStepCounter;
+    assert(getDirtyRenderRegions(&drawn, &next) == RENDER_REGION_PLAYHEAD);
+
+    // Key events, page loops & pattern switches redraw everything:
+    next.editCount++;
+    assert(getDirtyRenderRegions(&drawn, &next) == RENDER_REGION_ALL);
+    next.editCount = drawn.editCount;
+    next.track.repeatCount++;
+    assert(getDirtyRenderRegions(&drawn, &next) == RENDER_REGION_ALL);
+    next.track.repeatCount = drawn.track.repeatCount;
+    next.selectedPattern++;
+    assert(getDirtyRenderRegions(&drawn, &next) == RENDER_REGION_ALL);
+}
+
+void testRenderSnapshotOnlyCopiesTheSelectedPage() {
+    static struct RenderSnapshot snapshot;
+    static struct Track track;
+    initializeTrack(&track, 3);
+    track.selectedPage = 2;
+    track.repeatCount = 5;
+    track.noteMasks[0] = 0xFFFF00000000ULL;
+    for (int i = 0; i < 64; i++) {
+        track.steps[i].notes[0].note = i;
+    }
+
+    copyRenderSnapshotTrack(&snapshot, &track);
+    assert(snapshot.track.selectedPage == 2);
+    assert(snapshot.track.repeatCount == 5);
+    assert(snapshot.track.noteMasks[0] == track.noteMasks[0]);
+    assert(strcmp(snapshot.track.name, track.name) == 0);
+    bool isPageCopied = true;
+    for (int i = 32; i < 48; i++) {
+        isPageCopied &= snapshot.track.steps[i].notes[0].note == i;
+    }
+    assert(isPageCopied);
+    // The other pages are not drawn:
+    assert(snapshot.track.steps[31].notes[0].note == 0);
+    assert(snapshot.track.steps[48].notes[0].note == 0);
+}
+
+/// --- Entry point
+
+void testRenderSnapshot() {
+    testRenderSnapshotOnlyReturnsNewSnapshots();
+    testRenderSnapshotIsNeverTorn();
+    testDirtyRenderRegionsFollowThePlayhead();
+    testRenderSnapshotOnlyCopiesTheSelectedPage();
+}
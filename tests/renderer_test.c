@@ -0,0 +1,91 @@
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include "../renderer.h"
+#include "../framebuffer.h"
+#include "../drawing_text.h"
+#include "../drawing_icons.h"
+
+#define RENDERER_TEST_STEPS 100
+
+/**
+ * Play a track on a screen, and check after every step that redrawing only the dirty regions
+ * results in the same pixels as drawing the complete frame
+ */
+static bool isIncrementalFrameEqualToCompleteFrame(struct Track *track, BliprScreen screen, unsigned char heldModifiers) {
+    static struct RenderSnapshot snapshot, drawnSnapshot;
+    static uint32_t incrementalFrame[WIDTH * HEIGHT];
+    memset(&snapshot, 0, sizeof(snapshot));
+    snapshot.screen = screen;
+    snapshot.patternLength = 15;
+    snapshot.bpm = 120;
+    snapshot.heldModifiers = heldModifiers;
+
+    bool isFrameDrawn = false;
+    bool isEqual = true;
+    for (int step = 0; step < RENDERER_TEST_STEPS; step++) {
+        snapshot.ppqnCounter = (uint64_t)step * PP16N;
+        snapshot.patternStepCounter = step % 16;
+        if (step % 16 == 0 && step > 0) {
+            track->repeatCount++;
+        }
+        if (step % 35 == 34) {
+            snapshot.editCount++;
+        }
+        copyRenderSnapshotTrack(&snapshot, track);
+        getSequencerEditorState(&snapshot.editor);
+        snapshot.transitionMask = getTransitionTrigMask(track);
+
+        int regions = isFrameDrawn ? getDirtyRenderRegions(&drawnSnapshot, &snapshot) : RENDER_REGION_ALL;
+        drawRenderSnapshot(&snapshot, regions);
+        drawnSnapshot = snapshot;
+        isFrameDrawn = true;
+        memcpy(incrementalFrame, framebuffer, sizeof(incrementalFrame));
+
+        drawRenderSnapshot(&snapshot, RENDER_REGION_ALL);
+        isEqual &= memcmp(incrementalFrame, framebuffer, sizeof(incrementalFrame)) == 0;
+    }
+
+    return isEqual;
+}
+
+void testRendererDrawsTheSameWithDirtyRegions() {
+    bool wasFramebufferUsed = isFramebufferUsed;
+    isFramebufferUsed = true;
+    initializeTextures();
+    initializeIconTextures();
+
+    static struct Track track;
+    initializeTrack(&track, 0);
+    for (int i = 0; i < 64; i += 3) {
+        struct Note *note = &track.steps[i].notes[0];
+        note->enabled = true;
+        note->note = 60 + (i % 12);
+        note->velocity = 40 + (i * 2);
+        note->nudge = i % 2 ? PP16N - 3 : PP16N + 4;
+        note->trigg = (i % 7) ? 0 : TRIG_1_4;
+    }
+    updateTrackNoteMasks(&track);
+
+    assert(isIncrementalFrameEqualToCompleteFrame(&track, BLIPR_SCREEN_SEQUENCER, 0));
+    assert(isIncrementalFrameEqualToCompleteFrame(&track, BLIPR_SCREEN_DRUMKIT_SEQUENCER, 0));
+    assert(isIncrementalFrameEqualToCompleteFrame(&track, BLIPR_SCREEN_DRUMKIT_SEQUENCER, BLIPR_MODIFIER_SHIFT_2));
+    assert(isIncrementalFrameEqualToCompleteFrame(&track, BLIPR_SCREEN_FOUR_ON_THE_FLOOR, 0));
+    assert(isIncrementalFrameEqualToCompleteFrame(&track, BLIPR_SCREEN_TRACK_SELECTION, 0));
+
+    // Shorter pages, and a page that plays continuously:
+    track.pageLength = 11;
+    assert(isIncrementalFrameEqualToCompleteFrame(&track, BLIPR_SCREEN_SEQUENCER, 0));
+    track.pagePlayMode = PAGE_PLAY_MODE_CONTINUOUS;
+    track.trackLength = 63;
+    track.selectedPage = 1;
+    assert(isIncrementalFrameEqualToCompleteFrame(&track, BLIPR_SCREEN_SEQUENCER, 0));
+
+    isFramebufferUsed = wasFramebufferUsed;
+}
+
+/// --- Entry point
+
+void testRenderer() {
+    testRendererDrawsTheSameWithDirtyRegions();
+}
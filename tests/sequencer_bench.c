@@ -0,0 +1,160 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include "../programs/sequencer.h"
+#include "../programs/sequencer_timeline.h"
+#include "../utils.h"
+#include "../constants.h"
+
+#define BENCHMARK_LOOPS 20
+
+static int benchmarkPlayedNotes = 0;
+
+static void benchmarkFirstPulseCallback() {}
+
+static void benchmarkPlayNoteCallback(const struct Note *note) {
+    benchmarkPlayedNotes += note->enabled;
+}
+
+/**
+ * Fill a pattern: every n-th step has all its notes enabled (with a nudge)
+ */
+static void populateBenchmarkPattern(struct Pattern *pattern, int stepInterval) {
+    for (int t = 0; t < 16; t++) {
+        struct Track *track = &pattern->tracks[t];
+        track->program = BLIPR_PROGRAM_SEQUENCER;
+        track->pagePlayMode = PAGE_PLAY_MODE_CONTINUOUS;
+        track->trackLength = 63;
+        track->polyCount = 0;
+        track->shuffle = PP16N + 2;
+        track->speed = TRACK_SPEED_NORMAL;
+        resetTrack(track);
+        invalidateTrackTimeline(track);
+        for (int s = 0; s < 64; s++) {
+            for (int n = 0; n < NOTES_IN_STEP; n++) {
+                struct Note *note = &track->steps[s].notes[n];
+                note->enabled = s % stepInterval == 0;
+                note->note = 60 + n;
+                note->nudge = PP16N - 4 + n;
+                note->trigg = create2FByte(false, false, TRIG_DISABLED);
+            }
+        }
+        updateTrackNoteMasks(track);
+    }
+}
+
+/**
+ * Play a couple of loops of all 16 tracks and return the average time per pulse
+ */
+static uint64_t benchmarkPattern(struct Pattern *pattern, bool isTimelineUsed) {
+    uint64_t pulses = PP16N * 64 * BENCHMARK_LOOPS;
+    uint64_t start = getBenchmarkTimeNs();
+    for (uint64_t pulse = 0; pulse < pulses; pulse++) {
+        for (int t = 0; t < 16; t++) {
+            if (isTimelineUsed) {
+                processTimelinePulse(&pulse, &pattern->tracks[t], benchmarkFirstPulseCallback, benchmarkPlayNoteCallback);
+            } else {
+                processPulse(&pulse, &pattern->tracks[t], benchmarkFirstPulseCallback, benchmarkPlayNoteCallback);
+            }
+        }
+    }
+    return getBenchmarkTimeNs() - start;
+}
+
+/**
+ * Evaluate every trig value for a range of repeat counts, and return the total time
+ */
+static uint64_t benchmarkTrigConditions(int repeats) {
+    uint32_t randomState = 1;
+    int triggedCount = 0;
+    uint64_t start = getBenchmarkTimeNs();
+    for (int repeatCount = 0; repeatCount < repeats; repeatCount++) {
+        for (int trigg = 0; trigg < 256; trigg++) {
+            triggedCount += isNoteTrigged(trigg, repeatCount, &randomState, 0);
+        }
+    }
+    uint64_t elapsed = getBenchmarkTimeNs() - start;
+    benchmarkPlayedNotes += triggedCount;
+    return elapsed;
+}
+
+// Memory that is walked between pulses, like drawing the screen would do:
+#define BENCHMARK_EVICT_BYTE_SIZE (8 * 1024 * 1024)
+static unsigned char *evictBuffer = NULL;
+
+/**
+ * Push the tracks out of the caches
+ */
+static void evictCaches() {
+    for (int i = 0; i < BENCHMARK_EVICT_BYTE_SIZE; i += 64) {
+        evictBuffer[i]++;
+    }
+}
+
+/**
+ * Play all 16 tracks like the sequencer thread does: check the program and speed of every track, then run it.
+ * The settings are either read from the tracks themselves, or from the playback state that is kept apart.
+ * With cold caches, the caches are flushed before every pulse (only the pulse itself is timed)
+ */
+static uint64_t benchmarkPatternDispatch(struct Pattern *pattern, bool isPlaybackStateUsed, bool isCacheCold) {
+    uint64_t pulses = PP16N * 64 * (isCacheCold ? 1 : BENCHMARK_LOOPS);
+    uint64_t elapsed = 0;
+    uint64_t start = getBenchmarkTimeNs();
+    for (uint64_t pulse = 0; pulse < pulses; pulse++) {
+        if (isCacheCold) {
+            evictCaches();
+            start = getBenchmarkTimeNs();
+        }
+        for (int t = 0; t < 16; t++) {
+            struct Track *track = &pattern->tracks[t];
+            unsigned char program;
+            unsigned char speed;
+            if (isPlaybackStateUsed) {
+                const struct TrackTimeline *timeline = getTrackTimeline(track);
+                program = timeline->program;
+                speed = timeline->speed;
+            } else {
+                program = track->program;
+                speed = track->speed;
+            }
+            uint64_t trackPulse = pulse;
+            if (program == BLIPR_PROGRAM_SEQUENCER && applySpeedToPulse(speed, &trackPulse)) {
+                processTimelinePulse(&trackPulse, track, benchmarkFirstPulseCallback, benchmarkPlayNoteCallback);
+            }
+        }
+        if (isCacheCold) {
+            elapsed += getBenchmarkTimeNs() - start;
+        }
+    }
+    return isCacheCold ? elapsed : getBenchmarkTimeNs() - start;
+}
+
+void benchmarkSequencer() {
+    uint64_t pulses = PP16N * 64 * BENCHMARK_LOOPS;
+    struct Pattern *pattern = malloc(sizeof(struct Pattern));
+
+    populateBenchmarkPattern(pattern, 1);
+    printBenchmark("16 tracks, all notes, processPulse", benchmarkPattern(pattern, false), pulses);
+    printBenchmark("16 tracks, all notes, timeline", benchmarkPattern(pattern, true), pulses);
+
+    populateBenchmarkPattern(pattern, 4);
+    printBenchmark("16 tracks, every 4th step, processPulse", benchmarkPattern(pattern, false), pulses);
+    printBenchmark("16 tracks, every 4th step, timeline", benchmarkPattern(pattern, true), pulses);
+
+    printBenchmark("isNoteTrigged, all trig values", benchmarkTrigConditions(4096), 4096 * 256);
+
+    // Empty steps are skipped on the note masks:
+    populateBenchmarkPattern(pattern, 16);
+    printBenchmark("16 tracks, every 16th step, processPulse", benchmarkPattern(pattern, false), pulses);
+
+    // Only the settings of the tracks are checked on most pulses:
+    evictBuffer = calloc(BENCHMARK_EVICT_BYTE_SIZE, 1);
+    populateBenchmarkPattern(pattern, 16);
+    printBenchmark("16 tracks, every 16th step, track settings", benchmarkPatternDispatch(pattern, false, false), pulses);
+    printBenchmark("16 tracks, every 16th step, playback state", benchmarkPatternDispatch(pattern, true, false), pulses);
+    printBenchmark("  same, cold caches, track settings", benchmarkPatternDispatch(pattern, false, true), PP16N * 64);
+    printBenchmark("  same, cold caches, playback state", benchmarkPatternDispatch(pattern, true, true), PP16N * 64);
+    free(evictBuffer);
+
+    free(pattern);
+}
@@ -1,7 +1,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <string.h>
 #include "../programs/sequencer.h"
+#include "../programs/sequencer_timeline.h"
 #include "../utils.h"
 #include "../constants.h"
 #include "../print.h"
@@ -12,28 +14,246 @@ void testTrigConditions() {
     // Track length (so we can calculate how many times the step has been played)
     struct Note note;
     note.trigg = create2FByte(true, false, TRIG_FIRST); // This note is trigged only the first time it is played
-    assert(isNoteTrigged(note.trigg, 0) == true);
-    assert(isNoteTrigged(note.trigg, 1) == false);
-    assert(isNoteTrigged(note.trigg, 2) == false);
+    assert(isNoteTrigged(note.trigg, 0, NULL, 0) == true);
+    assert(isNoteTrigged(note.trigg, 1, NULL, 0) == false);
+    assert(isNoteTrigged(note.trigg, 2, NULL, 0) == false);
     note.trigg = create2FByte(true, true, TRIG_FIRST);  // This note is trigged not the first time it is played (inversed flag)
-    assert(isNoteTrigged(note.trigg, 0) == false);
-    assert(isNoteTrigged(note.trigg, 1) == true);
-    assert(isNoteTrigged(note.trigg, 2) == true);
+    assert(isNoteTrigged(note.trigg, 0, NULL, 0) == false);
+    assert(isNoteTrigged(note.trigg, 1, NULL, 0) == true);
+    assert(isNoteTrigged(note.trigg, 2, NULL, 0) == true);
     note.trigg = create2FByte(true, false, TRIG_1_2);   // This note is trigged every 1 out of 2 repeats
-    assert(isNoteTrigged(note.trigg, 0) == true);
-    assert(isNoteTrigged(note.trigg, 1) == false);
-    assert(isNoteTrigged(note.trigg, 2) == true);
-    assert(isNoteTrigged(note.trigg, 3) == false);
+    assert(isNoteTrigged(note.trigg, 0, NULL, 0) == true);
+    assert(isNoteTrigged(note.trigg, 1, NULL, 0) == false);
+    assert(isNoteTrigged(note.trigg, 2, NULL, 0) == true);
+    assert(isNoteTrigged(note.trigg, 3, NULL, 0) == false);
     note.trigg = create2FByte(true, false, TRIG_2_3);   // This note is trigged every 2 out of 3 repeats
-    assert(isNoteTrigged(note.trigg, 0) == false);
-    assert(isNoteTrigged(note.trigg, 1) == true);
-    assert(isNoteTrigged(note.trigg, 2) == false);
-    assert(isNoteTrigged(note.trigg, 3) == false);
+    assert(isNoteTrigged(note.trigg, 0, NULL, 0) == false);
+    assert(isNoteTrigged(note.trigg, 1, NULL, 0) == true);
+    assert(isNoteTrigged(note.trigg, 2, NULL, 0) == false);
+    assert(isNoteTrigged(note.trigg, 3, NULL, 0) == false);
     note.trigg = create2FByte(true, true, TRIG_2_3);   // This note is not trigged every 2 out of 3 repeats (inversed flag)
-    assert(isNoteTrigged(note.trigg, 0) == true);
-    assert(isNoteTrigged(note.trigg, 1) == false);
-    assert(isNoteTrigged(note.trigg, 2) == true);
-    assert(isNoteTrigged(note.trigg, 3) == true);
+    assert(isNoteTrigged(note.trigg, 0, NULL, 0) == true);
+    assert(isNoteTrigged(note.trigg, 1, NULL, 0) == false);
+    assert(isNoteTrigged(note.trigg, 2, NULL, 0) == true);
+    assert(isNoteTrigged(note.trigg, 3, NULL, 0) == true);
+}
+
+/**
+ * The trig conditions as they were evaluated with a switch on every value, to check the lookup table against
+ */
+static bool referenceIsNoteTrigged(int triggValue, int repeatCount) {
+    if (triggValue == 0) {
+        return true;
+    }
+
+    bool isTrigged = true;
+    int value = get2FByteValue(triggValue);
+    // X:Y conditions, there is no 2:2 (that is 1:2 inversed):
+    int firstValue = TRIG_1_2;
+    for (int modulus = 2; modulus <= 8; modulus++) {
+        int count = modulus == 2 ? 1 : modulus;
+        if (value >= firstValue && value < firstValue + count) {
+            isTrigged = repeatCount % modulus == value - firstValue;
+        }
+        firstValue += count;
+    }
+    if (value == TRIG_FIRST) {
+        isTrigged = repeatCount == 0;
+    }
+
+    return get2FByteFlag2(triggValue) ? !isTrigged : isTrigged;
+}
+
+void testTrigConditionsMatchReference() {
+    bool isEqual = true;
+    for (int trigg = 0; trigg < 256; trigg++) {
+        int value = get2FByteValue(trigg);
+        if (value >= TRIG_1_PERCENT && value <= TRIG_50_PERCENT) {
+            continue;
+        }
+        // Transition trigs always passed before they were implemented:
+        if (value >= TRIG_FILL && value != TRIG_FIRST) {
+            continue;
+        }
+        for (int repeatCount = 0; repeatCount < 840; repeatCount++) {
+            uint32_t randomState = 0;
+            if (isNoteTrigged(trigg, repeatCount, &randomState, 0) != referenceIsNoteTrigged(trigg, repeatCount)) {
+                printWarning("trigg %d differs at repeat %d", trigg, repeatCount);
+                isEqual = false;
+                break;
+            }
+        }
+    }
+    assert(isEqual);
+}
+
+void testProbabilityTrigsAreReproducible() {
+    int divisors[7] = {100, 50, 20, 10, 4, 3, 2};
+    for (int i = 0; i < 7; i++) {
+        int trigg = create2FByte(true, false, TRIG_1_PERCENT + i);
+        uint32_t randomState = 1234;
+        int triggedCount = 0;
+        for (int n = 0; n < 100000; n++) {
+            triggedCount += isNoteTrigged(trigg, 0, &randomState, 0);
+        }
+        // Within 10% of the expected chance:
+        int expected = 100000 / divisors[i];
+        assert(triggedCount > expected * 9 / 10 && triggedCount < expected * 11 / 10);
+
+        // The inversed condition passes when the normal one does not:
+        uint32_t lhState = 42;
+        uint32_t rhState = 42;
+        bool isInversed = true;
+        for (int n = 0; n < 1000; n++) {
+            isInversed &= isNoteTrigged(trigg, 0, &lhState, 0) != isNoteTrigged(trigg | 0x02, 0, &rhState, 0);
+        }
+        assert(isInversed);
+    }
+
+    // Tracks seeded with the same index play the same, different tracks do not:
+    struct Track *lhTrack = malloc(sizeof(struct Track));
+    struct Track *rhTrack = malloc(sizeof(struct Track));
+    seedTrackRandomState(lhTrack, 3);
+    seedTrackRandomState(rhTrack, 3);
+    int trigg = create2FByte(true, false, TRIG_50_PERCENT);
+    bool isSame = true;
+    for (int n = 0; n < 64; n++) {
+        isSame &= isNoteTrigged(trigg, 0, &lhTrack->randomState, 0) == isNoteTrigged(trigg, 0, &rhTrack->randomState, 0);
+    }
+    assert(isSame);
+    seedTrackRandomState(rhTrack, 4);
+    isSame = true;
+    for (int n = 0; n < 64; n++) {
+        isSame &= isNoteTrigged(trigg, 0, &lhTrack->randomState, 0) == isNoteTrigged(trigg, 0, &rhTrack->randomState, 0);
+    }
+    assert(!isSame);
+    free(lhTrack);
+    free(rhTrack);
+}
+
+/**
+ * Check if a trig condition passes with a given transition mask
+ */
+static bool isTransitionTrigged(int value, uint64_t transitionMask) {
+    return isNoteTrigged(create2FByte(true, false, value), 0, NULL, transitionMask);
+}
+
+void testTransitionTrigConditions() {
+    struct Track *track = malloc(sizeof(struct Track));
+    initializeTrack(track, 0);
+    track->pagePlayMode = PAGE_PLAY_MODE_CONTINUOUS;
+
+    // Fill is active, and we just came from pattern 2 to pattern 3. Pattern 6 is queued:
+    struct TransitionContext context = {0};
+    context.currentPattern = 3;
+    context.queuedPattern = 6;
+    context.previousPattern = 2;
+    context.playedPatterns = 1 << 2;
+    context.isFillActive = true;
+    setTransitionContext(&context);
+    uint64_t mask = getTransitionTrigMask(track);
+    assert(isTransitionTrigged(TRIG_FILL, mask) == true);
+    assert(isNoteTrigged(create2FByte(true, true, TRIG_FILL), 0, NULL, mask) == false);
+    assert(isTransitionTrigged(TRIG_TRANSITION, mask) == true);
+    assert(isTransitionTrigged(TRIG_HIGHER_TRANSITION, mask) == true);
+    assert(isTransitionTrigged(TRIG_LOWER_TRANSITION, mask) == false);
+    assert(isTransitionTrigged(TRIG_HIGHER_FIRST, mask) == true);
+    assert(isTransitionTrigged(TRIG_LOWER_FIRST, mask) == false);
+    assert(isTransitionTrigged(TRIG_FIRST_PATTERN_PLAY, mask) == true);
+    // Continuous tracks have no page transitions:
+    assert(isTransitionTrigged(TRIG_FIRST_PAGE, mask) == false);
+
+    // The second time the pattern is played, without fill and nothing queued:
+    context.queuedPattern = 3;
+    context.patternLoopCount = 1;
+    context.isFillActive = false;
+    setTransitionContext(&context);
+    mask = getTransitionTrigMask(track);
+    assert(isTransitionTrigged(TRIG_FILL, mask) == false);
+    assert(isTransitionTrigged(TRIG_TRANSITION, mask) == false);
+    assert(isTransitionTrigged(TRIG_HIGHER_FIRST, mask) == false);
+    assert(isTransitionTrigged(TRIG_FIRST_PATTERN_PLAY, mask) == false);
+
+    // Coming back to a pattern that was played before:
+    context.patternLoopCount = 0;
+    context.previousPattern = 4;
+    context.playedPatterns = (1 << 3) | (1 << 4);
+    setTransitionContext(&context);
+    mask = getTransitionTrigMask(track);
+    assert(isTransitionTrigged(TRIG_LOWER_FIRST, mask) == true);
+    assert(isTransitionTrigged(TRIG_FIRST_PATTERN_PLAY, mask) == false);
+
+    // Page 2 plays for the first time after page 3, page 1 is queued after 2 repeats:
+    track->pagePlayMode = PAGE_PLAY_MODE_REPEAT;
+    track->selectedPage = 2;
+    track->previousPage = 3;
+    track->queuedPage = 1;
+    track->playedPages = 1 << 3;
+    track->transitionRepeats = 1;
+    track->repeatCount = 0;
+    mask = getTransitionTrigMask(track);
+    assert(isTransitionTrigged(TRIG_FIRST_PAGE, mask) == true);
+    assert(isTransitionTrigged(TRIG_LOWER_FIRST_PAGE, mask) == true);
+    assert(isTransitionTrigged(TRIG_HIGHER_FIRST_PAGE, mask) == false);
+    assert(isTransitionTrigged(TRIG_FIRST_PAGE_PLAY, mask) == true);
+    assert(isTransitionTrigged(TRIG_TRANSITION_PAGE, mask) == true);
+    assert(isTransitionTrigged(TRIG_LOWER_TRANSITION_PAGE, mask) == true);
+    assert(isTransitionTrigged(TRIG_HIGHER_TRANSITION_PAGE, mask) == false);
+    assert(isTransitionTrigged(TRIG_TRANSITION_LAST_PAGE, mask) == false);
+    // The pattern conditions still apply:
+    assert(isTransitionTrigged(TRIG_LOWER_FIRST, mask) == true);
+
+    // The second repeat is the last one before page 1 plays:
+    track->repeatCount = 1;
+    mask = getTransitionTrigMask(track);
+    assert(isTransitionTrigged(TRIG_FIRST_PAGE, mask) == false);
+    assert(isTransitionTrigged(TRIG_FIRST_PAGE_PLAY, mask) == false);
+    assert(isTransitionTrigged(TRIG_TRANSITION_LAST_PAGE, mask) == true);
+
+    context = (struct TransitionContext){0};
+    setTransitionContext(&context);
+    free(track);
+}
+
+void testTrigEditorReachesEveryCondition() {
+    struct Track *track = malloc(sizeof(struct Track));
+    initializeTrack(track, 0);
+    resetSequencerSelectedStep();
+    resetSelectedNote();
+
+    // Select the first step and open the note editor:
+    bool keyStates[SDL_NUM_SCANCODES] = {false};
+    keyStates[BLIPR_KEY_SHIFT_1] = true;
+    keyStates[BLIPR_KEY_SHIFT_2] = true;
+    updateSequencer(track, keyStates, BLIPR_KEY_1, false);
+    keyStates[BLIPR_KEY_SHIFT_2] = false;
+
+    // Step the trig condition up to the last one:
+    const struct Note *note = &track->steps[0].notes[0];
+    for (int i = 0; i < TRIG_TRANSITION_LAST_PAGE; i++) {
+        updateSequencer(track, keyStates, BLIPR_KEY_12, false);
+    }
+    assert(get2FByteFlag1(note->trigg) == true);
+    assert(get2FByteFlag2(note->trigg) == false);
+    assert(get2FByteValue(note->trigg) == TRIG_TRANSITION_LAST_PAGE);
+    char text[8];
+    setTriggText(note->trigg, text);
+    assert(strcmp(text, "TRN.LR") == 0);
+
+    // The inversed conditions follow, and all of them can be reached:
+    updateSequencer(track, keyStates, BLIPR_KEY_12, false);
+    assert(get2FByteFlag2(note->trigg) == true);
+    assert(get2FByteValue(note->trigg) == TRIG_1_2);
+    for (int i = 0; i < TRIG_TRANSITION_LAST_PAGE; i++) {
+        updateSequencer(track, keyStates, BLIPR_KEY_12, false);
+    }
+    assert(get2FByteFlag2(note->trigg) == true);
+    assert(get2FByteValue(note->trigg) == TRIG_TRANSITION_LAST_PAGE);
+    setTriggText(note->trigg, text);
+    assert(strcmp(text, "!TRN.LR") == 0);
+
+    resetSequencerSelectedStep();
+    free(track);
 }
 
 static bool testIsFirstPulse = false;
@@ -43,7 +263,7 @@ static void testProcessPulseCallback() {
 }
 
 void testGetTrackStepIndexForContinuousPlay() {
-    struct Track *track = malloc(TRACK_BYTE_SIZE);
+    struct Track *track = malloc(sizeof(struct Track));
     track->pagePlayMode = PAGE_PLAY_MODE_CONTINUOUS;
     track->trackLength = 43; // =0-based
     track->shuffle = PP16N;
@@ -86,15 +306,16 @@ void testGetTrackStepIndexForContinuousPlay() {
     testIsFirstPulse = false;
     assert(getTrackStepIndex(&ppqnCounter, track, testProcessPulseCallback) == 0);
     assert(testIsFirstPulse == true);
+    free(track);
 }
 
 void testGetTrackStepIndexForRepeatPlay() {
-    struct Track *track = malloc(TRACK_BYTE_SIZE);
+    struct Track *track = malloc(sizeof(struct Track));
     track->pagePlayMode = PAGE_PLAY_MODE_REPEAT;
     track->pageLength = 15; // =0-based
     track->shuffle = PP16N;
     track->selectedPage = 0;
-    track->selectedPageBank = 0;
+    track->playingPageBank = 0;
     track->speed = TRACK_SPEED_NORMAL;
     u_int64_t ppqnCounter = 0;
     
@@ -143,7 +364,7 @@ void testGetTrackStepIndexForRepeatPlay() {
 
     // Test different page bank (page bank doesn't affect step, but note (in conjunction with poly)):
     track->selectedPage = 0;
-    track->selectedPageBank = 0;
+    track->playingPageBank = 0;
     testIsFirstPulse = false;
     assert(getTrackStepIndex(&ppqnCounter, track, testProcessPulseCallback) == 0);
     assert(testIsFirstPulse == true);
@@ -191,6 +412,7 @@ void testGetTrackStepIndexForRepeatPlay() {
     testIsFirstPulse = false;
     assert(getTrackStepIndex(&ppqnCounter, track, testProcessPulseCallback) == 16);
     assert(testIsFirstPulse == true);
+    free(track);
 }
 
 void assertEnabledNotesCount(const struct Note **notes, int expectedCount) {
@@ -208,7 +430,7 @@ void assertEnabledNotesCount(const struct Note **notes, int expectedCount) {
 
 void testGetNotesAtTrackStepIndex() {
     // Setup:
-    struct Track *track = malloc(TRACK_BYTE_SIZE);
+    struct Track *track = malloc(sizeof(struct Track));
     track->pagePlayMode = PAGE_PLAY_MODE_CONTINUOUS;
     track->trackLength = 63; // =0-based
     track->shuffle = PP16N;
@@ -269,7 +491,7 @@ void testGetNotesAtTrackStepIndex() {
 
     // Test 4 voice polyphony
     track->polyCount = 1;   // 4 voice polyphony
-    track->selectedPageBank = 0;
+    track->playingPageBank = 0;
     getNotesAtTrackStepIndex(5, track, notes);
     assertEnabledNotesCount(notes, 3);  // Only note 0-3
     assert(notes[0]->note == 60);
@@ -277,7 +499,7 @@ void testGetNotesAtTrackStepIndex() {
     assert(notes[3]->note == 63);
     memset(notes, 0, NOTE_BYTE_SIZE * 8);
 
-    track->selectedPageBank = 1;
+    track->playingPageBank = 1;
     getNotesAtTrackStepIndex(5, track, notes);
     assertEnabledNotesCount(notes, 1);  // Only note 4-7
     assert(notes[0]->note == 64);
@@ -285,71 +507,72 @@ void testGetNotesAtTrackStepIndex() {
 
     // Test 2 voice polyphony
     track->polyCount = 2;   // 2 voice polyphony
-    track->selectedPageBank = 0;
+    track->playingPageBank = 0;
     getNotesAtTrackStepIndex(5, track, notes);
     assertEnabledNotesCount(notes, 1);  // Only note 0-1
     assert(notes[0]->note == 60);
     memset(notes, 0, NOTE_BYTE_SIZE * 8);
 
-    track->selectedPageBank = 1;
+    track->playingPageBank = 1;
     getNotesAtTrackStepIndex(5, track, notes);
     assertEnabledNotesCount(notes, 2);  // Only note 2-3
     assert(notes[0]->note == 62);
     assert(notes[1]->note == 63);
     memset(notes, 0, NOTE_BYTE_SIZE * 8);
 
-    track->selectedPageBank = 2;
+    track->playingPageBank = 2;
     getNotesAtTrackStepIndex(5, track, notes);
     assertEnabledNotesCount(notes, 1);  // Only note 4-5
     assert(notes[0]->note == 64);
     memset(notes, 0, NOTE_BYTE_SIZE * 8);
 
-    track->selectedPageBank = 3;
+    track->playingPageBank = 3;
     getNotesAtTrackStepIndex(5, track, notes);
     assertEnabledNotesCount(notes, 0);  // Only note 6-7
     memset(notes, 0, NOTE_BYTE_SIZE * 8);
 
     // Test 1 voice polyphony (only 0,2,3 and 4 have notes)
     track->polyCount = 3;   // 2 voice polyphony
-    track->selectedPageBank = 0;
+    track->playingPageBank = 0;
     getNotesAtTrackStepIndex(5, track, notes);
     assertEnabledNotesCount(notes, 1);
     memset(notes, 0, NOTE_BYTE_SIZE * 8);
 
-    track->selectedPageBank = 1;
+    track->playingPageBank = 1;
     getNotesAtTrackStepIndex(5, track, notes);
     assertEnabledNotesCount(notes, 0);
     memset(notes, 0, NOTE_BYTE_SIZE * 8);
 
-    track->selectedPageBank = 2;
+    track->playingPageBank = 2;
     getNotesAtTrackStepIndex(5, track, notes);
     assertEnabledNotesCount(notes, 1);
     memset(notes, 0, NOTE_BYTE_SIZE * 8);
 
-    track->selectedPageBank = 3;
+    track->playingPageBank = 3;
     getNotesAtTrackStepIndex(5, track, notes);
     assertEnabledNotesCount(notes, 1);
     memset(notes, 0, NOTE_BYTE_SIZE * 8);
 
-    track->selectedPageBank = 4;
+    track->playingPageBank = 4;
     getNotesAtTrackStepIndex(5, track, notes);
     assertEnabledNotesCount(notes, 1);
     memset(notes, 0, NOTE_BYTE_SIZE * 8);
 
-    track->selectedPageBank = 5;
+    track->playingPageBank = 5;
     getNotesAtTrackStepIndex(5, track, notes);
     assertEnabledNotesCount(notes, 0);
     memset(notes, 0, NOTE_BYTE_SIZE * 8);
 
-    track->selectedPageBank = 6;
+    track->playingPageBank = 6;
     getNotesAtTrackStepIndex(5, track, notes);
     assertEnabledNotesCount(notes, 0);
     memset(notes, 0, NOTE_BYTE_SIZE * 8);
 
-    track->selectedPageBank = 7;
+    track->playingPageBank = 7;
     getNotesAtTrackStepIndex(5, track, notes);
     assertEnabledNotesCount(notes, 0);
     memset(notes, 0, NOTE_BYTE_SIZE * 8);
+    free(track);
 }
 
 // Reference to the last played note, for testing
@@ -362,7 +585,7 @@ void testPlayNoteCallback(const struct Note *note) {
 
 void testProcessPulseNudge() {
     // Setup:
-    struct Track *track = malloc(TRACK_BYTE_SIZE);
+    struct Track *track = malloc(sizeof(struct Track));
     track->pagePlayMode = PAGE_PLAY_MODE_CONTINUOUS;
     track->trackLength = 63; // =0-based
     track->shuffle = PP16N;
@@ -396,9 +619,10 @@ void testProcessPulseNudge() {
     track->steps[0].notes[4].enabled = true; // Note with negative nudge on step 0. So this needs to be triggered on step 63 + (PP16N - 2)
     track->steps[0].notes[4].note = 65;
     track->steps[0].notes[4].nudge = PP16N - 2;
+    updateTrackNoteMasks(track);
 
     // Nudge test:
-    int ppqnCounter = 0;
+    uint64_t ppqnCounter = 0;
     playedNoteCount = 0;
     processPulse(&ppqnCounter, track, testProcessPulseCallback, testPlayNoteCallback);
     assert(playedNoteCount == 2);
@@ -429,11 +653,12 @@ void testProcessPulseNudge() {
     processPulse(&ppqnCounter, track, testProcessPulseCallback, testPlayNoteCallback);
     assert(playedNoteCount == 1);
     assert(playedNotes[0].note == 65);
+    free(track);
 }
 
 void testProcessPulseShuffle() {
     // Setup:
-    struct Track *track = malloc(TRACK_BYTE_SIZE);
+    struct Track *track = malloc(sizeof(struct Track));
     track->pagePlayMode = PAGE_PLAY_MODE_CONTINUOUS;
     track->trackLength = 63; // =0-based
     track->shuffle = PP16N + 2; // shuffle of 2
@@ -461,8 +686,9 @@ void testProcessPulseShuffle() {
     track->steps[9].notes[0].nudge = PP16N - 4;
     // Special case $4: step 11 has a more positive nudge:
     track->steps[11].notes[0].nudge = PP16N + 4;
+    updateTrackNoteMasks(track);
 
-    int ppqnCounter = 0;    // step 0
+    uint64_t ppqnCounter = 0;    // step 0
     playedNoteCount = 0;
     processPulse(&ppqnCounter, track, testProcessPulseCallback, testPlayNoteCallback);
     assert(playedNoteCount == 1);
@@ -626,13 +852,155 @@ void testProcessPulseShuffle() {
     playedNoteCount = 0;
     processPulse(&ppqnCounter, track, testProcessPulseCallback, testPlayNoteCallback);
     assert(playedNoteCount == 1);
+    free(track);
+}
+
+// Played notes in order, to compare the timeline with processPulse:
+#define MAX_RECORDED_NOTES (NOTES_IN_STEP * 2)
+const struct Note *recordedNotes[MAX_RECORDED_NOTES];
+int recordedNoteCount;
+void testRecordNoteCallback(const struct Note *note) {
+    if (recordedNoteCount < MAX_RECORDED_NOTES) {
+        recordedNotes[recordedNoteCount] = note;
+    }
+    recordedNoteCount++;
+}
+
+/**
+ * Populate a track with random notes, nudges and a shuffle
+ */
+void populateRandomTrack(struct Track *track, unsigned int seed) {
+    srand(seed);
+    track->shuffle = rand() % (PP16N * 2 + 1);
+    track->speed = TRACK_SPEED_NORMAL;
+    track->selectedPage = 0;
+    track->playingPageBank = 0;
+    track->repeatCount = 0;
+    for (int s = 0; s < 64; s++) {
+        for (int n = 0; n < NOTES_IN_STEP; n++) {
+            struct Note *note = &track->steps[s].notes[n];
+            note->enabled = rand() % 3 == 0;
+            note->note = rand() % 128;
+            note->nudge = rand() % (PP16N * 2 + 1);
+            note->trigg = create2FByte(false, false, TRIG_DISABLED);
+        }
+    }
+    updateTrackNoteMasks(track);
+    invalidateTrackTimeline(track);
+}
+
+/**
+ * Play a number of pulses with processPulse and with the timeline, and check they play exactly the same notes
+ */
+bool isTimelineEqualToProcessPulse(struct Track *track, uint64_t pulses) {
+    const struct Note *expectedNotes[MAX_RECORDED_NOTES];
+    for (uint64_t pulse = 0; pulse < pulses; pulse++) {
+        recordedNoteCount = 0;
+        processPulse(&pulse, track, testProcessPulseCallback, testRecordNoteCallback);
+        int expectedCount = recordedNoteCount;
+        memcpy(expectedNotes, recordedNotes, sizeof(expectedNotes));
+
+        recordedNoteCount = 0;
+        processTimelinePulse(&pulse, track, testProcessPulseCallback, testRecordNoteCallback);
+        if (recordedNoteCount != expectedCount) {
+            printWarning("pulse %d: expected %d notes, got %d", (int)pulse, expectedCount, recordedNoteCount);
+            return false;
+        }
+        for (int i = 0; i < MIN(expectedCount, MAX_RECORDED_NOTES); i++) {
+            if (recordedNotes[i] != expectedNotes[i]) {
+                printWarning("pulse %d: note %d differs", (int)pulse, i);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+void testTimelineMatchesProcessPulse() {
+    struct Track *track = malloc(sizeof(struct Track));
+
+    // Continuous play, for all polyphony settings:
+    for (int polyCount = 0; polyCount < 4; polyCount++) {
+        populateRandomTrack(track, polyCount + 1);
+        track->pagePlayMode = PAGE_PLAY_MODE_CONTINUOUS;
+        track->trackLength = 42;
+        track->polyCount = polyCount;
+        track->playingPageBank = polyCount == 0 ? 0 : 1;
+        assert(isTimelineEqualToProcessPulse(track, PP16N * 43 * 3));
+    }
+
+    // Repeat play on different pages and page lengths:
+    for (int page = 0; page < 4; page++) {
+        populateRandomTrack(track, page + 10);
+        track->pagePlayMode = PAGE_PLAY_MODE_REPEAT;
+        track->pageLength = 11 + page;
+        track->polyCount = 0;
+        track->selectedPage = page;
+        assert(isTimelineEqualToProcessPulse(track, PP16N * 16 * 3));
+    }
+
+    // Editing a note should be picked up after invalidating:
+    track->steps[track->selectedPage * 16].notes[0].enabled = !track->steps[track->selectedPage * 16].notes[0].enabled;
+    updateStepNoteMasks(track, track->selectedPage * 16);
+    invalidateTrackTimeline(track);
+    assert(isTimelineEqualToProcessPulse(track, PP16N * 16 * 3));
+
+    // A single step loop plays its negative nudges in the same step:
+    populateRandomTrack(track, 42);
+    track->pagePlayMode = PAGE_PLAY_MODE_CONTINUOUS;
+    track->trackLength = 0;
+    track->polyCount = 0;
+    assert(isTimelineEqualToProcessPulse(track, PP16N * 4));
+
+    // A track that is decoded again (like a pattern that is loaded) is compiled again, with its new settings:
+    struct Track *decoded = malloc(sizeof(struct Track));
+    initializeTrack(decoded, 0);
+    populateRandomTrack(decoded, 7);
+    decoded->pagePlayMode = PAGE_PLAY_MODE_CONTINUOUS;
+    decoded->trackLength = 15;
+    decoded->midiDevice = 2;
+    unsigned char *bytes = malloc(TRACK_BYTE_SIZE);
+    trackToByteArray(decoded, bytes);
+    getTrackTimeline(track);
+    byteArrayToTrack(track, bytes);
+    assert(getTrackTimeline(track)->midiDevice == 2);
+    assert(isTimelineEqualToProcessPulse(track, PP16N * 16 * 3));
+    free(bytes);
+    free(decoded);
+
+    free(track);
+}
+
+void testNoteLengthFollowsTrackSpeed() {
+    struct Track *track = malloc(sizeof(struct Track));
+    struct Note note = {0};
+
+    note.length = 2;
+    track->speed = TRACK_SPEED_NORMAL;
+    assert(getNoteLengthInPulses(track, &note) == PP16N * 2);
+    track->speed = TRACK_SPEED_DIV_TWO;
+    assert(getNoteLengthInPulses(track, &note) == PP16N * 4);
+    track->speed = TRACK_SPEED_TIMES_EIGHT;
+    assert(getNoteLengthInPulses(track, &note) == PP16N / 4);
+
+    // A length of 0 is the shortest possible note:
+    note.length = 0;
+    assert(getNoteLengthInPulses(track, &note) == 1);
+
+    free(track);
 }
 
 void testSequencer() {
     testTrigConditions();
+    testTrigConditionsMatchReference();
+    testProbabilityTrigsAreReproducible();
+    testTransitionTrigConditions();
+    testTrigEditorReachesEveryCondition();
     testGetTrackStepIndexForContinuousPlay();
     testGetTrackStepIndexForRepeatPlay();
     testGetNotesAtTrackStepIndex();
     testProcessPulseNudge();
     testProcessPulseShuffle();
+    testTimelineMatchesProcessPulse();
+    testNoteLengthFollowsTrackSpeed();
 }
\ No newline at end of file
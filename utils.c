@@ -101,6 +101,15 @@ uint8_t get2FByteValue(uint8_t byte) {
     return (byte >> 2) & 0x3F;
 }
 
+/**
+ * Get the next random number (PCG-RXS-M-XS with 32 bits of state)
+ */
+uint32_t getNextRandom(uint32_t *state) {
+    *state = (*state * 747796405u) + 2891336453u;
+    uint32_t word = ((*state >> ((*state >> 28) + 4)) ^ *state) * 277803737u;
+    return (word >> 22) ^ word;
+}
+
 // Function to increment the high nibble (first hex digit)
 unsigned char incrementHighNibble(unsigned char byte) {
     // Extract high nibble, increment it, handle overflow
@@ -35,6 +35,12 @@ bool get2FByteFlag2(uint8_t byte);
  */
 uint8_t get2FByteValue(uint8_t byte);
 
+/**
+ * Get the next number of a small random generator (PCG), the state can be seeded with any value.
+ * Unlike rand() every user has its own state, so sequences are reproducible and thread safe
+ */
+uint32_t getNextRandom(uint32_t *state);
+
 unsigned char incrementHighNibble(unsigned char byte);
 unsigned char decrementHighNibble(unsigned char byte);
 unsigned char incrementLowNibble(unsigned char byte);